@@ -29,11 +29,21 @@ find_package(PkgConfig REQUIRED)
 
 # add 'libva' to the list if you need hardware encoding capabilities
 foreach(FFmpeg_LIBRARY libavcodec libavformat libavutil
-        libavdevice libavfilter libswscale libswresample x264 x265)
+        libavdevice libavfilter libswscale libswresample)
     pkg_check_modules(FFmpeg_${FFmpeg_LIBRARY} REQUIRED ${FFmpeg_LIBRARY})
     list(APPEND FFmpeg_LIBRARIES ${FFmpeg_${FFmpeg_LIBRARY}_LDFLAGS})
 endforeach()
 
+# encoder libraries FFmpeg may be built with (the missing encoders are reported at runtime)
+foreach(FFmpeg_CODEC_LIBRARY x264 x265 vpx)
+    pkg_check_modules(FFmpeg_${FFmpeg_CODEC_LIBRARY} ${FFmpeg_CODEC_LIBRARY})
+    if (FFmpeg_${FFmpeg_CODEC_LIBRARY}_FOUND)
+        list(APPEND FFmpeg_LIBRARIES ${FFmpeg_${FFmpeg_CODEC_LIBRARY}_LDFLAGS})
+    else()
+        message(STATUS "${FFmpeg_CODEC_LIBRARY} is not found, its encoder is not available")
+    endif()
+endforeach()
+
 if (EXISTS "${FFmpeg_DIR}/include")
     set(FFmpeg_INCLUDE_DIRS ${FFmpeg_DIR}/include)
 else()
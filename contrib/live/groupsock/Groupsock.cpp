@@ -68,6 +68,22 @@ Boolean OutputSocket::write(netAddressBits address, portNumBits portNum, u_int8_
   return True;
 }
 
+Boolean OutputSocket::writeBatch(netAddressBits address, portNumBits portNum, u_int8_t ttl,
+				 unsigned char* const* buffers, unsigned const* bufferSizes, unsigned numBuffers) {
+  if (numBuffers == 0) return True;
+
+  unsigned first = 0;
+  if ((unsigned)ttl != fLastSentTTL || sourcePortNum() == 0) {
+    // Send the first datagram normally (this sets the TTL, and finds out our source port number):
+    if (!write(address, portNum, ttl, buffers[0], bufferSizes[0])) return False;
+    first = 1;
+  }
+
+  struct in_addr destAddr; destAddr.s_addr = address;
+  return writeSocketBatch(env(), socketNum(), destAddr, portNum,
+			  &buffers[first], &bufferSizes[first], numBuffers - first) == numBuffers - first;
+}
+
 // By default, we don't do reads:
 Boolean OutputSocket
 ::handleRead(unsigned char* /*buffer*/, unsigned /*bufferMaxSize*/,
@@ -303,6 +319,39 @@ Boolean Groupsock::output(UsageEnvironment& env, unsigned char* buffer, unsigned
   return False;
 }
 
+Boolean Groupsock::outputBatch(UsageEnvironment& env,
+			       unsigned char* const* buffers, unsigned const* bufferSizes, unsigned numBuffers) {
+  if (!members().IsEmpty()) {
+    // The datagrams are also relayed to our members; do this one by one:
+    for (unsigned i = 0; i < numBuffers; ++i) {
+      if (!output(env, buffers[i], bufferSizes[i])) return False;
+    }
+    return True;
+  }
+
+  for (destRecord* dests = fDests; dests != NULL; dests = dests->fNext) {
+    if (!writeBatch(dests->fGroupEId.groupAddress().s_addr, dests->fGroupEId.portNum(), dests->fGroupEId.ttl(),
+		    buffers, bufferSizes, numBuffers)) {
+      if (DebugLevel >= 0) { // this is a fatal error
+	UsageEnvironment::MsgString msg = strDup(env.getResultMsg());
+	env.setResultMsg("Groupsock write failed: ", msg);
+	delete[] (char*)msg;
+      }
+      return False;
+    }
+  }
+
+  for (unsigned i = 0; i < numBuffers; ++i) {
+    statsOutgoing.countPacket(bufferSizes[i]);
+    statsGroupOutgoing.countPacket(bufferSizes[i]);
+  }
+
+  if (DebugLevel >= 3) {
+    env << *this << ": wrote " << numBuffers << " datagrams, ttl " << (unsigned)ttl() << "\n";
+  }
+  return True;
+}
+
 Boolean Groupsock::handleRead(unsigned char* buffer, unsigned bufferMaxSize,
 			      unsigned& bytesRead,
 			      struct sockaddr_in& fromAddressAndPort) {
@@ -37,6 +37,14 @@ extern "C" int initializeWinsockIfNecessary();
 #include <fcntl.h>
 #define initializeWinsockIfNecessary() 1
 #endif
+#if defined(__linux__)
+#include <sys/uio.h>
+#include <netinet/udp.h>
+#include <atomic>
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103 // the kernel may support it even if the C library headers don't define it
+#endif
+#endif
 #if defined(__WIN32__) || defined(_WIN32) || defined(_QNX4)
 #else
 #include <signal.h>
@@ -410,6 +418,122 @@ Boolean writeSocket(UsageEnvironment& env,
   return False;
 }
 
+#if defined(__linux__)
+#define MAX_BATCH_SIZE 64 // also the kernel's limit on the number of GSO segments
+#define MAX_GSO_BYTES 65000 // the segments are sent as one UDP datagram (before segmentation)
+
+// These are cleared (for all sockets) the first time the kernel rejects the feature.
+// (They're atomic, because the sockets may be written from several threads, each running its own event loop.)
+static std::atomic<bool> gsoIsSupported(true);
+static std::atomic<bool> sendmmsgIsSupported(true);
+
+static unsigned writeSocketGSO(UsageEnvironment& env, int socket, struct sockaddr_in& dest,
+			       unsigned char* const* buffers, unsigned const* bufferSizes, unsigned numBuffers) {
+  // Send the longest run of datagrams that all have the size of the first one (except that the last one may be
+  // shorter) as a single "sendmsg()", with the kernel splitting it into datagrams:
+  unsigned const segmentSize = bufferSizes[0];
+  unsigned numSegments = 0, totalSize = 0;
+  struct iovec iov[MAX_BATCH_SIZE];
+  while (numSegments < numBuffers && numSegments < MAX_BATCH_SIZE
+	 && bufferSizes[numSegments] <= segmentSize && totalSize + bufferSizes[numSegments] <= MAX_GSO_BYTES) {
+    iov[numSegments].iov_base = buffers[numSegments];
+    iov[numSegments].iov_len = bufferSizes[numSegments];
+    totalSize += bufferSizes[numSegments];
+    if (bufferSizes[numSegments++] < segmentSize) break; // a shorter datagram ends the run
+  }
+  if (numSegments < 2) return 0; // not worth it
+
+  char control[CMSG_SPACE(sizeof (u_int16_t))];
+  memset(control, 0, sizeof control);
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof msg);
+  msg.msg_name = &dest;
+  msg.msg_namelen = sizeof dest;
+  msg.msg_iov = iov;
+  msg.msg_iovlen = numSegments;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof control;
+
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = IPPROTO_UDP;
+  cmsg->cmsg_type = UDP_SEGMENT;
+  cmsg->cmsg_len = CMSG_LEN(sizeof (u_int16_t));
+  u_int16_t gsoSize = (u_int16_t)segmentSize;
+  memcpy(CMSG_DATA(cmsg), &gsoSize, sizeof gsoSize);
+
+  if (sendmsg(socket, &msg, 0) != (int)totalSize) {
+    int err = env.getErrno();
+    if (err == EINVAL || err == EIO || err == ENOPROTOOPT || err == EOPNOTSUPP) {
+      // The kernel (or the outgoing interface) doesn't support UDP GSO; don't try it again:
+      gsoIsSupported.store(false, std::memory_order_relaxed);
+    }
+    return 0; // the datagrams are sent some other way
+  }
+
+  return numSegments;
+}
+
+static unsigned writeSocketMMsg(UsageEnvironment& env, int socket, struct sockaddr_in& dest,
+				unsigned char* const* buffers, unsigned const* bufferSizes, unsigned numBuffers) {
+  if (numBuffers > MAX_BATCH_SIZE) numBuffers = MAX_BATCH_SIZE;
+
+  struct iovec iov[MAX_BATCH_SIZE];
+  struct mmsghdr msgs[MAX_BATCH_SIZE];
+  memset(msgs, 0, numBuffers*sizeof (struct mmsghdr));
+  for (unsigned i = 0; i < numBuffers; ++i) {
+    iov[i].iov_base = buffers[i];
+    iov[i].iov_len = bufferSizes[i];
+    msgs[i].msg_hdr.msg_name = &dest;
+    msgs[i].msg_hdr.msg_namelen = sizeof dest;
+    msgs[i].msg_hdr.msg_iov = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  int numSent = sendmmsg(socket, msgs, numBuffers, 0);
+  if (numSent < 0) {
+    if (env.getErrno() == ENOSYS) {
+      sendmmsgIsSupported.store(false, std::memory_order_relaxed);
+      return 0; // the datagrams are sent some other way
+    }
+    socketErr(env, "writeSocketBatch(), sendmmsg() error: ");
+    return 0;
+  }
+
+  return (unsigned)numSent;
+}
+#endif
+
+unsigned writeSocketBatch(UsageEnvironment& env,
+			  int socket, struct in_addr address, portNumBits portNum,
+			  unsigned char* const* buffers, unsigned const* bufferSizes, unsigned numBuffers) {
+  unsigned numSent = 0;
+
+#if defined(__linux__)
+  MAKE_SOCKADDR_IN(dest, address.s_addr, portNum);
+
+  while (numSent < numBuffers) {
+    unsigned n = 0;
+    if (gsoIsSupported.load(std::memory_order_relaxed)) {
+      n = writeSocketGSO(env, socket, dest, &buffers[numSent], &bufferSizes[numSent], numBuffers - numSent);
+    }
+    if (n == 0 && sendmmsgIsSupported.load(std::memory_order_relaxed)) {
+      n = writeSocketMMsg(env, socket, dest, &buffers[numSent], &bufferSizes[numSent], numBuffers - numSent);
+      if (n == 0 && sendmmsgIsSupported.load(std::memory_order_relaxed)) return numSent; // a (fatal) send error; drop the rest
+    }
+    if (n == 0) break; // neither is supported
+    numSent += n;
+  }
+#endif
+
+  // Fallback: Send the (remaining) datagrams one by one:
+  for (; numSent < numBuffers; ++numSent) {
+    if (!writeSocket(env, socket, address, portNum, buffers[numSent], bufferSizes[numSent])) break;
+  }
+
+  return numSent;
+}
+
 void ignoreSigPipeOnSocket(int socketNum) {
   #ifdef USE_SIGNALS
   #ifdef SO_NOSIGPIPE
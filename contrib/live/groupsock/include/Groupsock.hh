@@ -47,6 +47,9 @@ public:
 		unsigned char* buffer, unsigned bufferSize) {
     return write(addressAndPort.sin_addr.s_addr, addressAndPort.sin_port, ttl, buffer, bufferSize);
   }
+  Boolean writeBatch(netAddressBits address, portNumBits portNum/*in network order*/, u_int8_t ttl,
+		     unsigned char* const* buffers, unsigned const* bufferSizes, unsigned numBuffers);
+      // like "write()", but for several datagrams at once (see "writeSocketBatch()")
 
 protected:
   OutputSocket(UsageEnvironment& env, Port port);
@@ -128,6 +131,10 @@ public:
 
   void multicastSendOnly(); // send, but don't receive any multicast packets
 
+  Boolean outputBatch(UsageEnvironment& env,
+		      unsigned char* const* buffers, unsigned const* bufferSizes, unsigned numBuffers);
+      // like "output()", but for several datagrams at once (sent with as few system calls as possible)
+
   virtual Boolean output(UsageEnvironment& env, unsigned char* buffer, unsigned bufferSize,
 			 DirectedNetInterface* interfaceNotToFwdBackTo = NULL);
 
@@ -43,6 +43,14 @@ Boolean writeSocket(UsageEnvironment& env,
 		    unsigned char* buffer, unsigned bufferSize);
     // An optimized version of "writeSocket" that omits the "setsockopt()" call to set the TTL.
 
+unsigned writeSocketBatch(UsageEnvironment& env,
+			  int socket, struct in_addr address, portNumBits portNum/*network byte order*/,
+			  unsigned char* const* buffers, unsigned const* bufferSizes, unsigned numBuffers);
+    // Sends several datagrams to the same destination (like "writeSocket" without the TTL), using as few
+    // system calls as possible: UDP GSO ("UDP_SEGMENT") for runs of equal-sized datagrams, and "sendmmsg()"
+    // for the rest, where available; otherwise, one "sendto()" per datagram.
+    // Returns the number of datagrams that were sent (the rest are dropped, like a failed "writeSocket").
+
 void ignoreSigPipeOnSocket(int socketNum);
 
 unsigned getSendBufferSize(UsageEnvironment& env, int socket);
@@ -137,7 +137,8 @@ RTCPInstance::RTCPInstance(UsageEnvironment& env, Groupsock* RTCPgs,
     fSRHandlerTask(NULL), fSRHandlerClientData(NULL),
     fRRHandlerTask(NULL), fRRHandlerClientData(NULL),
     fSpecificRRHandlerTable(NULL),
-    fAppHandlerTask(NULL), fAppHandlerClientData(NULL) {
+    fAppHandlerTask(NULL), fAppHandlerClientData(NULL),
+    fGenericNACKHandlerTask(NULL), fGenericNACKHandlerClientData(NULL) {
 #ifdef DEBUG
   fprintf(stderr, "RTCPInstance[%p]::RTCPInstance()\n", this);
 #endif
@@ -341,6 +342,11 @@ void RTCPInstance::setAppHandler(RTCPAppHandlerFunc* handlerTask, void* clientDa
   fAppHandlerClientData = clientData;
 }
 
+void RTCPInstance::setGenericNACKHandler(RTCPGenericNACKHandlerFunc* handlerTask, void* clientData) {
+  fGenericNACKHandlerTask = handlerTask;
+  fGenericNACKHandlerClientData = clientData;
+}
+
 void RTCPInstance::sendAppPacket(u_int8_t subtype, char const* name,
 				 u_int8_t* appDependentData, unsigned appDependentDataSize) {
   // Set up the first 4 bytes: V,PT,subtype,PT,length:
@@ -524,11 +530,12 @@ void RTCPInstance
     // Check the RTCP packet for validity:
     // It must at least contain a header (4 bytes), and this header
     // must be version=2, with no padding bit, and a payload type of
-    // SR (200), RR (201), or APP (204):
+    // SR (200), RR (201), APP (204), or RTPFB (205) (a 'reduced-size' feedback packet; RFC 5506):
     if (packetSize < 4) break;
     unsigned rtcpHdr = ntohl(*(u_int32_t*)pkt);
     if ((rtcpHdr & 0xE0FE0000) != (0x80000000 | (RTCP_PT_SR<<16)) &&
-	(rtcpHdr & 0xE0FF0000) != (0x80000000 | (RTCP_PT_APP<<16))) {
+	(rtcpHdr & 0xE0FF0000) != (0x80000000 | (RTCP_PT_APP<<16)) &&
+	(rtcpHdr & 0xE0FF0000) != (0x80000000 | (RTCP_PT_RTPFB<<16))) {
 #ifdef DEBUG
       fprintf(stderr, "rejected bad RTCP packet: header 0x%08x\n", rtcpHdr);
 #endif
@@ -751,9 +758,28 @@ void RTCPInstance
 	  break;
 	}
         case RTCP_PT_RTPFB: {
+	  u_int8_t& fmt = rc; // In feedback packets, the "rc" field gets used as "FMT"
+#ifdef DEBUG
+	  fprintf(stderr, "RTPFB (FMT %d)\n", fmt);
+#endif
+	  if (fmt == 1/*Generic NACK*/ && fGenericNACKHandlerTask != NULL) {
+	    if (length < 4) break;
+	    length -= 4;
+	    u_int32_t mediaSSRC = ntohl(*(u_int32_t*)pkt); ADVANCE(4);
+
+	    // Each 'FCI' entry is a packet id (PID) followed by a bitmask of following lost packets (BLP):
+	    while (length >= 4) {
+	      u_int16_t packetID = (pkt[0]<<8)|pkt[1];
+	      u_int16_t bitmaskOfLostPackets = (pkt[2]<<8)|pkt[3];
+	      ADVANCE(4); length -= 4;
 #ifdef DEBUG
-	  fprintf(stderr, "RTPFB(unhandled)\n");
+	      fprintf(stderr, "\tGeneric NACK: media SSRC 0x%08x, PID %d, BLP 0x%04x\n",
+		      mediaSSRC, packetID, bitmaskOfLostPackets);
 #endif
+	      (*fGenericNACKHandlerTask)(fGenericNACKHandlerClientData, mediaSSRC,
+					 packetID, bitmaskOfLostPackets);
+	    }
+	  }
 	  subPacketOK = True;
 	  break;
 	}
@@ -23,6 +23,10 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #include "RTPInterface.hh"
 #include <GroupsockHelper.hh>
 #include <stdio.h>
+#include <string.h>
+#if !defined(__WIN32__) && !defined(_WIN32)
+#include <sys/uio.h>
+#endif
 
 ////////// Helper Functions - Definition //////////
 
@@ -45,11 +49,131 @@ static HashTable* socketHashTable(UsageEnvironment& env, Boolean createIfNotPres
   return (HashTable*)(ourTables->socketTable);
 }
 
+#ifndef RTPINTERFACE_BLOCKING_WRITE_TIMEOUT_MS
+#define RTPINTERFACE_BLOCKING_WRITE_TIMEOUT_MS 500
+#endif
+
+#ifndef RTPINTERFACE_MAX_TCP_QUEUE_SIZE
+#define RTPINTERFACE_MAX_TCP_QUEUE_SIZE (512*1024)
+#endif
+
+#ifndef RTPINTERFACE_MAX_TCP_SEND_IOVECS
+#define RTPINTERFACE_MAX_TCP_SEND_IOVECS 64
+#endif
+
+// Sending RTP-over-TCP is implemented using a single (vectored) "send()" for the framing header and the packet.
+// If the socket's send buffer is full, then the rest is queued - in the socket's "SocketDescriptor" - and sent
+// when the socket becomes writable (rather than blocking).
+
+#if defined(__WIN32__) || defined(_WIN32)
+struct iovec {
+  void* iov_base;
+  size_t iov_len;
+};
+
+static int sendIOVectors(int socketNum, struct iovec const* iov, unsigned numIOVectors) {
+  // There's no "sendmsg()", so send the vectors one at a time, stopping at the first one that's not sent completely:
+  int totNumBytesSent = 0;
+  for (unsigned i = 0; i < numIOVectors; ++i) {
+    int sendResult = send(socketNum, (char const*)iov[i].iov_base, (int)iov[i].iov_len, 0/*flags*/);
+    if (sendResult < 0) return totNumBytesSent > 0 ? totNumBytesSent : sendResult;
+
+    totNumBytesSent += sendResult;
+    if ((unsigned)sendResult < iov[i].iov_len) break;
+  }
+  return totNumBytesSent;
+}
+#else
+static int sendIOVectors(int socketNum, struct iovec const* iov, unsigned numIOVectors) {
+  struct msghdr msg;
+  memset(&msg, 0, sizeof msg);
+  msg.msg_iov = (struct iovec*)iov;
+  msg.msg_iovlen = numIOVectors;
+
+  return sendmsg(socketNum, &msg, 0/*flags*/);
+}
+#endif
+
+// A copy of a packet (or RTSP response data) that's waiting to be sent over one or more TCP sockets.
+// (The copy is shared by the queues of all of the sockets that the packet is sent over.)
+class TCPOutboundPacket {
+public:
+  TCPOutboundPacket(u_int8_t const* data, unsigned dataSize)
+    : fData(new u_int8_t[dataSize]), fDataSize(dataSize), fRefCount(0) {
+    memmove(fData, data, dataSize);
+  }
+
+  void incrementRefCount() { ++fRefCount; }
+  void decrementRefCount() { if (--fRefCount == 0) delete this; }
+
+  u_int8_t const* data() const { return fData; }
+  unsigned dataSize() const { return fDataSize; }
+
+private:
+  ~TCPOutboundPacket() { delete[] fData; }
+
+private:
+  u_int8_t* fData;
+  unsigned fDataSize;
+  unsigned fRefCount;
+};
+
+// An entry in a TCP socket's send queue: a (possibly partially-sent) framing header and packet:
+class TCPOutboundQueueEntry {
+public:
+  TCPOutboundQueueEntry(u_int8_t const* framingHeader, unsigned framingHeaderSize,
+			TCPOutboundPacket* packet, unsigned numBytesSent, Boolean isDroppable)
+    : fNext(NULL), fFramingHeaderSize(framingHeaderSize), fPacket(packet),
+      fNumBytesSent(numBytesSent), fIsDroppable(isDroppable) {
+    if (framingHeaderSize > 0) memmove(fFramingHeader, framingHeader, framingHeaderSize);
+    fPacket->incrementRefCount();
+  }
+  ~TCPOutboundQueueEntry() { fPacket->decrementRefCount(); }
+
+  unsigned size() const { return fFramingHeaderSize + fPacket->dataSize(); }
+  unsigned numBytesRemaining() const { return size() - fNumBytesSent; }
+
+  unsigned getRemainingData(struct iovec* iov) const {
+    // Fills in (at most 2) vectors describing the data that hasn't been sent yet; returns the number of vectors:
+    unsigned numIOVectors = 0;
+    unsigned offset = fNumBytesSent;
+    if (offset < fFramingHeaderSize) {
+      iov[numIOVectors].iov_base = (void*)&fFramingHeader[offset];
+      iov[numIOVectors].iov_len = fFramingHeaderSize - offset;
+      ++numIOVectors;
+      offset = fFramingHeaderSize;
+    }
+    offset -= fFramingHeaderSize;
+    iov[numIOVectors].iov_base = (void*)&fPacket->data()[offset];
+    iov[numIOVectors].iov_len = fPacket->dataSize() - offset;
+    ++numIOVectors;
+
+    return numIOVectors;
+  }
+
+public:
+  TCPOutboundQueueEntry* fNext;
+  u_int8_t fFramingHeader[4];
+  unsigned fFramingHeaderSize; // 0 if the data is not framed (e.g., a RTSP response)
+  TCPOutboundPacket* fPacket;
+  unsigned fNumBytesSent;
+  Boolean fIsDroppable; // True for RTP packets; False for RTCP packets and RTSP responses
+};
+
 class SocketDescriptor {
 public:
   SocketDescriptor(UsageEnvironment& env, int socketNum);
   virtual ~SocketDescriptor();
 
+  enum SendResult { SEND_SUCCEEDED, SEND_SKIPPED, SEND_OVERFLOWED, SEND_FAILED };
+  SendResult sendPacket(u_int8_t const* framingHeader, unsigned framingHeaderSize,
+			u_int8_t const* data, unsigned dataSize,
+			Boolean isDroppable, int syncPoint, TCPOutboundPacket*& queuedCopy);
+      // Sends the (framed) data right away, unless data is already queued - or the socket's send buffer is full -
+      // in which case (the rest of) the data is queued.
+      // "syncPoint" is 1 if the data begins a key frame, 0 if it doesn't, or -1 if this is not known.
+      // "queuedCopy" is the copy of the data made when it's queued (if NULL, it's set by this call).
+
   void registerRTPInterface(unsigned char streamChannelId,
 			    RTPInterface* rtpInterface);
   RTPInterface* lookupRTPInterface(unsigned char streamChannelId);
@@ -64,6 +188,11 @@ private:
   static void tcpReadHandler(SocketDescriptor*, int mask);
   Boolean tcpReadHandler1(int mask);
 
+  void updateBackgroundHandling();
+  Boolean flushOutboundQueue(); // returns False if sending failed
+  void dropQueuedPackets();
+  void finishOutboundQueue();
+
 private:
   UsageEnvironment& fEnv;
   int fOurSocketNum;
@@ -73,6 +202,11 @@ private:
   u_int8_t fStreamChannelId, fSizeByte1;
   Boolean fReadErrorOccurred, fDeleteMyselfNext, fAreInReadHandlerLoop;
   enum { AWAITING_DOLLAR, AWAITING_STREAM_CHANNEL_ID, AWAITING_SIZE1, AWAITING_SIZE2, AWAITING_PACKET_DATA } fTCPReadingState;
+  int fConditionSet; // the socket's current background handling
+  TCPOutboundQueueEntry* fOutboundQueueHead;
+  TCPOutboundQueueEntry* fOutboundQueueTail;
+  unsigned fOutboundQueueSize; // the number of queued bytes that haven't been sent yet
+  Boolean fIsSkippingToSyncPoint, fLastSkippedPacketEndedFrame;
 };
 
 static SocketDescriptor* lookupSocketDescriptor(UsageEnvironment& env, int sockNum, Boolean createIfNotFound = True) {
@@ -114,12 +248,15 @@ static void removeSocketDescription(UsageEnvironment& env, int sockNum) {
 
 ////////// RTPInterface - Implementation //////////
 
+unsigned RTPInterface::maxTCPQueueSize = RTPINTERFACE_MAX_TCP_QUEUE_SIZE;
+
 RTPInterface::RTPInterface(Medium* owner, Groupsock* gs)
   : fOwner(owner), fGS(gs),
     fTCPStreams(NULL),
     fNextTCPReadSize(0), fNextTCPReadStreamSocketNum(-1),
     fNextTCPReadStreamChannelId(0xFF), fReadHandlerProc(NULL),
-    fAuxReadHandlerFunc(NULL), fAuxReadHandlerClientData(NULL) {
+    fAuxReadHandlerFunc(NULL), fAuxReadHandlerClientData(NULL),
+    fTCPOverflowHandler(NULL), fTCPOverflowHandlerClientData(NULL) {
   // Make the socket non-blocking, even though it will be read from only asynchronously, when packets arrive.
   // The reason for this is that, in some OSs, reads on a blocking socket can (allegedly) sometimes block,
   // even if the socket was previously reported (e.g., by "select()") as having data available.
@@ -213,6 +350,18 @@ void RTPInterface::clearServerRequestAlternativeByteHandler(UsageEnvironment& en
   setServerRequestAlternativeByteHandler(env, socketNum, NULL, NULL);
 }
 
+Boolean RTPInterface::sendOverStreamSocket(UsageEnvironment& env, int socketNum, u_int8_t const* data, unsigned dataSize) {
+  SocketDescriptor* socketDescriptor = lookupSocketDescriptor(env, socketNum, False);
+  if (socketDescriptor == NULL) {
+    // Normal case: The socket is not being used for RTP/RTCP-over-TCP:
+    return send(socketNum, (char const*)data, dataSize, 0/*flags*/) == (int)dataSize;
+  }
+
+  TCPOutboundPacket* queuedCopy = NULL;
+  return socketDescriptor->sendPacket(NULL, 0, data, dataSize, False, -1, queuedCopy)
+    == SocketDescriptor::SEND_SUCCEEDED;
+}
+
 Boolean RTPInterface::sendPacket(unsigned char* packet, unsigned packetSize) {
   Boolean success = True; // we'll return False instead if any of the sends fail
 
@@ -220,11 +369,12 @@ Boolean RTPInterface::sendPacket(unsigned char* packet, unsigned packetSize) {
   if (!fGS->output(envir(), packet, packetSize)) success = False;
 
   // Also, send over each of our TCP sockets:
+  TCPOutboundPacket* queuedCopy = NULL; // if the packet has to be queued, then its copy is shared by the sockets
   tcpStreamRecord* nextStream;
   for (tcpStreamRecord* stream = fTCPStreams; stream != NULL; stream = nextStream) {
     nextStream = stream->fNext; // Set this now, in case the following deletes "stream":
     if (!sendRTPorRTCPPacketOverTCP(packet, packetSize,
-				    stream->fStreamSocketNum, stream->fStreamChannelId)) {
+				    stream->fStreamSocketNum, stream->fStreamChannelId, -1, queuedCopy)) {
       success = False;
     }
   }
@@ -232,6 +382,30 @@ Boolean RTPInterface::sendPacket(unsigned char* packet, unsigned packetSize) {
   return success;
 }
 
+Boolean RTPInterface::sendPackets(unsigned char* const* packets, unsigned const* packetSizes, unsigned numPackets,
+				  Boolean const* syncPoints) {
+  Boolean success = True; // we'll return False instead if any of the sends fail
+
+  // Normal case: Send as UDP packets:
+  if (!fGS->outputBatch(envir(), packets, packetSizes, numPackets)) success = False;
+
+  // Also, send over each of our TCP sockets:
+  for (unsigned i = 0; i < numPackets; ++i) {
+    int syncPoint = syncPoints == NULL ? -1 : syncPoints[i] ? 1 : 0;
+    TCPOutboundPacket* queuedCopy = NULL;
+    tcpStreamRecord* nextStream;
+    for (tcpStreamRecord* stream = fTCPStreams; stream != NULL; stream = nextStream) {
+      nextStream = stream->fNext; // Set this now, in case the following deletes "stream":
+      if (!sendRTPorRTCPPacketOverTCP(packets[i], packetSizes[i],
+				      stream->fStreamSocketNum, stream->fStreamChannelId, syncPoint, queuedCopy)) {
+	success = False;
+      }
+    }
+  }
+
+  return success;
+}
+
 void RTPInterface
 ::startNetworkReading(TaskScheduler::BackgroundHandlerProc* handlerProc) {
   // Normal case: Arrange to read UDP packets:
@@ -314,42 +488,56 @@ void RTPInterface::stopNetworkReading() {
 ////////// Helper Functions - Implementation /////////
 
 Boolean RTPInterface::sendRTPorRTCPPacketOverTCP(u_int8_t* packet, unsigned packetSize,
-						 int socketNum, unsigned char streamChannelId) {
+						 int socketNum, unsigned char streamChannelId,
+						 int syncPoint, TCPOutboundPacket*& queuedCopy) {
 #ifdef DEBUG_SEND
   fprintf(stderr, "sendRTPorRTCPPacketOverTCP: %d bytes over channel %d (socket %d)\n",
 	  packetSize, streamChannelId, socketNum); fflush(stderr);
 #endif
   // Send a RTP/RTCP packet over TCP, using the encoding defined in RFC 2326, section 10.12:
   //     $<streamChannelId><packetSize><packet>
-  // (If the initial "send()" of '$<streamChannelId><packetSize>' succeeds, then we force
-  // the subsequent "send()" for the <packet> data to succeed, even if we have to do so with
-  // a blocking "send()".)
-  do {
-    u_int8_t framingHeader[4];
-    framingHeader[0] = '$';
-    framingHeader[1] = streamChannelId;
-    framingHeader[2] = (u_int8_t) ((packetSize&0xFF00)>>8);
-    framingHeader[3] = (u_int8_t) (packetSize&0xFF);
-    if (!sendDataOverTCP(socketNum, framingHeader, 4, False)) break;
-
-    if (!sendDataOverTCP(socketNum, packet, packetSize, True)) break;
+  // (The framing header and the packet are sent together.  If the socket's send buffer is full, then we
+  // queue the rest, rather than blocking; see "maxTCPQueueSize".)
+  u_int8_t framingHeader[4];
+  framingHeader[0] = '$';
+  framingHeader[1] = streamChannelId;
+  framingHeader[2] = (u_int8_t) ((packetSize&0xFF00)>>8);
+  framingHeader[3] = (u_int8_t) (packetSize&0xFF);
+
+  SocketDescriptor* socketDescriptor = lookupSocketDescriptor(envir(), socketNum, False);
+  if (socketDescriptor == NULL) {
+    // The socket is not set up for RTP-over-TCP (this shouldn't happen), so send the packet the old way:
+    return sendDataOverTCP(socketNum, framingHeader, 4, False)
+      && sendDataOverTCP(socketNum, packet, packetSize, True);
+  }
+
+  Boolean isDroppable = !fOwner->isRTCPInstance(); // we never drop RTCP packets
+  switch (socketDescriptor->sendPacket(framingHeader, 4, packet, packetSize, isDroppable, syncPoint, queuedCopy)) {
+    case SocketDescriptor::SEND_SUCCEEDED: {
+      return True;
+    }
+    case SocketDescriptor::SEND_OVERFLOWED: {
 #ifdef DEBUG_SEND
-    fprintf(stderr, "sendRTPorRTCPPacketOverTCP: completed\n"); fflush(stderr);
+      fprintf(stderr, "sendRTPorRTCPPacketOverTCP: socket %d has fallen behind; skipping to the next sync point\n", socketNum); fflush(stderr);
 #endif
-
-    return True;
-  } while (0);
-
+      if (fTCPOverflowHandler != NULL) (*fTCPOverflowHandler)(fTCPOverflowHandlerClientData);
+      return False;
+    }
+    case SocketDescriptor::SEND_SKIPPED: {
+      return False;
+    }
+    default: {
 #ifdef DEBUG_SEND
-  fprintf(stderr, "sendRTPorRTCPPacketOverTCP: failed! (errno %d)\n", envir().getErrno()); fflush(stderr);
+      fprintf(stderr, "sendRTPorRTCPPacketOverTCP: failed! (errno %d)\n", envir().getErrno()); fflush(stderr);
 #endif
-  return False;
+      // Because the "send()" call failed, assume that the socket is now unusable, so stop
+      // using it (for both RTP and RTCP):
+      removeStreamSocket(socketNum, 0xFF);
+      return False;
+    }
+  }
 }
 
-#ifndef RTPINTERFACE_BLOCKING_WRITE_TIMEOUT_MS
-#define RTPINTERFACE_BLOCKING_WRITE_TIMEOUT_MS 500
-#endif
-
 Boolean RTPInterface::sendDataOverTCP(int socketNum, u_int8_t const* data, unsigned dataSize, Boolean forceSendToSucceed) {
   int sendResult = send(socketNum, (char const*)data, dataSize, 0/*flags*/);
   if (sendResult < (int)dataSize) {
@@ -397,10 +585,13 @@ SocketDescriptor::SocketDescriptor(UsageEnvironment& env, int socketNum)
   :fEnv(env), fOurSocketNum(socketNum),
     fSubChannelHashTable(HashTable::create(ONE_WORD_HASH_KEYS)),
    fServerRequestAlternativeByteHandler(NULL), fServerRequestAlternativeByteHandlerClientData(NULL),
-   fReadErrorOccurred(False), fDeleteMyselfNext(False), fAreInReadHandlerLoop(False), fTCPReadingState(AWAITING_DOLLAR) {
+   fReadErrorOccurred(False), fDeleteMyselfNext(False), fAreInReadHandlerLoop(False), fTCPReadingState(AWAITING_DOLLAR),
+   fConditionSet(0), fOutboundQueueHead(NULL), fOutboundQueueTail(NULL), fOutboundQueueSize(0),
+   fIsSkippingToSyncPoint(False), fLastSkippedPacketEndedFrame(False) {
 }
 
 SocketDescriptor::~SocketDescriptor() {
+  finishOutboundQueue();
   fEnv.taskScheduler().turnOffBackgroundReadHandling(fOurSocketNum);
   removeSocketDescription(fEnv, fOurSocketNum);
 
@@ -443,11 +634,8 @@ void SocketDescriptor::registerRTPInterface(unsigned char streamChannelId,
 			    rtpInterface);
 
   if (isFirstRegistration) {
-    // Arrange to handle reads on this TCP socket:
-    TaskScheduler::BackgroundHandlerProc* handler
-      = (TaskScheduler::BackgroundHandlerProc*)&tcpReadHandler;
-    fEnv.taskScheduler().
-      setBackgroundHandling(fOurSocketNum, SOCKET_READABLE|SOCKET_EXCEPTION, handler, this);
+    // Arrange to handle reads (and, if data is queued, writes) on this TCP socket:
+    updateBackgroundHandling();
   }
 }
 
@@ -474,7 +662,181 @@ void SocketDescriptor
   }
 }
 
+SocketDescriptor::SendResult SocketDescriptor
+::sendPacket(u_int8_t const* framingHeader, unsigned framingHeaderSize,
+	     u_int8_t const* data, unsigned dataSize,
+	     Boolean isDroppable, int syncPoint, TCPOutboundPacket*& queuedCopy) {
+  if (isDroppable && fIsSkippingToSyncPoint) {
+    // Skip packets until the next sync point (or - if sync points are not known - until the start of the next frame):
+    Boolean isAtSyncPoint = syncPoint >= 0 ? syncPoint != 0 : fLastSkippedPacketEndedFrame;
+    if (!isAtSyncPoint) {
+      fLastSkippedPacketEndedFrame = dataSize >= 2 && (data[1]&0x80) != 0; // the RTP 'M' bit
+      return SEND_SKIPPED;
+    }
+    fIsSkippingToSyncPoint = False;
+  }
+
+  unsigned totSize = framingHeaderSize + dataSize;
+  unsigned numBytesSent = 0;
+  if (fOutboundQueueHead == NULL) {
+    // Normal case: Send the framing header and the data at once:
+    struct iovec iov[2];
+    unsigned numIOVectors = 0;
+    if (framingHeaderSize > 0) {
+      iov[numIOVectors].iov_base = (void*)framingHeader;
+      iov[numIOVectors].iov_len = framingHeaderSize;
+      ++numIOVectors;
+    }
+    iov[numIOVectors].iov_base = (void*)data;
+    iov[numIOVectors].iov_len = dataSize;
+    ++numIOVectors;
+
+    int sendResult = sendIOVectors(fOurSocketNum, iov, numIOVectors);
+    if (sendResult < 0) {
+      int err = fEnv.getErrno();
+      if (err != EAGAIN && err != EWOULDBLOCK) return SEND_FAILED;
+      sendResult = 0;
+    }
+    numBytesSent = (unsigned)sendResult;
+    if (numBytesSent == totSize) return SEND_SUCCEEDED;
+  } else if (isDroppable && fOutboundQueueSize + totSize > RTPInterface::maxTCPQueueSize) {
+    // The receiver has fallen too far behind.  Drop the queued packets that haven't been started yet,
+    // and skip packets until the next sync point (so that the receiver can resume decoding from there):
+    dropQueuedPackets();
+    fIsSkippingToSyncPoint = True;
+    fLastSkippedPacketEndedFrame = dataSize >= 2 && (data[1]&0x80) != 0;
+    return SEND_OVERFLOWED;
+  }
+
+  // Queue (the rest of) the data, to be sent when the socket becomes writable:
+  if (queuedCopy == NULL) queuedCopy = new TCPOutboundPacket(data, dataSize);
+  TCPOutboundQueueEntry* entry
+    = new TCPOutboundQueueEntry(framingHeader, framingHeaderSize, queuedCopy, numBytesSent, isDroppable);
+  if (fOutboundQueueTail == NULL) {
+    fOutboundQueueHead = fOutboundQueueTail = entry;
+  } else {
+    fOutboundQueueTail->fNext = entry;
+    fOutboundQueueTail = entry;
+  }
+  fOutboundQueueSize += entry->numBytesRemaining();
+
+  updateBackgroundHandling();
+  return SEND_SUCCEEDED;
+}
+
+void SocketDescriptor::updateBackgroundHandling() {
+  if (fSubChannelHashTable->IsEmpty()) return; // we're not handling the socket yet
+
+  int conditionSet = SOCKET_READABLE|SOCKET_EXCEPTION;
+  if (fOutboundQueueHead != NULL) conditionSet |= SOCKET_WRITABLE;
+  if (conditionSet == fConditionSet) return;
+
+  fConditionSet = conditionSet;
+  TaskScheduler::BackgroundHandlerProc* handler
+    = (TaskScheduler::BackgroundHandlerProc*)&tcpReadHandler;
+  fEnv.taskScheduler().setBackgroundHandling(fOurSocketNum, conditionSet, handler, this);
+}
+
+Boolean SocketDescriptor::flushOutboundQueue() {
+  while (fOutboundQueueHead != NULL) {
+    // Send as much of the queued data as we can, at once:
+    struct iovec iov[RTPINTERFACE_MAX_TCP_SEND_IOVECS];
+    unsigned numIOVectors = 0;
+    unsigned numBytesToSend = 0;
+    for (TCPOutboundQueueEntry* entry = fOutboundQueueHead;
+	 entry != NULL && numIOVectors + 2 <= RTPINTERFACE_MAX_TCP_SEND_IOVECS; entry = entry->fNext) {
+      numIOVectors += entry->getRemainingData(&iov[numIOVectors]);
+      numBytesToSend += entry->numBytesRemaining();
+    }
+
+    int sendResult = sendIOVectors(fOurSocketNum, iov, numIOVectors);
+    if (sendResult < 0) {
+      int err = fEnv.getErrno();
+      if (err != EAGAIN && err != EWOULDBLOCK) return False;
+      break; // the socket's send buffer is full again
+    }
+
+    // Remove the entries that have now been sent completely:
+    unsigned numBytesSent = (unsigned)sendResult;
+    fOutboundQueueSize -= numBytesSent;
+    while (numBytesSent > 0) {
+      TCPOutboundQueueEntry* entry = fOutboundQueueHead;
+      unsigned numBytesRemaining = entry->numBytesRemaining();
+      if (numBytesSent < numBytesRemaining) {
+	entry->fNumBytesSent += numBytesSent;
+	break;
+      }
+
+      numBytesSent -= numBytesRemaining;
+      fOutboundQueueHead = entry->fNext;
+      if (fOutboundQueueHead == NULL) fOutboundQueueTail = NULL;
+      delete entry;
+    }
+
+    if ((unsigned)sendResult < numBytesToSend) break; // the socket's send buffer is full again
+  }
+
+  updateBackgroundHandling();
+  return True;
+}
+
+void SocketDescriptor::dropQueuedPackets() {
+  // Drop the queued (RTP) packets that haven't been started yet.  (A partially-sent packet must be completed,
+  // to keep the TCP stream consistent.)
+  TCPOutboundQueueEntry** entryPtr = &fOutboundQueueHead;
+  fOutboundQueueTail = NULL;
+  while (*entryPtr != NULL) {
+    TCPOutboundQueueEntry* entry = *entryPtr;
+    if (entry->fIsDroppable && entry->fNumBytesSent == 0) {
+      fOutboundQueueSize -= entry->numBytesRemaining();
+      *entryPtr = entry->fNext;
+      delete entry;
+    } else {
+      fOutboundQueueTail = entry;
+      entryPtr = &entry->fNext;
+    }
+  }
+
+  updateBackgroundHandling();
+}
+
+void SocketDescriptor::finishOutboundQueue() {
+  // We're no longer using the socket for RTP/RTCP-over-TCP, but it may still be used (e.g., by the RTSP server).
+  // Therefore, finish sending a partially-sent packet - to keep the TCP stream consistent - and any queued
+  // RTCP packets or RTSP responses, blocking if necessary.  (The other queued packets are dropped.)
+  if (fOutboundQueueHead != NULL && !fReadErrorOccurred) {
+    makeSocketBlocking(fOurSocketNum, RTPINTERFACE_BLOCKING_WRITE_TIMEOUT_MS);
+    for (TCPOutboundQueueEntry* entry = fOutboundQueueHead; entry != NULL; entry = entry->fNext) {
+      if (entry->fIsDroppable && entry->fNumBytesSent == 0) continue;
+
+      struct iovec iov[2];
+      unsigned numIOVectors = entry->getRemainingData(iov);
+      if (sendIOVectors(fOurSocketNum, iov, numIOVectors) != (int)entry->numBytesRemaining()) break;
+    }
+    makeSocketNonBlocking(fOurSocketNum);
+  }
+
+  while (fOutboundQueueHead != NULL) {
+    TCPOutboundQueueEntry* entry = fOutboundQueueHead;
+    fOutboundQueueHead = entry->fNext;
+    delete entry;
+  }
+  fOutboundQueueTail = NULL;
+  fOutboundQueueSize = 0;
+}
+
 void SocketDescriptor::tcpReadHandler(SocketDescriptor* socketDescriptor, int mask) {
+  if ((mask&SOCKET_WRITABLE) != 0) {
+    // The socket can accept more of our queued data:
+    if (!socketDescriptor->flushOutboundQueue()) {
+      // The socket is now unusable (we treat this like a read error, so that the RTSP connection gets closed):
+      socketDescriptor->fReadErrorOccurred = True;
+      delete socketDescriptor;
+      return;
+    }
+    if ((mask&(SOCKET_READABLE|SOCKET_EXCEPTION)) == 0) return;
+  }
+
   // Call the read handler until it returns false, with a limit to avoid starving other sockets
   unsigned count = 2000;
   socketDescriptor->fAreInReadHandlerLoop = True;
@@ -872,7 +872,8 @@ void RTSPServer::RTSPClientConnection::handleRequestBytes(int newBytesRead) {
 #ifdef DEBUG
     fprintf(stderr, "sending response: %s", fResponseBuffer);
 #endif
-    send(fClientOutputSocket, (char const*)fResponseBuffer, strlen((char*)fResponseBuffer), 0);
+    // (If RTP/RTCP-over-TCP packets are queued on this socket, the response is queued after them.)
+    RTPInterface::sendOverStreamSocket(envir(), fClientOutputSocket, fResponseBuffer, strlen((char*)fResponseBuffer));
     
     if (playAfterSetup) {
       // The client has asked for streaming to commence now, rather than after a
@@ -43,6 +43,11 @@ typedef void RTCPAppHandlerFunc(void* clientData,
 				u_int8_t subtype, u_int32_t nameBytes/*big-endian order*/,
 				u_int8_t* appDependentData, unsigned appDependentDataSize);
 
+typedef void RTCPGenericNACKHandlerFunc(void* clientData, u_int32_t mediaSSRC,
+					u_int16_t packetID, u_int16_t bitmaskOfLostPackets);
+    // "packetID" is the sequence number of a lost packet, "bitmaskOfLostPackets" has bit i set
+    // if the packet "packetID"+i+1 is lost as well (RFC 4585, section 6.2.1)
+
 class RTCPMemberDatabase; // forward
 
 typedef void ByeWithReasonHandlerFunc(void* clientData, char const* reason);
@@ -96,6 +101,10 @@ public:
   void setAppHandler(RTCPAppHandlerFunc* handlerTask, void* clientData);
       // Assigns a handler routine to be called whenever an "APP" packet arrives.  (To turn off
       // handling, call the function again with "handlerTask" (and "clientData") as NULL.)
+  void setGenericNACKHandler(RTCPGenericNACKHandlerFunc* handlerTask, void* clientData);
+      // Assigns a handler routine to be called for each lost packets' entry of an incoming
+      // "Generic NACK" feedback packet (RFC 4585).  (To turn off handling, call the function
+      // again with "handlerTask" (and "clientData") as NULL.)
   void sendAppPacket(u_int8_t subtype, char const* name,
 		     u_int8_t* appDependentData, unsigned appDependentDataSize);
       // Sends a custom RTCP "APP" packet to the peer(s).  The parameters correspond to their
@@ -199,6 +208,8 @@ private:
   AddressPortLookupTable* fSpecificRRHandlerTable;
   RTCPAppHandlerFunc* fAppHandlerTask;
   void* fAppHandlerClientData;
+  RTCPGenericNACKHandlerFunc* fGenericNACKHandlerTask;
+  void* fGenericNACKHandlerClientData;
 
 public: // because this stuff is used by an external "C" function
   void schedule(double nextTime);
@@ -40,6 +40,8 @@ typedef void ServerRequestAlternativeByteHandler(void* instance, u_int8_t reques
 // the same TCP connection.  A RTSP server implementation would supply a function like this - as a parameter to
 // "ServerMediaSubsession::startStream()".
 
+class TCPOutboundPacket; // used to implement the RTP-over-TCP send queues
+
 class tcpStreamRecord {
 public:
   tcpStreamRecord(int streamSocketNum, unsigned char streamChannelId,
@@ -65,8 +67,31 @@ public:
   static void setServerRequestAlternativeByteHandler(UsageEnvironment& env, int socketNum,
 						     ServerRequestAlternativeByteHandler* handler, void* clientData);
   static void clearServerRequestAlternativeByteHandler(UsageEnvironment& env, int socketNum);
+  static Boolean sendOverStreamSocket(UsageEnvironment& env, int socketNum, u_int8_t const* data, unsigned dataSize);
+      // Sends (e.g., RTSP response) data over a TCP socket that may also be used for RTP/RTCP-over-TCP.
+      // If RTP/RTCP packets are waiting to be sent over the socket, the data is queued after them
+      // (rather than being interleaved with a partially-sent packet).
 
   Boolean sendPacket(unsigned char* packet, unsigned packetSize);
+  Boolean sendPackets(unsigned char* const* packets, unsigned const* packetSizes, unsigned numPackets,
+		      Boolean const* syncPoints = NULL);
+      // like "sendPacket()", but the UDP packets are sent at once (see "Groupsock::outputBatch()")
+      // "syncPoints" (optional) tells which packets begin a key frame (see "maxTCPQueueSize" below)
+
+  static unsigned maxTCPQueueSize;
+      // The max number of bytes waiting to be sent over each TCP socket (when the socket's send buffer
+      // is full).  We never block on a TCP socket; instead, the packets that cannot be sent right away
+      // are queued (the packet data is copied once, and shared by all of the TCP sockets that it is sent over).
+      // If this queue would overflow, then the RTP packets that have not been sent yet are dropped,
+      // and the RTP packets that follow are skipped until the next sync point (the start of a key frame,
+      // if "syncPoints" are given; otherwise the start of the next frame).  RTCP packets and RTSP responses
+      // are never dropped.
+  void setTCPOverflowHandler(TaskFunc* handler, void* clientData) {
+    fTCPOverflowHandler = handler;
+    fTCPOverflowHandlerClientData = clientData;
+  }
+      // The handler is called whenever our packets start being skipped on one of our TCP sockets
+      // (e.g., to request a key frame, so that the skipping ends soon).
   void startNetworkReading(TaskScheduler::BackgroundHandlerProc*
                            handlerProc);
   Boolean handleRead(unsigned char* buffer, unsigned bufferMaxSize,
@@ -99,7 +124,8 @@ public:
 private:
   // Helper functions for sending a RTP or RTCP packet over a TCP connection:
   Boolean sendRTPorRTCPPacketOverTCP(unsigned char* packet, unsigned packetSize,
-				     int socketNum, unsigned char streamChannelId);
+				     int socketNum, unsigned char streamChannelId,
+				     int syncPoint, TCPOutboundPacket*& queuedCopy);
   Boolean sendDataOverTCP(int socketNum, u_int8_t const* data, unsigned dataSize, Boolean forceSendToSucceed);
 
 private:
@@ -116,6 +142,9 @@ private:
 
   AuxHandlerFunc* fAuxReadHandlerFunc;
   void* fAuxReadHandlerClientData;
+
+  TaskFunc* fTCPOverflowHandler;
+  void* fTCPOverflowHandlerClientData;
 };
 
 #endif
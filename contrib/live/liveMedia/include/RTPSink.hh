@@ -84,6 +84,10 @@ public:
   void removeStreamSocket(int sockNum, unsigned char streamChannelId) {
     fRTPInterface.removeStreamSocket(sockNum, streamChannelId);
   }
+  void setTCPOverflowHandler(TaskFunc* handler, void* clientData) {
+    fRTPInterface.setTCPOverflowHandler(handler, clientData);
+  }
+      // called when a TCP receiver falls behind (see "RTPInterface::maxTCPQueueSize")
   unsigned& estimatedBitrate() { return fEstimatedBitrate; } // kbps; usually 0 (i.e., unset)
 
   u_int32_t SSRC() const {return fSSRC;}
@@ -0,0 +1,110 @@
+#ifndef LIRS_RTSP_VIDEO_SERVER_BITRATE_CONTROLLER_HPP
+#define LIRS_RTSP_VIDEO_SERVER_BITRATE_CONTROLLER_HPP
+
+#include <UsageEnvironment.hh>
+
+#include <sys/time.h>
+
+#include <cstdint>
+
+#include "RtpFanout.hpp"
+#include "Transcoder.hpp"
+#include "config/params/Configuration.hpp"
+
+namespace LIRS {
+
+    /**
+     * Adapts the camera's encoder bitrate to the capacity of the clients' links.
+     *
+     * The RTCP receiver reports of the fan-out's clients are evaluated periodically: the bitrate is decreased
+     * in proportion to the worst reported packet loss when it exceeds the high threshold and is increased
+     * step by step when the loss stays below the low threshold (and the jitter is low) for the hold time
+     * after the last change. The loss between the thresholds keeps the bitrate (hysteresis).
+     * The bitrate stays within the configured floor and ceiling.
+     *
+     * Each event loop streaming the camera has its own controller, the encoder follows the lowest asked bitrate.
+     * Accessed by the event loop only.
+     */
+    class BitrateController {
+
+    public:
+
+        /**
+         * Constructs the controller and starts evaluating the reports.
+         *
+         * @param env - environment (see Live555 docs).
+         * @param transcoder - camera's transcoder (the bitrate must be adjustable, see Transcoder).
+         * @param fanout - camera's fan-out (the sinks of the clients).
+         * @param params - floor, ceiling and thresholds.
+         */
+        BitrateController(UsageEnvironment &env, Transcoder &transcoder, RtpFanout const &fanout,
+                          lirs::config::params::AdaptiveBitrateParameters const &params);
+
+        /**
+         * Stops evaluating the reports, the encoder is no longer limited by the controller.
+         */
+        ~BitrateController();
+
+        BitrateController(BitrateController const &) = delete;
+
+        BitrateController &operator=(BitrateController const &) = delete;
+
+        /**
+         * Returns the bitrate asked by the controller in kbps (0 - not asked, no clients).
+         */
+        uint16_t getTargetBitrate() const;
+
+    private:
+
+        /**
+         * Share of the reported loss the bitrate is decreased by (e.g. by 10% for 20% loss).
+         */
+        constexpr static double DECREASE_FACTOR = 0.5;
+
+        /**
+         * Bitrate increase step.
+         */
+        constexpr static double INCREASE_FACTOR = 1.08;
+
+        UsageEnvironment &env;
+
+        Transcoder &transcoder;
+
+        RtpFanout const &fanout;
+
+        lirs::config::params::AdaptiveBitrateParameters params;
+
+        /**
+         * Controller's id registered with the transcoder.
+         */
+        size_t controllerId;
+
+        uint16_t targetBitrate;
+
+        /**
+         * Time of the last evaluation (wall clock, the reports received afterwards are new).
+         */
+        timeval lastEvaluationTime;
+
+        /**
+         * Time of the last bitrate change (monotonic, in microseconds).
+         */
+        int64_t lastChangeTimeUs;
+
+        TaskToken evaluationTask;
+
+        /**
+         * Evaluates the reports received since the last evaluation and adjusts the bitrate.
+         */
+        void evaluate();
+
+        static void evaluate0(void *);
+
+        /**
+         * Asks the transcoder for the bitrate.
+         */
+        void setTargetBitrate(uint16_t bitrate);
+    };
+}
+
+#endif //LIRS_RTSP_VIDEO_SERVER_BITRATE_CONTROLLER_HPP
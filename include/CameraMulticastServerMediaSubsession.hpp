@@ -0,0 +1,55 @@
+#ifndef LIRS_RTSP_VIDEO_SERVER_CAMERA_MULTICAST_SERVER_MEDIA_SUBSESSION_HPP
+#define LIRS_RTSP_VIDEO_SERVER_CAMERA_MULTICAST_SERVER_MEDIA_SUBSESSION_HPP
+
+#include <PassiveServerMediaSubsession.hh>
+
+#include "Transcoder.hpp"
+
+namespace LIRS {
+
+    /**
+     * Live555 multicast server media subsession. The camera's stream is sent once to the multicast group
+     * by a single RTP sink, the clients just join the group (no per-client streams).
+     */
+    class CameraMulticastServerMediaSubsession : public PassiveServerMediaSubsession {
+
+    public:
+
+        /**
+         * Creates the subsession.
+         *
+         * @param rtpSink - sink sending the stream to the multicast group.
+         * @param rtcpInstance - RTCP of the sink (may be nullptr).
+         * @param transcoder - encodes the stream (describes it via the parameter sets, asked for key frames).
+         * @param udpDatagramSize - UDP datagram size in bytes.
+         */
+        static CameraMulticastServerMediaSubsession *createNew(RTPSink &rtpSink, RTCPInstance *rtcpInstance,
+                                                               Transcoder &transcoder, size_t udpDatagramSize);
+
+    protected:
+
+        CameraMulticastServerMediaSubsession(RTPSink &rtpSink, RTCPInstance *rtcpInstance, Transcoder &transcoder,
+                                             size_t udpDatagramSize);
+
+        /**
+         * Describes the multicast stream using the encoder's parameter sets
+         * (the sink may be a fan-out one not knowing them).
+         */
+        char const *sdpLines() override;
+
+        void startStream(unsigned clientSessionId, void *streamToken, TaskFunc *rtcpRRHandler,
+                         void *rtcpRRHandlerClientData, unsigned short &rtpSeqNum, unsigned &rtpTimestamp,
+                         ServerRequestAlternativeByteHandler *serverRequestAlternativeByteHandler,
+                         void *serverRequestAlternativeByteHandlerClientData) override;
+
+    private:
+
+        RTPSink &rtpSink;
+
+        Transcoder &transcoder;
+
+        size_t udpDatagramSize;
+    };
+}
+
+#endif //LIRS_RTSP_VIDEO_SERVER_CAMERA_MULTICAST_SERVER_MEDIA_SUBSESSION_HPP
@@ -3,11 +3,20 @@
 
 #include <OnDemandServerMediaSubsession.hh>
 #include <StreamReplicator.hh>
+#include <H264VideoRTPSink.hh>
+#include <H264VideoStreamDiscreteFramer.hh>
 #include <H265VideoRTPSink.hh>
 #include <H265VideoStreamDiscreteFramer.hh>
+#include <VP8VideoRTPSink.hh>
+#include <VP9VideoRTPSink.hh>
 
+#include "FanoutRTPSink.hpp"
+#include "GopCache.hpp"
+#include "RtpFanout.hpp"
+#include "Transcoder.hpp"
 #include "utils/Logger.hpp"
 #include "Config.hpp"
+#include "config/params/Configuration.hpp"
 
 namespace LIRS {
 
@@ -19,7 +28,27 @@ namespace LIRS {
     public:
 
         static CameraUnicastServerMediaSubsession *
-        createNew(UsageEnvironment &env, StreamReplicator *replicator, size_t estBitrate, size_t udpDatagramSize);
+        createNew(UsageEnvironment &env, StreamReplicator *replicator, Transcoder &transcoder,
+                  size_t udpDatagramSize, GopCache const *gopCache = nullptr);
+
+        /**
+         * Creates the subsession whose clients share the packets of the camera's fan-out.
+         */
+        static CameraUnicastServerMediaSubsession *
+        createNew(UsageEnvironment &env, RtpFanout *fanout, Transcoder &transcoder, size_t udpDatagramSize);
+
+        /**
+         * Whether the transcoder's stream can be described without reading it (the parameter sets are known).
+         */
+        static bool isDescribable(Transcoder const &transcoder);
+
+        /**
+         * Creates the codec's RTP sink (packetizes the stream on its own).
+         * The sink describes the stream using the transcoder's parameter sets if they are known.
+         */
+        static RTPSink *createCodecRTPSink(UsageEnvironment &env, Groupsock *rtpGroupsock,
+                                           unsigned char rtpPayloadTypeIfDynamic, Transcoder &transcoder,
+                                           size_t udpDatagramSize);
 
     protected:
 
@@ -28,6 +57,21 @@ namespace LIRS {
          */
         StreamReplicator *replicator;
 
+        /**
+         * Sends the shared packets to the clients (nullptr - each client has its own replica and packetization).
+         */
+        RtpFanout *fanout;
+
+        /**
+         * Encodes the video stream (asked for key frames when clients join).
+         */
+        Transcoder &transcoder;
+
+        /**
+         * Codec of the video stream (selects the framer and the RTP sink).
+         */
+        lirs::config::params::VideoCodec codec;
+
         /**
          * Estimated bitrate of the video stream.
          */
@@ -38,11 +82,26 @@ namespace LIRS {
          */
         size_t udpDatagramSize;
 
+        /**
+         * Current group of pictures new clients are primed from (nullptr - clients wait for a key frame).
+         */
+        GopCache const *gopCache;
+
 
         CameraUnicastServerMediaSubsession(UsageEnvironment &env,
                                            StreamReplicator *replicator,
-                                           size_t estBitrate,
-                                           size_t udpDatagramSize);
+                                           RtpFanout *fanout,
+                                           Transcoder &transcoder,
+                                           size_t udpDatagramSize,
+                                           GopCache const *gopCache);
+
+
+        /**
+         * Describes the stream right away using the encoder's parameter sets (no dummy source and sink reading
+         * the stream). Falls back to the default implementation if the parameter sets are unknown.
+         * Announces the generic NACK feedback (and the RTX stream) if the fan-out resends the lost packets.
+         */
+        char const *sdpLines() override;
 
 
         FramedSource *createNewStreamSource(unsigned clientSessionId, unsigned &estBitrate) override;
@@ -52,6 +111,24 @@ namespace LIRS {
                                   unsigned char rtpPayloadTypeIfDynamic,
                                   FramedSource *inputSource) override;
 
+
+        /**
+         * Creates the client's RTCP instance. The client's generic NACKs are passed to its sink
+         * if the fan-out resends the lost packets.
+         */
+        RTCPInstance *createRTCP(Groupsock *RTCPgs, unsigned totSessionBW, unsigned char const *cname,
+                                 RTPSink *sink) override;
+
+
+        void startStream(unsigned clientSessionId, void *streamToken, TaskFunc *rtcpRRHandler,
+                         void *rtcpRRHandlerClientData, unsigned short &rtpSeqNum, unsigned &rtpTimestamp,
+                         ServerRequestAlternativeByteHandler *serverRequestAlternativeByteHandler,
+                         void *serverRequestAlternativeByteHandlerClientData) override;
+
+        /**
+         * Requests a key frame for a TCP client that fell behind (called by the client's sink).
+         */
+        static void requestKeyFrame0(void *clientData);
     };
 }
 
@@ -0,0 +1,96 @@
+#ifndef LIRS_RTSP_VIDEO_SERVER_EPOLL_TASK_SCHEDULER_HPP
+#define LIRS_RTSP_VIDEO_SERVER_EPOLL_TASK_SCHEDULER_HPP
+
+#include <BasicUsageEnvironment0.hh>
+
+#include <sys/epoll.h>
+
+#include <unordered_map>
+
+#include "EventTriggerRegistry.hpp"
+
+namespace LIRS {
+
+    /**
+     * Task scheduler waiting for the socket events with epoll (Linux) instead of select().
+     *
+     * No FD_SETSIZE limit on the socket numbers, the cost of a wakeup depends on the number of ready sockets
+     * rather than on the highest socket number. All the ready sockets are handled in a single step.
+     * The event triggers (see EventTriggerRegistry) wake the event loop up via eventfd (no periodic scheduler tick).
+     */
+    class EpollTaskScheduler : public BasicTaskScheduler0 {
+
+    public:
+
+        /**
+         * Creates the scheduler.
+         *
+         * @return scheduler or nullptr if epoll or eventfd is not available.
+         */
+        static EpollTaskScheduler *createNew();
+
+        ~EpollTaskScheduler() override;
+
+        void SingleStep(unsigned maxDelayTime = 0) override;
+
+        void setBackgroundHandling(int socketNum, int conditionSet, BackgroundHandlerProc *handlerProc,
+                                   void *clientData) override;
+
+        void moveSocketHandling(int oldSocketNum, int newSocketNum) override;
+
+        EventTriggerId createEventTrigger(TaskFunc *eventHandlerProc) override;
+
+        void deleteEventTrigger(EventTriggerId eventTriggerId) override;
+
+        /**
+         * Marks the event as pending and wakes the event loop up (may be called from any thread).
+         */
+        void triggerEvent(EventTriggerId eventTriggerId, void *clientData = nullptr) override;
+
+        /**
+         * Returns the event triggers (e.g. to create a trigger with a payload queue).
+         */
+        EventTriggerRegistry &getEventTriggerRegistry();
+
+    protected:
+
+        EpollTaskScheduler(int epollFd, int eventFd);
+
+    private:
+
+        /**
+         * Max number of socket events handled in a single step.
+         */
+        constexpr static int MAX_NUM_EVENTS = 256;
+
+        /**
+         * Socket's handler (see setBackgroundHandling).
+         */
+        struct Handler {
+
+            int conditionSet;
+
+            BackgroundHandlerProc *handlerProc;
+
+            void *clientData;
+        };
+
+        int epollFd;
+
+        EventTriggerRegistry eventTriggers;
+
+        std::unordered_map<int, Handler> handlers;
+
+        /**
+         * Registers the socket's events with epoll (or unregisters the socket if there are none).
+         */
+        void updateEpollEvents(int socketNum, uint32_t epollEvents);
+
+        /**
+         * Returns the epoll events corresponding to the handler's condition set.
+         */
+        static uint32_t toEpollEvents(int conditionSet);
+    };
+}
+
+#endif //LIRS_RTSP_VIDEO_SERVER_EPOLL_TASK_SCHEDULER_HPP
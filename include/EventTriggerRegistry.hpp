@@ -0,0 +1,164 @@
+#ifndef LIRS_RTSP_VIDEO_SERVER_EVENT_TRIGGER_REGISTRY_HPP
+#define LIRS_RTSP_VIDEO_SERVER_EVENT_TRIGGER_REGISTRY_HPP
+
+#include <UsageEnvironment.hh>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "utils/BoundedQueue.hpp"
+
+namespace LIRS {
+
+    /**
+     * Event triggers of a task scheduler (see TaskScheduler::createEventTrigger).
+     *
+     * Unlike Live555's 32-bit trigger mask the number of triggers is limited by MAX_NUM_TRIGGERS only,
+     * the trigger ids are indices (not bits, so the ids cannot be combined).
+     *
+     * A fired trigger is pushed onto a lock-free list of pending triggers, the event loop is woken up via eventfd
+     * by the first pending trigger only. A trigger fired several times before it is handled is handled once
+     * (coalesced), the pending triggers are handled in the order they were fired.
+     *
+     * A trigger may have a queue of payloads posted by the producers along with firing the trigger
+     * (lock-free, no locking on either side), its handler takes them out.
+     *
+     * The triggers are created, deleted and handled by the event loop's thread, fired from any thread.
+     */
+    class EventTriggerRegistry {
+
+    public:
+
+        /**
+         * Max number of the triggers existing at the same time.
+         */
+        constexpr static size_t MAX_NUM_TRIGGERS = 65536;
+
+        /**
+         * Constructs the registry.
+         *
+         * @param eventFd - eventfd the event loop is woken up with (owned by the registry).
+         */
+        explicit EventTriggerRegistry(int eventFd);
+
+        ~EventTriggerRegistry();
+
+        EventTriggerRegistry(EventTriggerRegistry const &) = delete;
+
+        EventTriggerRegistry &operator=(EventTriggerRegistry const &) = delete;
+
+        /**
+         * Creates a new trigger.
+         *
+         * @param handler - called by the event loop when the trigger is fired.
+         * @param maxNumPayloads - capacity of the trigger's payload queue (0 - no payloads).
+         * @return trigger's id or 0 if there are too many triggers.
+         */
+        EventTriggerId create(TaskFunc *handler, size_t maxNumPayloads = 0);
+
+        /**
+         * Deletes the trigger. The payloads not taken out are dropped (not freed).
+         */
+        void remove(EventTriggerId triggerId);
+
+        /**
+         * Fires the trigger (any thread).
+         *
+         * @param clientData - passed to the handler (the last one wins if the trigger is fired several times).
+         */
+        void trigger(EventTriggerId triggerId, void *clientData);
+
+        /**
+         * Queues the payload for the trigger's handler and fires the trigger (any thread).
+         *
+         * @return true - if the payload is queued, false - if the trigger's payload queue is full (nothing is fired).
+         */
+        bool post(EventTriggerId triggerId, void *payload, void *clientData);
+
+        /**
+         * Takes the next payload out of the trigger's queue (called by the trigger's handler).
+         *
+         * @return true - if there was a payload, otherwise - false.
+         */
+        bool takePayload(EventTriggerId triggerId, void *&payload);
+
+        /**
+         * Calls the handlers of the pending triggers (called by the event loop).
+         */
+        void handlePending();
+
+        /**
+         * Returns the eventfd becoming readable when a trigger is fired.
+         */
+        int getEventFd() const;
+
+        /**
+         * Resets the eventfd after it became readable.
+         */
+        void acknowledgeWakeup();
+
+    private:
+
+        /**
+         * Number of triggers allocated at once (the allocated triggers are never moved, so the producers
+         * can access them while new ones are being created).
+         */
+        constexpr static size_t CHUNK_SIZE = 64;
+
+        constexpr static size_t MAX_NUM_CHUNKS = MAX_NUM_TRIGGERS / CHUNK_SIZE;
+
+        struct Trigger {
+
+            EventTriggerId id = 0;
+
+            /**
+             * Accessed by the event loop only (nullptr - the trigger is deleted).
+             */
+            TaskFunc *handler = nullptr;
+
+            /**
+             * Whether the trigger is deleted while pending (its id is reused after it is taken off the pending list).
+             * Accessed by the event loop only.
+             */
+            bool isRetired = false;
+
+            std::atomic<void *> clientData{nullptr};
+
+            /**
+             * Whether the trigger is on the pending list (fired, but not handled yet).
+             */
+            std::atomic<bool> isPending{false};
+
+            /**
+             * Next pending trigger.
+             */
+            Trigger *nextPending = nullptr;
+
+            std::unique_ptr<lirs::utils::BoundedQueue<void *>> payloads;
+        };
+
+        int eventFd;
+
+        std::atomic<Trigger *> chunks[MAX_NUM_CHUNKS];
+
+        /**
+         * Most recently fired trigger (the pending triggers are linked in the reverse order).
+         */
+        std::atomic<Trigger *> pendingHead;
+
+        /**
+         * Number of the trigger ids ever used, the ids of the deleted triggers are reused first.
+         */
+        size_t numUsedIds;
+
+        std::vector<EventTriggerId> freeIds;
+
+        /**
+         * Returns the trigger or nullptr if there is no such one.
+         */
+        Trigger *find(EventTriggerId triggerId) const;
+    };
+}
+
+#endif //LIRS_RTSP_VIDEO_SERVER_EVENT_TRIGGER_REGISTRY_HPP
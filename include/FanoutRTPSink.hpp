@@ -0,0 +1,166 @@
+#ifndef LIRS_RTSP_VIDEO_SERVER_FANOUT_RTP_SINK_HPP
+#define LIRS_RTSP_VIDEO_SERVER_FANOUT_RTP_SINK_HPP
+
+#include <FramedSource.hh>
+#include <RTPSink.hh>
+
+#include <memory>
+#include <vector>
+
+#include "RtpFanout.hpp"
+#include "RtpPacer.hpp"
+#include "RtpPacketHistory.hpp"
+
+namespace LIRS {
+
+    /**
+     * Client's RTP sink sending the packets shared by the camera's fan-out.
+     * Keeps its own sequence numbers, timestamps and SSRC, so the client sees a regular RTP stream (and RTCP SR).
+     *
+     * If the fan-out retransmits the lost packets, the recently sent packets are kept in the history and the ones
+     * reported by the client's generic NACKs are resent: as is or as a separate RTX stream (RFC 4588, own SSRC,
+     * sequence numbers and payload type, the payload is prefixed with the original sequence number).
+     */
+    class FanoutRTPSink : public RTPSink {
+
+    public:
+
+        static FanoutRTPSink *createNew(UsageEnvironment &env, Groupsock *rtpGroupsock, unsigned char rtpPayloadType,
+                                        RtpFanout &fanout);
+
+        /**
+         * Fills in the client's header fields of the shared packets and sends them at once
+         * (or queues them for the client's pacer if the fan-out is paced).
+         */
+        void send(std::vector<std::shared_ptr<RtpPacket>> const &packets);
+
+        /**
+         * Returns the client's pacer (nullptr - the packets are not paced).
+         */
+        RtpPacer const *getPacer() const;
+
+        /**
+         * Starts keeping the sent packets for retransmission if the fan-out resends the lost packets
+         * (the client's RTCP instance passes the generic NACKs to the sink).
+         */
+        void enableRetransmission();
+
+        /**
+         * Resends the packets reported lost by the client's RTCP generic NACK (see RTCPInstance).
+         * The client data is the sink.
+         */
+        static void handleGenericNACK0(void *clientData, u_int32_t mediaSSRC, u_int16_t packetID,
+                                       u_int16_t bitmaskOfLostPackets);
+
+        /**
+         * Returns the payload type of the RTX stream associated with the stream's payload type.
+         */
+        static unsigned char getRtxPayloadType(unsigned char rtpPayloadType);
+
+        void stopPlaying() override;
+
+        char const *sdpMediaType() const override;
+
+    protected:
+
+        FanoutRTPSink(UsageEnvironment &env, Groupsock *rtpGroupsock, unsigned char rtpPayloadType, RtpFanout &fanout);
+
+        ~FanoutRTPSink() override;
+
+        /**
+         * Attaches the sink to the fan-out (the packets are pushed to the sink).
+         */
+        Boolean continuePlaying() override;
+
+    private:
+
+        RtpFanout &fanout;
+
+        bool isAttached;
+
+        /**
+         * Spreads each frame's packets over the pacing window (nullptr - no pacing).
+         */
+        std::unique_ptr<RtpPacer> pacer;
+
+        /**
+         * Packets being sent (reused between the calls).
+         */
+        std::vector<unsigned char *> packetData;
+
+        std::vector<unsigned> packetSizes;
+
+        std::vector<Boolean> syncPoints;
+
+        /**
+         * Recently sent packets (nullptr - the lost packets are not resent).
+         */
+        std::unique_ptr<RtpPacketHistory> history;
+
+        bool isRtxEnabled;
+
+        /**
+         * SSRC and the next sequence number of the RTX stream.
+         */
+        u_int32_t rtxSSRC;
+
+        u_int16_t rtxSeqNo;
+
+        /**
+         * RTX packet being sent (reused between the calls).
+         */
+        std::vector<uint8_t> rtxPacket;
+
+        /**
+         * Number of the packets reported lost by the client and the number of the resent ones.
+         */
+        uint64_t numLostPackets;
+
+        uint64_t numRetransmittedPackets;
+
+        /**
+         * Fills in the client's header fields of the packets and sends them at once.
+         */
+        void transmit(std::vector<std::shared_ptr<RtpPacket>> const &packets);
+
+        /**
+         * Fills in the client's header fields of the packet, updates the RTCP SR statistics
+         * and remembers the packet for retransmission.
+         */
+        void writeHeader(std::shared_ptr<RtpPacket> const &packet);
+
+        /**
+         * Resends the lost packets which are still kept in the history.
+         */
+        void handleGenericNACK(u_int32_t mediaSSRC, u_int16_t packetID, u_int16_t bitmaskOfLostPackets);
+
+        /**
+         * Sends the packet again with the header fields it was sent with (or as an RTX packet).
+         */
+        void retransmit(RtpPacketHistory::Entry const &entry);
+
+        /**
+         * Fills in the RTP header (no padding, extension and CSRCs).
+         */
+        static void fillHeader(uint8_t *header, bool isMarked, unsigned char payloadType, u_int16_t seqNo,
+                               u_int32_t timestamp, u_int32_t ssrc);
+    };
+
+    /**
+     * Input source of the client's sink. Delivers nothing, the packets come from the fan-out.
+     */
+    class FanoutClientSource : public FramedSource {
+
+    public:
+
+        static FanoutClientSource *createNew(UsageEnvironment &env);
+
+    protected:
+
+        explicit FanoutClientSource(UsageEnvironment &env);
+
+        void doGetNextFrame() override;
+    };
+}
+
+#endif //LIRS_RTSP_VIDEO_SERVER_FANOUT_RTP_SINK_HPP
@@ -0,0 +1,112 @@
+#ifndef LIRS_RTSP_VIDEO_SERVER_GOP_CACHE_HPP
+#define LIRS_RTSP_VIDEO_SERVER_GOP_CACHE_HPP
+
+#include <sys/time.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "NalUnit.hpp"
+#include "config/params/Configuration.hpp"
+
+namespace LIRS {
+
+    /**
+     * Current group of pictures of the stream: the last key frame (along with its parameter sets)
+     * and the frames following it. A new client is primed from the cache, so it can start decoding
+     * immediately instead of waiting for the next key frame.
+     *
+     * The units reference the encoder's packets (no copying). Accessed by the event loop only.
+     */
+    class GopCache {
+
+    public:
+
+        /**
+         * Cached encoded unit along with the capture time of the frame it belongs to.
+         */
+        struct Unit {
+
+            NalUnit data;
+
+            timeval presentationTime;
+        };
+
+        /**
+         * How many times faster the cached frames are played back when a client is primed
+         * (they are squeezed before the live ones).
+         */
+        constexpr static int64_t PRIMED_TIME_SCALE = 32;
+
+        /**
+         * Constructs the cache.
+         *
+         * @param codec - codec of the stream (key frames detection).
+         * @param maxSize - max number of cached units (the cache is disabled if 0).
+         */
+        GopCache(lirs::config::params::VideoCodec codec, size_t maxSize);
+
+        /**
+         * Adds the delivered unit to the cache. The cache is restarted by the key frame,
+         * the units preceding the first key frame are ignored.
+         *
+         * @param data - encoded unit (referenced, not copied).
+         * @param presentationTime - frame's capture time.
+         */
+        void add(NalUnit const &data, timeval presentationTime);
+
+        /**
+         * Drops the cached units (e.g. the stream is stopped and the units become stale).
+         */
+        void clear();
+
+        bool isEnabled() const {
+            return maxSize > 0;
+        }
+
+        size_t size() const {
+            return units.size();
+        }
+
+        bool empty() const {
+            return units.empty();
+        }
+
+        Unit const &operator[](size_t index) const {
+            return units[index];
+        }
+
+        /**
+         * Returns the number of times the cache has been restarted (cached units indices are valid within a generation).
+         */
+        uint64_t getGeneration() const {
+            return generation;
+        }
+
+        /**
+         * Returns the presentation time of the cached frame squeezed before the reference time
+         * (the frames captured after it keep their presentation times).
+         *
+         * @param presentationTime - frame's capture time.
+         * @param referenceTimeUs - capture time (in microseconds) of the last cached frame when the priming started.
+         */
+        static timeval toPrimedTime(timeval presentationTime, int64_t referenceTimeUs);
+
+    private:
+
+        lirs::config::params::VideoCodec codec;
+
+        size_t maxSize;
+
+        std::vector<Unit> units;
+
+        uint64_t generation;
+
+        /**
+         * Whether the group of pictures is too large to be cached (until the next key frame).
+         */
+        bool isOverflown;
+    };
+}
+
+#endif //LIRS_RTSP_VIDEO_SERVER_GOP_CACHE_HPP
@@ -0,0 +1,89 @@
+#ifndef LIRS_RTSP_VIDEO_SERVER_GOP_PRIMING_FILTER_HPP
+#define LIRS_RTSP_VIDEO_SERVER_GOP_PRIMING_FILTER_HPP
+
+#include <FramedFilter.hh>
+
+#include "GopCache.hpp"
+
+namespace LIRS {
+
+    /**
+     * Primes the new client's stream (replica) from the GOP cache and then switches to the live stream.
+     *
+     * The cached frames are delivered at once with their presentation times squeezed right before the live ones,
+     * so the client decodes them immediately and displays the live frames without waiting for the next key frame.
+     * The cached units the live stream repeats (the frame being delivered at the moment of switching) are skipped.
+     */
+    class GopPrimingFilter : public FramedFilter {
+
+    public:
+
+        static GopPrimingFilter *createNew(UsageEnvironment &env, FramedSource *inputSource, GopCache const &gopCache);
+
+    protected:
+
+        GopPrimingFilter(UsageEnvironment &env, FramedSource *inputSource, GopCache const &gopCache);
+
+        void doGetNextFrame() override;
+
+        void doStopGettingFrames() override;
+
+    private:
+
+        enum class State : uint8_t {
+            PRIMING = 0, // delivering the cached units
+            JOINING,     // skipping the live units already delivered from the cache
+            LIVE         // delivering the live units
+        };
+
+        GopCache const &gopCache;
+
+        State state;
+
+        /**
+         * Cache generation the cursor belongs to.
+         */
+        uint64_t generation;
+
+        /**
+         * Index of the next cached unit to be delivered.
+         */
+        size_t cursor;
+
+        /**
+         * Capture time (in microseconds) of the last cached frame when the priming started.
+         * The frames captured before it are squeezed, the rest keep their presentation times.
+         */
+        int64_t referenceTimeUs;
+
+        /**
+         * Units of the last delivered cached frame (the live stream may repeat them).
+         */
+        std::vector<NalUnit> lastFrameUnits;
+
+        timeval lastFrameTime;
+
+        /**
+         * Delivers the next cached unit.
+         */
+        void deliverCachedUnit();
+
+        /**
+         * Requests the next live unit.
+         */
+        void getNextLiveFrame();
+
+        /**
+         * Whether the live unit has already been delivered from the cache.
+         */
+        bool isDelivered(unsigned frameSize, timeval presentationTime) const;
+
+        static void afterGettingFrame(void *clientData, unsigned frameSize, unsigned numTruncatedBytes,
+                                      timeval presentationTime, unsigned durationInMicroseconds);
+
+        void afterGettingFrame(unsigned frameSize, unsigned numTruncatedBytes, timeval presentationTime,
+                               unsigned durationInMicroseconds);
+    };
+}
+
+#endif //LIRS_RTSP_VIDEO_SERVER_GOP_PRIMING_FILTER_HPP
@@ -4,10 +4,12 @@
 #include <FramedSource.hh>
 #include <UsageEnvironment.hh>
 
-#include <mutex>
+#include <atomic>
 #include <thread>
 
+#include "GopCache.hpp"
 #include "Transcoder.hpp"
+#include "utils/BoundedQueue.hpp"
 
 namespace LIRS {
 
@@ -19,6 +21,27 @@ namespace LIRS {
 
         static LiveCamFramedSource *createNew(UsageEnvironment &env, Transcoder &transcoder);
 
+        /**
+         * Returns the number of encoded units dropped because the queue was full
+         * (including the units dropped afterwards until the next key frame).
+         */
+        uint64_t getNumDroppedUnits() const;
+
+        /**
+         * Returns the number of times the queue was full (data dropped or the encoder blocked).
+         */
+        uint64_t getNumOverflows() const;
+
+        /**
+         * Returns the current group of pictures of the delivered stream (used to prime new clients).
+         */
+        GopCache const &getGopCache() const;
+
+        /**
+         * Whether the last delivered unit ends its frame (the RTP packetizers mark its last packet).
+         */
+        bool isFrameEnd() const;
+
     protected:
 
         /**
@@ -48,28 +71,116 @@ namespace LIRS {
         EventTriggerId eventTriggerId;
 
         /**
-         * Mutex to access encoded data.
-         * @see encodedData
-         * @see deliverData()
+         * Encoded data along with the capture time of the frame it belongs to.
+         */
+        struct EncodedData {
+
+            /**
+             * Encoded unit referencing the encoder's packet (no copying).
+             */
+            NalUnit data;
+
+            /**
+             * Frame's capture time (wall clock), becomes the RTP timestamp.
+             */
+            timeval presentationTime;
+        };
+
+        /**
+         * Encoded data waiting to be delivered, in the order it is produced.
+         * Pushed by the encoding thread only, popped by the event loop only.
+         */
+        lirs::utils::BoundedQueue<EncodedData> encodedDataQueue;
+
+        /**
+         * What to do when the queue is full.
+         */
+        lirs::config::params::OverflowPolicy overflowPolicy;
+
+        /**
+         * Whether the frames are being read by the sink (doGetNextFrame is called until the streaming is stopped).
+         * The encoded data is not queued otherwise.
+         */
+        std::atomic<bool> isStreaming;
+
+        /**
+         * Whether the encoded data is dropped until the next key frame after the queue overflow.
+         * Accessed by the encoding thread only.
+         */
+        bool isDroppingUntilKeyFrame;
+
+        std::atomic<uint64_t> numDroppedUnits;
+
+        std::atomic<uint64_t> numOverflows;
+
+        /**
+         * Delivered units of the current group of pictures.
+         */
+        GopCache gopCache;
+
+        /**
+         * Whether the frames are no longer read (doStopGettingFrames is called).
+         */
+        bool isStopped;
+
+        /**
+         * Stops the streaming after the frames are no longer read.
          */
-        std::mutex encodedDataMutex;
+        TaskToken stopStreamingTask;
 
         /**
-         * Encoded data buffer.
+         * Whether the source is one of the transcoder's readers (until the idle timeout).
          */
-        std::vector<std::vector<uint8_t>> encodedDataBuffer;
+        bool isTranscoderAcquired;
 
         /**
-         * Encoded data.
+         * Pauses the transcoder after the idle timeout.
          */
-        std::vector<uint8_t> encodedData;
+        TaskToken idleTask;
+
+        /**
+         * Whether the last delivered unit ends its frame.
+         */
+        bool isLastUnitFrameEnd;
 
         size_t max_nalu_size_bytes;
 
         /**
          * Function to be called when the video source has a new available encoded data.
          */
-        void onEncodedData(std::vector<uint8_t> &&data);
+        void onEncodedData(NalUnit &&data, int64_t captureTimeUs);
+
+        /**
+         * Queues the encoded data according to the overflow policy (called by the encoding thread).
+         *
+         * @return true - if the data is queued, otherwise - false (dropped).
+         */
+        bool enqueue(EncodedData &encodedData);
+
+        /**
+         * Drops the queued encoded data.
+         */
+        void clearQueue();
+
+        /**
+         * Starts queueing the encoded data, acquires the transcoder (started or resumed by its first reader).
+         */
+        void startStreaming();
+
+        /**
+         * Stops queueing the encoded data unless the frames are read again.
+         * The transcoder is paused after the idle timeout.
+         */
+        void stopStreaming();
+
+        static void stopStreaming0(void *);
+
+        /**
+         * Releases the transcoder (nobody is watching the camera via this source).
+         */
+        void pauseTranscoder();
+
+        static void pauseTranscoder0(void *);
 
         /**
          * Delivers encoded data.
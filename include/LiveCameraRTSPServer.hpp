@@ -6,8 +6,19 @@
 #include <GroupsockHelper.hh>
 #include <liveMedia.hh>
 
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "BitrateController.hpp"
 #include "LiveCamFramedSource.hpp"
+#include "CameraMulticastServerMediaSubsession.hpp"
 #include "CameraUnicastServerMediaSubsession.hpp"
+#include "EpollTaskScheduler.hpp"
+#include "EventTriggerRegistry.hpp"
+#include "SelectTaskScheduler.hpp"
+#include "RtpFanout.hpp"
+#include "WorkerRTSPServer.hpp"
 #include "config/params/Configuration.hpp"
 
 namespace LIRS {
@@ -23,7 +34,7 @@ namespace LIRS {
         ~LiveCameraRTSPServer();
 
         /**
-         * Changes the watch variable in order to stop the event loop.
+         * Changes the watch variable in order to stop the event loop (and the worker event loops).
          */
         void stopServer();
 
@@ -32,11 +43,53 @@ namespace LIRS {
 
         /*
          * Creates a new RTSP server adding subsessions to each video source.
+         * If the workers are configured, the clients are streamed by the worker event loops
+         * and the current event loop only accepts the connections.
          */
         void run();
 
     private:
 
+        /**
+         * Connection accepted by the main event loop, waiting to be handed over to the worker.
+         */
+        struct ClientConnection {
+
+            int socket;
+
+            sockaddr_in address;
+        };
+
+        /**
+         * Camera's multicast stream (sent once regardless of the number of clients).
+         */
+        struct MulticastOutput {
+
+            Groupsock *rtpGroupsock;
+
+            Groupsock *rtcpGroupsock;
+
+            FramedSource *source;
+
+            RTPSink *sink;
+
+            RTCPInstance *rtcpInstance;
+        };
+
+        /**
+         * Max number of accepted connections waiting to be handed over to the worker.
+         */
+        constexpr static size_t MAX_NUM_PENDING_CONNECTIONS = 256;
+
+        /**
+         * Constructs the server.
+         *
+         * @param config - server configuration.
+         * @param isWorker - whether the server is the worker's one (streams the clients handed over to it).
+         * @param workerIndex - worker's number (the first worker announces the streams).
+         */
+        LiveCameraRTSPServer(lirs::config::params::ServerParameters const &config, bool isWorker, size_t workerIndex);
+
         /*
          * Watch variable to control the event loop.
          */
@@ -44,6 +97,11 @@ namespace LIRS {
 
         TaskScheduler *scheduler;
 
+        /**
+         * Event triggers of the scheduler.
+         */
+        EventTriggerRegistry *eventTriggers;
+
         UsageEnvironment *env;
 
         RTSPServer *server;
@@ -60,6 +118,88 @@ namespace LIRS {
          */
         std::vector<FramedSource *> allocatedVideoSources;
 
+        /**
+         * Fan-outs of the framed sources (shared by the clients).
+         */
+        std::vector<RtpFanout *> allocatedFanouts;
+
+        /**
+         * Controllers of the cameras' bitrate (adaptive bitrate is enabled).
+         */
+        std::vector<std::unique_ptr<BitrateController>> rateControllers;
+
+        /**
+         * Multicast streams of the cameras.
+         */
+        std::vector<MulticastOutput> multicastOutputs;
+
+        /**
+         * Whether the server is the worker's one.
+         */
+        bool isWorker;
+
+        size_t workerIndex;
+
+        /**
+         * Worker event loops (each one has its own RTSP server, sessions and sources reading the transcoders).
+         */
+        std::vector<std::unique_ptr<LiveCameraRTSPServer>> workers;
+
+        std::vector<std::thread> workerThreads;
+
+        /**
+         * Listening sockets of the main event loop (workers mode).
+         */
+        int rtspServerSocket;
+
+        int httpServerSocket;
+
+        /**
+         * Indicating that there are connections to be handed over to the worker's RTSP server
+         * (the connections are posted along with the trigger by the main event loop).
+         */
+        EventTriggerId connectionEventTriggerId;
+
+        /**
+         * Wakes up the worker's event loop when the server is stopped (the loop may wait for the socket events
+         * for a long time otherwise).
+         */
+        EventTriggerId stopEventTriggerId;
+
+        /**
+         * Creates the RTSP server (unless it is the worker's one) and the media sessions.
+         */
+        void createServer();
+
+        /**
+         * Starts the worker event loops and accepts the connections until the server is stopped.
+         */
+        void runWorkers();
+
+        /**
+         * Accepts the connection and hands it over to the worker.
+         * The same client is handled by the same worker (e.g. RTSP-over-HTTP connections are paired).
+         */
+        void acceptConnection(int serverSocket);
+
+        static void acceptRtspConnection0(void *, int);
+
+        static void acceptHttpConnection0(void *, int);
+
+        /**
+         * Passes the connection to the worker's event loop (called by the main event loop).
+         */
+        void addClientConnection(ClientConnection const &connection);
+
+        /**
+         * Hands the pending connections over to the worker's RTSP server.
+         */
+        void handOverConnections();
+
+        static void handOverConnections0(void *);
+
+        static void handleStop0(void *);
+
         /**
          * Announce new create media session.
          *
@@ -74,8 +214,23 @@ namespace LIRS {
          * @param transcoder - video source.
          * @param streamName - the name of the stream (part of the URL), e.g. rtsp://.../camera/1.
          * @param streamDesc -description of the stream.
+         * @param cameraIndex - camera's number (selects the multicast group).
+         */
+        void addMediaSession(std::shared_ptr<Transcoder> transcoder, const std::string &streamName,
+                             const std::string &streamDesc, size_t cameraIndex);
+
+        /**
+         * Adds the session of the camera's source-specific multicast stream and starts sending the stream
+         * to the camera's group.
+         *
+         * @param transcoder - video source.
+         * @param streamName - the name of the stream.
+         * @param cameraIndex - camera's number (selects the multicast group).
+         * @param fanout - shared packets of the camera (nullptr - the stream is replicated).
+         * @param replicator - replicates the camera's source (used if there is no fan-out).
          */
-        void addMediaSession(std::shared_ptr<Transcoder> transcoder, const std::string &streamName, const std::string &streamDesc);
+        void addMulticastSession(std::shared_ptr<Transcoder> const &transcoder, const std::string &streamName,
+                                 size_t cameraIndex, RtpFanout *fanout, StreamReplicator *replicator);
 
     };
 }
@@ -0,0 +1,105 @@
+#ifndef LIRS_RTSP_VIDEO_SERVER_NAL_UNIT_HPP
+#define LIRS_RTSP_VIDEO_SERVER_NAL_UNIT_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#ifdef __cplusplus
+extern "C" {
+#include <libavutil/buffer.h>
+}
+#endif
+
+namespace LIRS {
+
+    /**
+     * Encoded unit (NAL unit or a whole VP8/VP9 frame) referencing the data of the packet it comes from.
+     * The packet's buffer is referenced once and shared by all of its units and their copies (e.g. one per reader),
+     * so the unit is passed around without copying its data or allocating.
+     * The last unit of the frame (access unit) is flagged, its last RTP packet is marked.
+     */
+    class NalUnit {
+
+    public:
+
+        /**
+         * Packet's buffer reference shared by the units.
+         */
+        using SharedBuffer = std::shared_ptr<AVBufferRef>;
+
+        /**
+         * Shares the buffer reference (takes ownership of it, it is released along with the last unit).
+         */
+        static SharedBuffer shareBuffer(AVBufferRef *buffer) {
+            return SharedBuffer(buffer, [](AVBufferRef *ref) { av_buffer_unref(&ref); });
+        }
+
+        NalUnit() : nalData(nullptr), nalSize(0), frameEnd(false) {}
+
+        /**
+         * Constructs the unit referencing the shared buffer.
+         *
+         * @param buffer - shared reference to the buffer holding the data.
+         * @param data - beginning of the unit's data (within the buffer).
+         * @param size - unit's size in bytes.
+         * @param isFrameEnd - whether the unit is the last one of its frame.
+         */
+        NalUnit(SharedBuffer buffer, uint8_t const *data, size_t size, bool isFrameEnd = false)
+                : buffer(std::move(buffer)), nalData(data), nalSize(size), frameEnd(isFrameEnd) {}
+
+        NalUnit(NalUnit const &other) = default;
+
+        NalUnit(NalUnit &&other) noexcept : buffer(std::move(other.buffer)), nalData(other.nalData),
+                                            nalSize(other.nalSize), frameEnd(other.frameEnd) {
+            other.nalData = nullptr;
+            other.nalSize = 0;
+            other.frameEnd = false;
+        }
+
+        NalUnit &operator=(NalUnit other) noexcept {
+            swap(other);
+            return *this;
+        }
+
+        void swap(NalUnit &other) noexcept {
+            std::swap(buffer, other.buffer);
+            std::swap(nalData, other.nalData);
+            std::swap(nalSize, other.nalSize);
+            std::swap(frameEnd, other.frameEnd);
+        }
+
+        uint8_t const *data() const {
+            return nalData;
+        }
+
+        size_t size() const {
+            return nalSize;
+        }
+
+        bool empty() const {
+            return nalSize == 0;
+        }
+
+        bool isFrameEnd() const {
+            return frameEnd;
+        }
+
+        void setFrameEnd(bool isFrameEnd) {
+            frameEnd = isFrameEnd;
+        }
+
+    private:
+
+        SharedBuffer buffer;
+
+        uint8_t const *nalData;
+
+        size_t nalSize;
+
+        bool frameEnd;
+    };
+}
+
+#endif //LIRS_RTSP_VIDEO_SERVER_NAL_UNIT_HPP
@@ -0,0 +1,214 @@
+#ifndef LIRS_RTSP_VIDEO_SERVER_RTP_FANOUT_HPP
+#define LIRS_RTSP_VIDEO_SERVER_RTP_FANOUT_HPP
+
+#include <MediaSink.hh>
+
+#include <sys/time.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "GopCache.hpp"
+#include "config/params/Configuration.hpp"
+
+namespace LIRS {
+
+    class FanoutRTPSink;
+
+    class LiveCamFramedSource;
+
+    /**
+     * RTP packet shared by all the clients of the camera.
+     * The payload is immutable, the RTP header is filled in by each client's sink right before sending.
+     */
+    struct RtpPacket {
+
+        constexpr static size_t HEADER_SIZE = 12;
+
+        /**
+         * RTP header (HEADER_SIZE bytes) followed by the payload.
+         */
+        std::vector<uint8_t> data;
+
+        /**
+         * Capture time of the frame the packet belongs to (becomes the client's RTP timestamp).
+         */
+        timeval presentationTime;
+
+        /**
+         * Whether the packet ends the frame (RTP 'M' bit).
+         */
+        bool isMarked;
+
+        /**
+         * Whether the packet begins a key frame (a TCP client that fell behind resumes from it).
+         */
+        bool isSyncPoint;
+    };
+
+    /**
+     * Fans the camera's stream out to all of its clients.
+     *
+     * The encoded units are read once and packetized once (H.264/H.265 single NAL unit and fragmentation units,
+     * VP8/VP9 minimal payload descriptors), the packets are reference counted and sent to every client's sink as is,
+     * only the per-client header fields (sequence number, timestamp and SSRC) differ. The camera's source is read
+     * while at least one client is playing.
+     *
+     * New clients are primed from the GOP cache (the cached units are packetized for the client only).
+     */
+    class RtpFanout : public MediaSink {
+
+    public:
+
+        /**
+         * Creates the fan-out.
+         *
+         * @param env - environment (see Live555 docs).
+         * @param source - camera's source (encoded units flagged at the end of the frame).
+         * @param codec - codec of the stream.
+         * @param maxPacketSize - max RTP packet size in bytes (including the header).
+         * @param gopCache - current group of pictures new clients are primed from (nullptr - no priming).
+         */
+        static RtpFanout *createNew(UsageEnvironment &env, LiveCamFramedSource *source,
+                                    lirs::config::params::VideoCodec codec, size_t maxPacketSize,
+                                    GopCache const *gopCache = nullptr);
+
+        /**
+         * Starts sending the stream to the client's sink (the source is started by the first client).
+         * The client is primed and attached via the event loop.
+         */
+        void attach(FanoutRTPSink *sink);
+
+        /**
+         * Stops sending the stream to the client's sink (the source is stopped after the last client).
+         */
+        void detach(FanoutRTPSink *sink);
+
+        /**
+         * Returns the sinks of the clients the stream is sent to.
+         */
+        std::vector<FanoutRTPSink *> const &getSinks() const;
+
+        /**
+         * Returns the RTP payload format name of the stream, e.g. "H265".
+         */
+        char const *getRtpPayloadFormatName() const;
+
+        /**
+         * Paces the packets sent to each client (see RtpPacer), applies to the sinks created afterwards.
+         *
+         * @param windowUs - each frame's packets are spread over this time in microseconds (0 - no pacing).
+         * @param bucketSize - max number of bytes sent back-to-back.
+         */
+        void setPacing(int64_t windowUs, size_t bucketSize);
+
+        int64_t getPacingWindowUs() const;
+
+        size_t getPacingBucketSize() const;
+
+        /**
+         * Resends the packets reported lost by the clients (see FanoutRTPSink), applies to the sinks
+         * created afterwards.
+         *
+         * @param historySize - number of the recently sent packets kept per client (0 - no retransmission).
+         * @param isRtxEnabled - whether the packets are resent as a separate RTX stream (RFC 4588).
+         */
+        void setRetransmission(size_t historySize, bool isRtxEnabled);
+
+        size_t getRetransmissionHistorySize() const;
+
+        bool isRtxEnabled() const;
+
+    protected:
+
+        RtpFanout(UsageEnvironment &env, LiveCamFramedSource *source, lirs::config::params::VideoCodec codec,
+                  size_t maxPacketSize, GopCache const *gopCache);
+
+        ~RtpFanout() override;
+
+        Boolean continuePlaying() override;
+
+    private:
+
+        LiveCamFramedSource *source;
+
+        lirs::config::params::VideoCodec codec;
+
+        /**
+         * Max RTP payload size in bytes (including the payload headers).
+         */
+        size_t maxPayloadSize;
+
+        GopCache const *gopCache;
+
+        /**
+         * Pacing window of the clients' packets in microseconds (0 - the packets are sent right away).
+         */
+        int64_t pacingWindowUs;
+
+        size_t pacingBucketSize;
+
+        /**
+         * Number of the recently sent packets kept per client for retransmission (0 - lost packets are not resent).
+         */
+        size_t retransmissionHistorySize;
+
+        bool isRtxEnabledFlag;
+
+        /**
+         * Sinks of the clients the stream is sent to.
+         */
+        std::vector<FanoutRTPSink *> sinks;
+
+        /**
+         * Sinks of the clients to be primed and attached by the scheduled task.
+         */
+        std::vector<FanoutRTPSink *> pendingSinks;
+
+        TaskToken attachTask;
+
+        /**
+         * Encoded unit read from the source.
+         */
+        std::vector<uint8_t> buffer;
+
+        /**
+         * Packets of the last read unit.
+         */
+        std::vector<std::shared_ptr<RtpPacket>> packets;
+
+        /**
+         * Primes the pending clients and starts sending the stream to them.
+         */
+        void attachPending();
+
+        static void attachPending0(void *);
+
+        /**
+         * Sends the cached group of pictures to the new client.
+         */
+        void prime(FanoutRTPSink *sink);
+
+        /**
+         * Splits the encoded unit into RTP packets.
+         *
+         * @param data - encoded unit (NAL unit without start code or VP8/VP9 frame).
+         * @param size - unit's size in bytes.
+         * @param presentationTime - capture time of the unit's frame.
+         * @param isFrameEnd - whether the unit ends the frame (its last packet is marked).
+         * @param result - the unit's packets are appended to it.
+         */
+        void packetize(uint8_t const *data, size_t size, timeval presentationTime, bool isFrameEnd,
+                       std::vector<std::shared_ptr<RtpPacket>> &result) const;
+
+        static void continuePlaying0(void *);
+
+        static void afterGettingFrame(void *clientData, unsigned frameSize, unsigned numTruncatedBytes,
+                                      timeval presentationTime, unsigned durationInMicroseconds);
+
+        void afterGettingFrame(unsigned frameSize, unsigned numTruncatedBytes, timeval presentationTime);
+    };
+}
+
+#endif //LIRS_RTSP_VIDEO_SERVER_RTP_FANOUT_HPP
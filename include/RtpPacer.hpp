@@ -0,0 +1,149 @@
+#ifndef LIRS_RTSP_VIDEO_SERVER_RTP_PACER_HPP
+#define LIRS_RTSP_VIDEO_SERVER_RTP_PACER_HPP
+
+#include <UsageEnvironment.hh>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "RtpFanout.hpp"
+
+namespace LIRS {
+
+    /**
+     * Token bucket pacer of a client's RTP packets.
+     *
+     * Instead of sending a frame's packets back-to-back (a large key frame becomes a microburst overflowing
+     * the switches' and Wi-Fi buffers), the packets are spread over the pacing window (a fraction of the frame
+     * interval). The bucket's rate is recomputed for each queued frame, so the queued packets are sent
+     * by the end of the window; at most the bucket's size is sent back-to-back.
+     *
+     * The packets waiting for the tokens are sent by the scheduler's delayed tasks. Accessed by the event loop only.
+     */
+    class RtpPacer {
+
+    public:
+
+        /**
+         * Sends the packets (the ones allowed by the bucket at once).
+         */
+        using Transmitter = std::function<void(std::vector<std::shared_ptr<RtpPacket>> const &)>;
+
+        /**
+         * Constructs the pacer.
+         *
+         * @param env - environment (see Live555 docs).
+         * @param windowUs - the queued packets are sent within this time in microseconds.
+         * @param bucketSize - max number of bytes sent back-to-back (at least a max size packet).
+         * @param transmitter - sends the paced packets.
+         */
+        RtpPacer(UsageEnvironment &env, int64_t windowUs, size_t bucketSize, Transmitter transmitter);
+
+        ~RtpPacer();
+
+        RtpPacer(RtpPacer const &) = delete;
+
+        RtpPacer &operator=(RtpPacer const &) = delete;
+
+        /**
+         * Queues the frame's packets, the ones allowed by the bucket are sent right away.
+         */
+        void enqueue(std::vector<std::shared_ptr<RtpPacket>> const &packets);
+
+        /**
+         * Drops the queued packets (e.g. the client stopped playing).
+         */
+        void clear();
+
+        /**
+         * Returns the number of the packets waiting to be sent.
+         */
+        size_t getQueueSize() const;
+
+        /**
+         * Returns the number of bytes waiting to be sent.
+         */
+        size_t getQueueBytes() const;
+
+        /**
+         * Returns the max number of bytes ever waiting to be sent.
+         */
+        size_t getMaxQueueBytes() const;
+
+        /**
+         * Returns the number of packets delayed by the pacer (not sent right away).
+         */
+        uint64_t getNumDelayedPackets() const;
+
+    private:
+
+        /**
+         * Resolution of the scheduler's timeouts in microseconds (epoll waits in milliseconds). The bucket holds
+         * at least the tokens accumulated in this time, so late wakeups do not lower the rate.
+         */
+        constexpr static int64_t TIMER_RESOLUTION_US = 1000;
+
+        UsageEnvironment &env;
+
+        int64_t windowUs;
+
+        size_t bucketSize;
+
+        Transmitter transmitter;
+
+        std::deque<std::shared_ptr<RtpPacket>> queue;
+
+        size_t queueBytes;
+
+        size_t maxQueueBytes;
+
+        uint64_t numDelayedPackets;
+
+        /**
+         * Tokens available in bytes.
+         */
+        double tokens;
+
+        /**
+         * Rate the tokens are added at in bytes per microsecond.
+         */
+        double rate;
+
+        /**
+         * When the tokens were last added (steady clock, microseconds).
+         */
+        int64_t lastRefillTimeUs;
+
+        /**
+         * Sends the next packets when there are enough tokens for them (nullptr - the queue is empty).
+         */
+        TaskToken sendTask;
+
+        /**
+         * Packets being sent (reused between the calls).
+         */
+        std::vector<std::shared_ptr<RtpPacket>> batch;
+
+        /**
+         * Adds the tokens accumulated since the last refill.
+         */
+        void refill();
+
+        /**
+         * Returns the bucket's capacity at the current rate.
+         */
+        double getCapacity() const;
+
+        /**
+         * Sends the packets allowed by the bucket, schedules sending the rest.
+         */
+        void sendReady();
+
+        static void sendReady0(void *);
+    };
+}
+
+#endif //LIRS_RTSP_VIDEO_SERVER_RTP_PACER_HPP
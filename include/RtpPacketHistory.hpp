@@ -0,0 +1,66 @@
+#ifndef LIRS_RTSP_VIDEO_SERVER_RTP_PACKET_HISTORY_HPP
+#define LIRS_RTSP_VIDEO_SERVER_RTP_PACKET_HISTORY_HPP
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "RtpFanout.hpp"
+
+namespace LIRS {
+
+    /**
+     * Ring of the packets recently sent to a client, indexed by the client's sequence number.
+     *
+     * Keeps the references to the shared packets along with the client's header fields they were sent with
+     * (the shared header is overwritten by the other clients), so a lost packet can be sent again as it was.
+     * The oldest packets are overwritten by the new ones. Accessed by the event loop only.
+     */
+    class RtpPacketHistory {
+
+    public:
+
+        /**
+         * Sent packet.
+         */
+        struct Entry {
+
+            std::shared_ptr<RtpPacket> packet;
+
+            /**
+             * Client's sequence number and timestamp of the packet.
+             */
+            uint16_t seqNo;
+
+            uint32_t timestamp;
+        };
+
+        /**
+         * Constructs the history.
+         *
+         * @param size - max number of the kept packets.
+         */
+        explicit RtpPacketHistory(size_t size);
+
+        /**
+         * Remembers the sent packet (overwrites the one sent the history's size packets earlier).
+         */
+        void add(uint16_t seqNo, uint32_t timestamp, std::shared_ptr<RtpPacket> const &packet);
+
+        /**
+         * Returns the packet sent with the sequence number or nullptr if it is not kept anymore (or never sent).
+         */
+        Entry const *find(uint16_t seqNo) const;
+
+        /**
+         * Forgets all the packets (the references to the shared packets are released).
+         */
+        void clear();
+
+    private:
+
+        std::vector<Entry> entries;
+    };
+}
+
+#endif //LIRS_RTSP_VIDEO_SERVER_RTP_PACKET_HISTORY_HPP
@@ -0,0 +1,55 @@
+#ifndef LIRS_RTSP_VIDEO_SERVER_SELECT_TASK_SCHEDULER_HPP
+#define LIRS_RTSP_VIDEO_SERVER_SELECT_TASK_SCHEDULER_HPP
+
+#include <BasicUsageEnvironment.hh>
+
+#include "EventTriggerRegistry.hpp"
+
+namespace LIRS {
+
+    /**
+     * Live555's select() based task scheduler with the event triggers of EventTriggerRegistry
+     * (not limited to 32 triggers, the event loop is woken up via eventfd instead of the periodic scheduler tick).
+     */
+    class SelectTaskScheduler : public BasicTaskScheduler {
+
+    public:
+
+        /**
+         * Creates the scheduler.
+         *
+         * @return scheduler or nullptr if eventfd is not available.
+         */
+        static SelectTaskScheduler *createNew();
+
+        ~SelectTaskScheduler() override;
+
+        void SingleStep(unsigned maxDelayTime = 0) override;
+
+        EventTriggerId createEventTrigger(TaskFunc *eventHandlerProc) override;
+
+        void deleteEventTrigger(EventTriggerId eventTriggerId) override;
+
+        /**
+         * Marks the event as pending and wakes the event loop up (may be called from any thread).
+         */
+        void triggerEvent(EventTriggerId eventTriggerId, void *clientData = nullptr) override;
+
+        /**
+         * Returns the event triggers (e.g. to create a trigger with a payload queue).
+         */
+        EventTriggerRegistry &getEventTriggerRegistry();
+
+    protected:
+
+        explicit SelectTaskScheduler(int eventFd);
+
+    private:
+
+        EventTriggerRegistry eventTriggers;
+
+        static void acknowledgeWakeup0(void *, int);
+    };
+}
+
+#endif //LIRS_RTSP_VIDEO_SERVER_SELECT_TASK_SCHEDULER_HPP
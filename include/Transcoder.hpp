@@ -2,13 +2,22 @@
 #define LIVE_VIDEO_STREAM_TRANSCODER_HPP
 
 #include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 
+#include "NalUnit.hpp"
+#include "X264SliceEncoder.hpp"
 #include "utils/Logger.hpp"
 #include "utils/Utils.hpp"
+#include "utils/BoundedQueue.hpp"
 #include "config/params/Configuration.hpp"
+#include "capture/VideoInput.hpp"
+#include "capture/LibavInput.hpp"
 
 #ifdef __cplusplus
 extern "C" {
@@ -18,9 +27,7 @@ extern "C" {
 #include <libswscale/swscale.h>
 #include <libavutil/imgutils.h>
 #include <libavutil/pixdesc.h>
-#include <libavfilter/avfiltergraph.h>
-#include <libavfilter/buffersink.h>
-#include <libavfilter/buffersrc.h>
+#include <libavutil/time.h>
 }
 #endif
 
@@ -60,6 +67,18 @@ namespace LIRS {
     } TranscoderContext;
 
 
+    /**
+     * H.264/H.265 parameter sets (NAL units without start codes), empty if unknown.
+     */
+    struct ParameterSets {
+
+        std::vector<uint8_t> vps; // H.265 only
+
+        std::vector<uint8_t> sps;
+
+        std::vector<uint8_t> pps;
+    };
+
     /**
      * Transcoder decodes video resource (captures video frames) and encodes it.
      */
@@ -98,11 +117,44 @@ namespace LIRS {
         void stop();
 
         /**
-         * Sets callback function which indicates that a new encoded video data is available.
+         * Suspends capturing and encoding, the video source and the encoder are kept open (warm).
+         * Thread-safe, does not wait for the frames being processed.
+         */
+        void pause();
+
+        /**
+         * Resumes capturing and encoding. The frames captured before resuming are dropped,
+         * the first encoded frame is a key frame.
+         */
+        void resume();
+
+        /**
+         * Whether capturing and encoding are suspended.
+         */
+        bool isPaused() const;
+
+        /**
+         * Registers a reader of the encoded data (e.g. a streaming event loop). The first reader starts capturing
+         * and encoding (in a new thread) or resumes them. Thread-safe.
+         */
+        void acquire();
+
+        /**
+         * Unregisters the reader. Capturing and encoding are paused after the last reader. Thread-safe.
+         */
+        void release();
+
+        /**
+         * Adds callback function which indicates that a new encoded video data is available.
+         * The callback receives the encoded unit (NAL unit or VP8/VP9 frame referencing the encoder's packet)
+         * and the frame's capture time (wall clock, in microseconds).
+         *
+         * The encoded data is broadcast to all the callbacks (each one gets its own reference to the unit),
+         * the callbacks must be added before the transcoder is started.
          *
          * @param callback - callback function.
          */
-        void setOnEncodedDataCallback(std::function<void(std::vector<uint8_t> &&)> callback);
+        void addOnEncodedDataCallback(std::function<void(NalUnit &&, int64_t)> callback);
 
         /**
          * Returns this object's configuration.
@@ -111,6 +163,58 @@ namespace LIRS {
          */
         lirs::config::params::CameraParameters const &getConfig() const;
 
+        /**
+         * Returns the codec of the produced video stream.
+         *
+         * @return the passthrough codec or the encoder's codec.
+         */
+        lirs::config::params::VideoCodec getCodec() const;
+
+        /**
+         * Asks the encoder to encode the next frame as a key frame (IDR), e.g. for a joining client.
+         * Thread-safe. Requests are coalesced: at most one key frame per the configured window.
+         *
+         * @return true - if the key frame is requested, false - coalesced with the previous request
+         *         or not supported (passthrough mode, requests are disabled).
+         */
+        bool requestKeyFrame();
+
+        /**
+         * Registers a controller of the encoder's bitrate (e.g. the one of a streaming event loop).
+         * Must be called before the transcoder is started.
+         *
+         * @return controller's id.
+         */
+        size_t addRateController();
+
+        /**
+         * Sets the bitrate asked by the controller. Thread-safe. The encoder is reconfigured before the next frame
+         * to the lowest bitrate asked by the controllers (the configured one if none asks).
+         *
+         * @param controllerId - controller's id (see addRateController).
+         * @param bitrate - target bitrate in kbps, 0 - the controller does not ask (e.g. it has no clients).
+         */
+        void setTargetBitrate(size_t controllerId, uint16_t bitrate);
+
+        /**
+         * Returns the current bitrate of the encoder in kbps.
+         */
+        uint16_t getBitrate() const;
+
+        /**
+         * Whether the encoder's bitrate can be changed while encoding (libx264).
+         */
+        bool isBitrateAdjustable() const;
+
+        /**
+         * Returns the parameter sets of the produced H.264/H.265 stream.
+         * Known as soon as the encoder is opened (the stream's extradata in the passthrough mode),
+         * so the stream can be described before any frame is encoded.
+         *
+         * @return parameter sets (empty for VP8/VP9 or if unknown).
+         */
+        ParameterSets const &getParameterSets() const;
+
         /**
          * Whether the resource is running: captures frames and produces encoded data.
          *
@@ -150,103 +254,202 @@ namespace LIRS {
         AVRational frameRate;
 
         /**
-         * Video source's bitrate (raw video data).
+         * Encoder video context.
+         * Used for encoding.
          */
-        size_t sourceBitRate;
+        TranscoderContext encoderContext;
 
         /**
-         * Decoder video context.
-         * Used for decoding.
+         * Encoding packet (holds encoded data).
          */
-        TranscoderContext decoderContext;
+        AVPacket *encodingPacket;
 
         /**
-         * Encoder video context.
-         * Used for encoding.
+         * libx264 used directly to pass the slices on as soon as they are encoded (used instead of the libavcodec's
+         * encoder if the H.264 frames are split into slices).
          */
-        TranscoderContext encoderContext;
+        std::unique_ptr<X264SliceEncoder> sliceEncoder;
 
         /**
-         * Holds raw video data and additional information (resolution, etc.)
+         * Conversion context from one pixel format to another one.
          */
-        AVFrame *rawFrame;
+        SwsContext *converterContext;
 
         /**
-         * Holds converted frame data (from one pixel format to another one).
+         * CPUs the encoder's threads are bound to (empty - not bound).
          */
-        AVFrame *convertedFrame;
+        std::vector<uint16_t> encoderCpus;
 
         /**
-         * Frame retrieved from the filter.
+         * Video source providing raw frames (camera, video file, test pattern, etc.).
          */
-        AVFrame *filterFrame;
+        std::unique_ptr<VideoInput> input;
 
         /**
-         * Decoding packet (is sent to the decoder).
+         * Source of the compressed video passed through without transcoding (passthrough mode).
          */
-        AVPacket *decodingPacket;
+        std::unique_ptr<LibavInput> packetInput;
 
         /**
-         * Encoding packet (holds encoded data).
+         * Output frame interval in microseconds (used to drop the excessive captured frames).
          */
-        AVPacket *encodingPacket;
+        int64_t frameIntervalUs;
 
         /**
-         * Conversion context from one pixel format to another one.
+         * The earliest capture time (in microseconds) of the next frame to be encoded.
          */
-        SwsContext *converterContext;
+        int64_t nextFrameTimeUs;
+
+        /**
+         * Presentation timestamp of the next frame to be encoded (in the encoder's time base).
+         */
+        int64_t nextFramePts;
+
+        /**
+         * What to drop when a pipeline queue is full.
+         */
+        lirs::config::params::DropPolicy dropPolicy;
 
         /**
-         * Filter query.
-         * Filter graph is constructed from it.
+         * Raw frames waiting to be converted.
          */
-        std::string filterQuery;
+        lirs::utils::BoundedQueue<AVFrame *> rawFrameQueue;
 
         /**
-         * Filter graph used to create complex filter chains.
+         * Converted frames (from one pixel format to another one) waiting to be encoded.
          */
-        AVFilterGraph *filterGraph;
+        lirs::utils::BoundedQueue<AVFrame *> convertedFrameQueue;
 
         /**
-         * Filter context for buffer source.
-         * Frames to be filtered are passed to the buffer source.
+         * Preallocated frames to be filled by the converter (given back by the encoder).
          */
-        AVFilterContext *bufferSrcCtx;
+        lirs::utils::BoundedQueue<AVFrame *> freeFrameQueue;
 
         /**
-         * Filter context for buffer sink.
-         * Frames to be filtered are retrieved from the buffer sink.
+         * Parameter sets of the produced stream (set at initialization).
          */
-        AVFilterContext *bufferSinkCtx;
+        ParameterSets parameterSets;
+
+        /**
+         * Capture times (wall clock, in microseconds) of the frames being encoded indexed by pts.
+         * Used by the encoding stage only.
+         */
+        std::vector<int64_t> captureTimes;
+
+        /**
+         * Whether the next frame should be encoded as a key frame.
+         */
+        std::atomic_bool keyFrameRequestedFlag;
+
+        /**
+         * Time (monotonic, in microseconds) of the last accepted key frame request.
+         */
+        std::atomic<int64_t> lastKeyFrameRequestUs;
+
+        /**
+         * Bitrates (kbps) asked by the rate controllers (0 - not asked). Set by the controllers' event loops.
+         */
+        std::deque<std::atomic<uint16_t>> targetBitrates;
+
+        /**
+         * Current bitrate of the encoder (kbps).
+         */
+        std::atomic<uint16_t> bitrate;
+
+        /**
+         * The last bitrate the encoder was reconfigured to (or failed to). Used by the encoding stage only.
+         */
+        uint16_t lastTargetBitrate;
 
         std::atomic_bool needToStopFlag;
 
         std::atomic_bool isRunningFlag;
 
+        std::atomic_bool isPausedFlag;
+
+        /**
+         * Wall clock time (in microseconds) of the last resuming, the frames captured earlier are stale.
+         */
+        std::atomic<int64_t> resumeTimeUs;
+
         /**
-         * Callback function called when new encoded video data is available.
+         * Wakes up the capturing thread waiting while paused.
          */
-        std::function<void(std::vector<uint8_t> &&)> onEncodedDataCallback;
+        std::mutex pauseMutex;
+
+        std::condition_variable resumeCondition;
+
+        /**
+         * Callback functions called when new encoded video data is available.
+         */
+        std::vector<std::function<void(NalUnit &&, int64_t)>> onEncodedDataCallbacks;
+
+        /**
+         * Guards the number of readers (starting, pausing and resuming).
+         */
+        std::mutex readersMutex;
+
+        size_t numReaders;
+
+        /**
+         * Whether the transcoder's thread is started (by the first reader).
+         */
+        bool isStarted;
 
         /** constants **/
 
         /**
-         * NALU start code bytes number (first 4 bytes, {0x0, 0x0, 0x0, 0x1}).
-         * Used to truncate start codes from the encoded data.
+         * VP8/VP9 encoding speed in the realtime mode (the higher the faster, the lower the quality).
+         */
+        constexpr static int VPX_CPU_USED = 8;
+
+        /**
+         * The largest x265 coding tree unit size (the number of CTU rows limits the number of slices).
+         */
+        constexpr static int X265_CTU_SIZE = 64;
+
+        /**
+         * Maximum time (in milliseconds) to wait for a captured frame.
+         * Bounds the time needed to notice the stop request.
+         */
+        constexpr static int CAPTURE_TIMEOUT_MS = 100;
+
+        /**
+         * Maximum time (in milliseconds) a pipeline stage waits for the next frame.
+         */
+        constexpr static int STAGE_TIMEOUT_MS = 100;
+
+        /**
+         * Number of converted frames being processed outside of the queue (by the converter and the encoder).
          */
-        constexpr static unsigned int NALU_START_CODE_BYTES_NUMBER = 4U;
+        constexpr static unsigned int NUM_FRAMES_IN_PROCESSING = 2U;
+
+        /**
+         * Number of remembered capture times, must exceed the number of frames delayed by the encoder.
+         */
+        constexpr static unsigned int CAPTURE_TIMES_HISTORY_SIZE = 256U;
 
         /* Methods */
 
+        /**
+         * Blocks the capturing thread while paused (at most the specified time).
+         */
+        void waitWhilePaused(int timeoutMs);
+
         /**
          * Registers ffmpeg codecs, etc.
          */
         void registerAll();
 
         /**
-         * Initializes decoder in order to capture raw frames from the video source.
+         * Opens the video source in order to capture raw frames from it.
          */
-        void initializeDecoder();
+        void initializeInput();
+
+        /**
+         * Opens the video source in order to pass its compressed video through (no decoder, converter and encoder).
+         */
+        void initializePassthrough();
 
         /**
          * Initializes encoder in order to encode raw frames.
@@ -254,26 +457,130 @@ namespace LIRS {
          */
         void initializeEncoder();
 
+        /**
+         * Opens libx264 passing the slices on as soon as they are encoded (see X264SliceEncoder).
+         *
+         * @return false - if the encoder cannot be opened (the libavcodec's one is used).
+         */
+        bool initializeSliceEncoder();
+
+        /**
+         * Extracts the parameter sets from the encoder's (or the stream's) extradata.
+         *
+         * @param extradata - Annex B byte stream.
+         * @param size - extradata size in bytes.
+         */
+        void initializeParameterSets(uint8_t const *extradata, int size);
+
+        /**
+         * Sets libx265 options: preset, tune, VBV, etc.
+         *
+         * @param options - encoder options.
+         */
+        void setX265Options(AVDictionary **options);
+
+        /**
+         * Sets libx264 options: preset, tune, VBV, etc.
+         *
+         * @param options - encoder options.
+         */
+        void setX264Options(AVDictionary **options);
+
+        /**
+         * Sets libvpx (VP8, VP9) options for the realtime encoding.
+         *
+         * @param options - encoder options.
+         */
+        void setVpxOptions(AVDictionary **options);
+
+        /**
+         * Reconfigures the encoder if the controllers ask for another bitrate (called by the encoding stage).
+         */
+        void applyTargetBitrate();
+
+        /**
+         * Changes the encoder's target bitrate and VBV (the buffer keeps its duration) between the frames.
+         *
+         * @param targetBitrate - bitrate in kbps.
+         * @return false - if the encoder cannot be reconfigured.
+         */
+        bool reconfigureBitrate(uint16_t targetBitrate);
+
+        /**
+         * Binds the calling thread to the CPUs configured for the encoder (if any).
+         * The encoder's threads are created while opening the encoder and inherit the affinity.
+         */
+        void initializeEncoderAffinity();
+
+        /**
+         * Returns the ffmpeg's name of the encoder for the codec, e.g. 'libx265'.
+         */
+        static const char *getEncoderName(lirs::config::params::VideoCodec codec);
+
+        /**
+         * Checks whether the codec supports the pixel format.
+         */
+        static bool isPixelFormatSupported(AVCodec const *codec, AVPixelFormat pixelFormat);
+
         /**
          * Initializes converter from raw pixel format to the encoder supported pixel format.
          */
         void initializeConverter();
 
         /**
-         * Initializes filters, e.g. 'framestep', 'fps'.
-         * See filter docs.
+         * Captures one frame from the video source and passes it to the converter.
+         * Frames exceeding the output framerate are dropped.
          */
-        void initFilters();
+        void captureFrame();
 
         /**
-         * Captures raw video frame from the device.
+         * Captures one compressed packet and passes its NAL units to the callback (passthrough mode).
+         */
+        void passPacket();
+
+        /**
+         * Conversion stage: converts raw frames into the encoder's pixel format and resolution.
+         */
+        void runConverter();
+
+        /**
+         * Encoding stage: encodes converted frames and passes the encoded data to the callback.
+         */
+        void runEncoder();
+
+        /**
+         * Splits the packet into units and passes them to the callbacks without copying the packet's data.
+         *
+         * @param packet - encoded packet (Annex B byte stream or a VP8/VP9 frame).
+         * @param captureTimeUs - capture time of the packet's frame (wall clock, in microseconds).
+         * @param isNalStream - whether the packet is Annex B byte stream.
+         */
+        void deliverPacket(AVPacket *packet, int64_t captureTimeUs, bool isNalStream);
+
+        /**
+         * Passes the encoded unit to all the callbacks.
+         */
+        void broadcast(NalUnit &&unit, int64_t captureTimeUs);
+
+        /**
+         * Pushes the frame to the queue applying the drop policy if the queue is full.
          *
-         * @param codecContext - codec context (for decoding).
-         * @param frame - captured raw video frame.
-         * @param packet - packet to be sent to the decoder in order to get frame.
-         * @return >= 0 if success, otherwise error occurred.
+         * @param queue - queue of the next pipeline stage.
+         * @param frame - frame to be pushed.
+         * @param dispose - called with the dropped frame.
+         */
+        template<typename Disposer>
+        void pushOrDrop(lirs::utils::BoundedQueue<AVFrame *> &queue, AVFrame *frame, Disposer dispose);
+
+        /**
+         * Gives the raw frame back to the video source.
+         */
+        void releaseRawFrame(AVFrame *frame);
+
+        /**
+         * Releases frames left in the queues after the pipeline is stopped.
          */
-        int decode(AVCodecContext *codecContext, AVFrame *frame, AVPacket *packet);
+        void releaseQueuedFrames();
 
         /**
          * Encodes raw frame and stores encode data in packet.
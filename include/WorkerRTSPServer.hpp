@@ -0,0 +1,47 @@
+#ifndef LIRS_RTSP_VIDEO_SERVER_WORKER_RTSP_SERVER_HPP
+#define LIRS_RTSP_VIDEO_SERVER_WORKER_RTSP_SERVER_HPP
+
+#include <RTSPServer.hh>
+
+namespace LIRS {
+
+    /**
+     * RTSP server of a worker event loop. It has no listening socket of its own,
+     * the client connections are accepted by the main event loop and handed over to it.
+     */
+    class WorkerRTSPServer : public RTSPServer {
+
+    public:
+
+        /**
+         * Creates the server.
+         *
+         * @param env - worker's environment (see Live555 docs).
+         * @param ourPort - port the connections are accepted on (used in the stream's URLs).
+         */
+        static WorkerRTSPServer *createNew(UsageEnvironment &env, Port ourPort);
+
+        /**
+         * Creates a listening socket the same way the RTSP server does.
+         *
+         * @return socket or -1 on failure (see env's result message).
+         */
+        static int setUpListeningSocket(UsageEnvironment &env, Port ourPort);
+
+        /**
+         * Handles the accepted connection (RTSP or RTSP-over-HTTP) as if it was accepted by the server itself.
+         *
+         * @param clientSocket - connected socket (owned by the server from now on).
+         * @param clientAddr - client's address.
+         */
+        void addClientConnection(int clientSocket, struct sockaddr_in clientAddr);
+
+    protected:
+
+        WorkerRTSPServer(UsageEnvironment &env, Port ourPort);
+
+        ~WorkerRTSPServer() override = default;
+    };
+}
+
+#endif //LIRS_RTSP_VIDEO_SERVER_WORKER_RTSP_SERVER_HPP
@@ -0,0 +1,139 @@
+#ifndef LIRS_RTSP_VIDEO_SERVER_X264_SLICE_ENCODER_HPP
+#define LIRS_RTSP_VIDEO_SERVER_X264_SLICE_ENCODER_HPP
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "NalUnit.hpp"
+#include "config/params/Configuration.hpp"
+
+#ifdef __cplusplus
+extern "C" {
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+}
+#endif
+
+struct x264_t;
+
+struct x264_nal_t;
+
+namespace LIRS {
+
+    /**
+     * H.264 encoder passing each NAL unit on as soon as it is encoded (libx264 used directly).
+     *
+     * libavcodec hands out the frame once all of its slices are encoded, whereas libx264 reports every slice
+     * right after it is written (nalu_process callback), so the first slices of a frame can be sent while
+     * the rest of it is still being encoded. libx264 runs in the calling thread (as it does via libavcodec),
+     * so the units are passed in order and by the encoding thread only.
+     *
+     * Available if the server is built with libx264 (LIRS_WITH_X264).
+     */
+    class X264SliceEncoder {
+
+    public:
+
+        /**
+         * Called with the encoded unit (the last one of the frame is flagged) and the pts of its frame.
+         */
+        using Callback = std::function<void(NalUnit &&, int64_t)>;
+
+        /**
+         * Opens the encoder configured by the camera's encoder parameters (preset, tune, VBV, slices, etc.).
+         *
+         * @param config - camera configuration (the output resolution and frame rate, the encoder parameters).
+         * @param pixelFormat - pixel format of the frames to be encoded.
+         * @param onNalUnit - called for each encoded unit.
+         * @return opened encoder or nullptr if it cannot be opened (or libx264 is not available).
+         */
+        static std::unique_ptr<X264SliceEncoder> create(lirs::config::params::CameraParameters const &config,
+                                                        AVPixelFormat pixelFormat, Callback onNalUnit);
+
+        ~X264SliceEncoder();
+
+        X264SliceEncoder(X264SliceEncoder const &) = delete;
+
+        X264SliceEncoder &operator=(X264SliceEncoder const &) = delete;
+
+        /**
+         * Encodes the frame (the encoder keeps its own copy), the units are passed to the callback meanwhile.
+         * The units may belong to an earlier frame (lookahead, B-frames).
+         *
+         * @param frame - frame to be encoded (its pts is passed along with the units, pict_type I - IDR frame).
+         * @return false - if an error occurred.
+         */
+        bool encode(AVFrame const *frame);
+
+        /**
+         * Changes the target bitrate and VBV between the frames.
+         *
+         * @param bitrate - bitrate in kbps.
+         * @param vbvBufSize - VBV buffer size in kbits.
+         * @return false - if the encoder cannot be reconfigured.
+         */
+        bool reconfigureBitrate(uint16_t bitrate, int vbvBufSize);
+
+        /**
+         * Returns the parameter sets of the stream (Annex B byte stream).
+         */
+        std::vector<uint8_t> const &getHeaders() const;
+
+    private:
+
+        /**
+         * Number of remembered frames (opaque data of the frames delayed by the encoder).
+         */
+        constexpr static size_t FRAMES_HISTORY_SIZE = 256;
+
+        /**
+         * Frame's data passed through the encoder (x264 picture's opaque).
+         */
+        struct FrameInfo {
+
+            X264SliceEncoder *encoder;
+
+            int64_t pts;
+        };
+
+        x264_t *encoder;
+
+        Callback onNalUnit;
+
+        /**
+         * Colorspace and the number of planes of the frames (x264's csp).
+         */
+        int colorspace;
+
+        int numPlanes;
+
+        /**
+         * Number of macroblocks per frame (the last slice of the frame ends with the last one).
+         */
+        int numMacroblocks;
+
+        std::vector<FrameInfo> frames;
+
+        /**
+         * Buffers the units are encapsulated into (sized for a slice, the larger units are allocated).
+         */
+        AVBufferPool *bufferPool;
+
+        int bufferSize;
+
+        std::vector<uint8_t> headers;
+
+        X264SliceEncoder(Callback onNalUnit, int colorspace, int numPlanes, int numMacroblocks, int bufferSize);
+
+        /**
+         * Encapsulates the NAL unit written by the encoder and passes it to the callback.
+         */
+        void handleNalUnit(x264_t *h, x264_nal_t *nal, int64_t pts);
+
+        static void handleNalUnit0(x264_t *h, x264_nal_t *nal, void *opaque);
+    };
+}
+
+#endif //LIRS_RTSP_VIDEO_SERVER_X264_SLICE_ENCODER_HPP
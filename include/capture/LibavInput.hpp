@@ -0,0 +1,176 @@
+#ifndef LIRS_RTSP_VIDEO_SERVER_LIBAV_INPUT_HPP
+#define LIRS_RTSP_VIDEO_SERVER_LIBAV_INPUT_HPP
+
+#include <string>
+
+#include "capture/VideoInput.hpp"
+
+#ifdef __cplusplus
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavdevice/avdevice.h>
+}
+#endif
+
+namespace LIRS {
+
+    /**
+     * Video input demuxing and decoding the resource using libavformat/libavdevice.
+     * Used for video devices which cannot be captured natively and for video files.
+     *
+     * In the passthrough mode the compressed packets are handed out as is (see grabPacket), nothing is decoded.
+     */
+    class LibavInput : public VideoInput {
+
+    public:
+
+        /**
+         * Constructs an input for the resource (the resource is not opened).
+         *
+         * @param resource - video device path or video file path.
+         * @param inputFormat - name of the input format, e.g. 'v4l2', or empty to detect it automatically.
+         * @param width - requested frame width (devices only).
+         * @param height - requested frame height (devices only).
+         * @param pixelFormat - requested raw pixel format (devices only).
+         * @param frameRate - requested framerate (devices only).
+         * @param isLooped - whether to start over at the end of the resource and to pace frames to real time.
+         * @param passthroughCodecId - codec of the compressed video to be passed through (requested from devices),
+         * AV_CODEC_ID_NONE - frames are decoded.
+         */
+        LibavInput(std::string resource, std::string inputFormat, int width, int height, AVPixelFormat pixelFormat,
+                   AVRational frameRate, bool isLooped, AVCodecID passthroughCodecId = AV_CODEC_ID_NONE);
+
+        LibavInput(const LibavInput &) = delete;
+
+        LibavInput &operator=(const LibavInput &) = delete;
+
+        ~LibavInput() override;
+
+        bool open() override;
+
+        AVFrame *grab(int timeoutMs) override;
+
+        void release(AVFrame *frame) override;
+
+        /**
+         * Grabs the next compressed packet (passthrough mode).
+         * The packet's data is Annex B byte stream, the packet's pts is the capture time in microseconds.
+         *
+         * @param timeoutMs - max time to wait for the packet in milliseconds.
+         * @return packet or nullptr if there is no packet (timeout, error, etc.).
+         */
+        AVPacket *grabPacket(int timeoutMs);
+
+        /**
+         * Releases the packet returned by grabPacket.
+         */
+        void releasePacket(AVPacket *packet);
+
+        /**
+         * Returns the parameters of the handed out compressed stream (passthrough mode),
+         * the extradata (if any) is Annex B byte stream.
+         */
+        AVCodecParameters const *getPacketParameters() const;
+
+        int getWidth() const override;
+
+        int getHeight() const override;
+
+        AVPixelFormat getPixelFormat() const override;
+
+        AVRational getFrameRate() const override;
+
+    private:
+
+        std::string resource;
+
+        std::string inputFormat;
+
+        int width;
+
+        int height;
+
+        AVPixelFormat pixelFormat;
+
+        AVRational frameRate;
+
+        bool isLooped;
+
+        AVCodecID passthroughCodecId;
+
+        AVFormatContext *formatContext;
+
+        AVCodecContext *codecContext;
+
+        AVStream *videoStream;
+
+        /**
+         * Converts the length prefixed packets (e.g. MP4) into Annex B byte stream (passthrough mode).
+         */
+        AVBSFContext *bsfContext;
+
+        /**
+         * Demuxed packet (is sent to the decoder).
+         */
+        AVPacket *packet;
+
+        /**
+         * Decoded frame.
+         */
+        AVFrame *decodedFrame;
+
+        /**
+         * Monotonic time (in microseconds) the current pass over the resource has started at.
+         * Used to pace the looped resource.
+         */
+        int64_t passStartTimeUs;
+
+        /**
+         * Timestamp (in microseconds) of the first frame in the current pass.
+         */
+        int64_t passFirstPtsUs;
+
+        /**
+         * Presentation time of the last grabbed frame (monotonic, in microseconds).
+         */
+        int64_t lastFrameTimeUs;
+
+        /**
+         * Reads the next packet of the video stream.
+         *
+         * @return >= 0 if success, AVERROR_EOF - the end of the resource (looped resources are rewound instead),
+         * otherwise - error occurred.
+         */
+        int readNextPacket();
+
+        /**
+         * Converts the frame's timestamp into the capture time pacing the looped resource to real time.
+         *
+         * @param timestamp - frame's timestamp in the stream's time base or AV_NOPTS_VALUE.
+         * @return capture time in microseconds.
+         */
+        int64_t toFrameTimeUs(int64_t timestamp);
+
+        /**
+         * Initializes the bitstream filter converting the stream into Annex B byte stream (if needed).
+         */
+        bool initializeBitstreamFilter();
+
+        /**
+         * Decodes the next frame into the decoded frame.
+         *
+         * @return >= 0 if success, AVERROR_EOF - the end of the resource, otherwise - error occurred.
+         */
+        int decodeNextFrame();
+
+        /**
+         * Seeks to the beginning of the resource to start the next pass.
+         */
+        void rewind();
+
+        void close();
+    };
+}
+
+#endif //LIRS_RTSP_VIDEO_SERVER_LIBAV_INPUT_HPP
@@ -0,0 +1,110 @@
+#ifndef LIRS_RTSP_VIDEO_SERVER_SYNTHETIC_INPUT_HPP
+#define LIRS_RTSP_VIDEO_SERVER_SYNTHETIC_INPUT_HPP
+
+#include <vector>
+
+#include "capture/VideoInput.hpp"
+#include "utils/BoundedQueue.hpp"
+
+#ifdef __cplusplus
+extern "C" {
+#include <libswscale/swscale.h>
+}
+#endif
+
+namespace LIRS {
+
+    /**
+     * In-process test pattern generator (no camera is needed).
+     * Generates horizontally scrolling color bars at the requested resolution, pixel format and framerate.
+     */
+    class SyntheticInput : public VideoInput {
+
+    public:
+
+        /**
+         * Constructs the generator.
+         *
+         * @param width - frame width.
+         * @param height - frame height.
+         * @param pixelFormat - raw pixel format of the generated frames.
+         * @param frameRate - framerate the frames are generated at.
+         * @param motion - horizontal scrolling speed in pixels per frame (0 - static pattern).
+         */
+        SyntheticInput(int width, int height, AVPixelFormat pixelFormat, AVRational frameRate, int motion);
+
+        SyntheticInput(const SyntheticInput &) = delete;
+
+        SyntheticInput &operator=(const SyntheticInput &) = delete;
+
+        ~SyntheticInput() override;
+
+        bool open() override;
+
+        AVFrame *grab(int timeoutMs) override;
+
+        void release(AVFrame *frame) override;
+
+        int getWidth() const override;
+
+        int getHeight() const override;
+
+        AVPixelFormat getPixelFormat() const override;
+
+        AVRational getFrameRate() const override;
+
+    private:
+
+        /**
+         * Number of frames which can be handed out at the same time.
+         */
+        constexpr static unsigned int NUM_FRAMES = 4U;
+
+        /**
+         * Number of color bars in the pattern.
+         */
+        constexpr static int NUM_BARS = 8;
+
+        int width;
+
+        int height;
+
+        AVPixelFormat pixelFormat;
+
+        AVRational frameRate;
+
+        int motion;
+
+        /**
+         * RGB pattern twice as wide as the frame, the frame is a scrolling window over it.
+         */
+        std::vector<uint8_t> pattern;
+
+        /**
+         * Converts the pattern's window into the requested pixel format.
+         */
+        SwsContext *converterContext;
+
+        /**
+         * Frames which are not handed out.
+         */
+        lirs::utils::BoundedQueue<AVFrame *> freeFrames;
+
+        /**
+         * Index of the next frame to be generated.
+         */
+        int64_t frameIndex;
+
+        /**
+         * Monotonic time (in microseconds) the next frame is due.
+         */
+        int64_t nextFrameTimeUs;
+
+        /**
+         * Draws the pattern (color bars with a luma ramp at the bottom).
+         */
+        void drawPattern();
+    };
+}
+
+#endif //LIRS_RTSP_VIDEO_SERVER_SYNTHETIC_INPUT_HPP
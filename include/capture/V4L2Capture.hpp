@@ -0,0 +1,149 @@
+#ifndef LIRS_RTSP_VIDEO_SERVER_V4L2_CAPTURE_HPP
+#define LIRS_RTSP_VIDEO_SERVER_V4L2_CAPTURE_HPP
+
+#include <string>
+#include <vector>
+
+#include "capture/VideoInput.hpp"
+
+namespace LIRS {
+
+    /**
+     * Native Video4Linux2 capture using memory mapped driver buffers.
+     *
+     * Captured frames are not copied: they are handed out as borrowed (not reference counted) AVFrames
+     * pointing directly into the mapped driver buffers. The buffer must be given back with release()
+     * as soon as the frame data is no longer needed (e.g. after the pixel format conversion).
+     */
+    class V4L2Capture : public VideoInput {
+
+    public:
+
+        /**
+         * Constructs a capture object for the video device (the device is not opened).
+         *
+         * @param device - path to the video device, e.g. /dev/video0.
+         * @param width - requested frame width.
+         * @param height - requested frame height.
+         * @param pixelFormat - requested raw pixel format.
+         * @param frameRate - requested framerate.
+         */
+        V4L2Capture(std::string device, int width, int height, AVPixelFormat pixelFormat, AVRational frameRate);
+
+        V4L2Capture(const V4L2Capture &) = delete;
+
+        V4L2Capture &operator=(const V4L2Capture &) = delete;
+
+        /**
+         * Stops streaming, unmaps the buffers and closes the device.
+         */
+        ~V4L2Capture() override;
+
+        /**
+         * Checks whether the pixel format can be captured natively (has a V4L2 counterpart).
+         *
+         * @param pixelFormat - raw pixel format.
+         * @return true - if the format is supported, otherwise - false.
+         */
+        static bool isSupported(AVPixelFormat pixelFormat);
+
+        /**
+         * Opens the device, negotiates the format, maps the buffers and starts streaming.
+         *
+         * @return true - if the device is ready to capture, otherwise - false.
+         */
+        bool open() override;
+
+        /**
+         * Waits for the next filled buffer and exposes it as a borrowed frame pointing at the buffer's data.
+         * Frame's pts is the driver's capture timestamp in microseconds.
+         * The frame is owned by the capture and stays valid until it is released.
+         *
+         * @param timeoutMs - maximum waiting time in milliseconds.
+         * @return borrowed frame or nullptr if no frame is available.
+         */
+        AVFrame *grab(int timeoutMs) override;
+
+        /**
+         * Gives the frame's buffer back to the driver (re-queues it).
+         * Can be called from a thread other than the capturing one.
+         *
+         * @param frame - frame returned by grab().
+         */
+        void release(AVFrame *frame) override;
+
+        int getWidth() const override;
+
+        int getHeight() const override;
+
+        AVPixelFormat getPixelFormat() const override;
+
+        AVRational getFrameRate() const override;
+
+    private:
+
+        /**
+         * Memory mapped driver buffer.
+         */
+        struct MappedBuffer {
+
+            void *start;
+
+            size_t length;
+
+            /**
+             * Borrowed frame pointing at the buffer's data.
+             */
+            AVFrame *frame;
+        };
+
+        /**
+         * Number of buffers requested from the driver.
+         * Enough to keep the driver busy while frames wait to be converted.
+         */
+        constexpr static unsigned int NUM_BUFFERS = 4U;
+
+        std::string device;
+
+        int width;
+
+        int height;
+
+        /**
+         * Number of bytes between two consecutive lines (reported by the driver).
+         */
+        int bytesPerLine;
+
+        AVPixelFormat pixelFormat;
+
+        AVRational frameRate;
+
+        /**
+         * Video device's file descriptor.
+         */
+        int fd;
+
+        bool isStreaming;
+
+        std::vector<MappedBuffer> buffers;
+
+        /**
+         * Converts ffmpeg pixel format into V4L2 fourcc code.
+         *
+         * @param pixelFormat - ffmpeg pixel format.
+         * @return V4L2 fourcc code or 0 if there is no counterpart.
+         */
+        static uint32_t toFourcc(AVPixelFormat pixelFormat);
+
+        /**
+         * Invokes ioctl restarting it if interrupted by a signal.
+         */
+        int xioctl(unsigned long request, void *arg);
+
+        void requeue(uint32_t bufferIndex);
+
+        void close();
+    };
+}
+
+#endif //LIRS_RTSP_VIDEO_SERVER_V4L2_CAPTURE_HPP
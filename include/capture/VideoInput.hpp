@@ -0,0 +1,84 @@
+#ifndef LIRS_RTSP_VIDEO_SERVER_VIDEO_INPUT_HPP
+#define LIRS_RTSP_VIDEO_SERVER_VIDEO_INPUT_HPP
+
+#include <memory>
+
+#include "config/params/Configuration.hpp"
+
+#ifdef __cplusplus
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+}
+#endif
+
+namespace LIRS {
+
+    class LibavInput;
+
+    /**
+     * Source of raw video frames (camera, video file, synthetic pattern, etc.).
+     *
+     * Frames are owned by the input: they are handed out by grab() and must be given back with release()
+     * as soon as their data is no longer needed. Frame's pts is its capture time in microseconds
+     * (either monotonic or real time clock).
+     */
+    class VideoInput {
+
+    public:
+
+        virtual ~VideoInput() = default;
+
+        /**
+         * Creates the video input selected by the camera's resource:
+         * - synthetic://<pattern>[?motion=<pixels per frame>] - in-process test pattern generator;
+         * - file://<path> - video file looped and paced to real time;
+         * - otherwise - video device (V4L2 memory mapped capture or libavdevice).
+         *
+         * @param config - camera configuration.
+         * @return opened video input or nullptr if the resource cannot be opened.
+         */
+        static std::unique_ptr<VideoInput> create(lirs::config::params::CameraParameters const &config);
+
+        /**
+         * Creates the input handing out the compressed packets of the camera's resource (passthrough mode).
+         * Video devices are asked for the passthrough codec, video files (file://<path>) are looped.
+         *
+         * @param config - camera configuration.
+         * @return opened input or nullptr if the resource cannot be opened or is not compressed by the codec.
+         */
+        static std::unique_ptr<LibavInput> createPassthrough(lirs::config::params::CameraParameters const &config);
+
+        /**
+         * Opens the resource and prepares it for capturing.
+         *
+         * @return true - if the input is ready, otherwise - false.
+         */
+        virtual bool open() = 0;
+
+        /**
+         * Waits for the next raw frame.
+         *
+         * @param timeoutMs - maximum waiting time in milliseconds.
+         * @return frame or nullptr if no frame is available.
+         */
+        virtual AVFrame *grab(int timeoutMs) = 0;
+
+        /**
+         * Gives the frame back to the input. Can be called from a thread other than the capturing one.
+         *
+         * @param frame - frame returned by grab().
+         */
+        virtual void release(AVFrame *frame) = 0;
+
+        virtual int getWidth() const = 0;
+
+        virtual int getHeight() const = 0;
+
+        virtual AVPixelFormat getPixelFormat() const = 0;
+
+        virtual AVRational getFrameRate() const = 0;
+    };
+}
+
+#endif //LIRS_RTSP_VIDEO_SERVER_VIDEO_INPUT_HPP
@@ -65,19 +65,50 @@ namespace lirs {
                 std::string m_pixelFormat;
             };
 
+            /**
+             * Video coding formats which can be streamed.
+             */
+            enum class VideoCodec : uint8_t {
+                NONE = 0,
+                H264, // libx264
+                H265, // libx265
+                VP8,  // libvpx
+                VP9   // libvpx-vp9
+            };
+
             class EncoderParameters {
 
             public:
 
                 // default constructor
 
-                EncoderParameters() : m_slices(0),
+                EncoderParameters() : m_codec(VideoCodec::H265),
+                                      m_slices(0),
                                       m_bitrate(0),
                                       m_vbvBufSize(0),
-                                      m_intraRefreshEnabled(false) {}
+                                      m_intraRefreshEnabled(false),
+                                      m_sliceMaxSize(0),
+                                      m_keyFrameRequestWindowMs(DEFAULT_KEY_FRAME_REQUEST_WINDOW_MS),
+                                      m_frameThreads(UNSET),
+                                      m_wppEnabled(true),
+                                      m_lookaheadSlices(UNSET),
+                                      m_keyint(UNSET),
+                                      m_bframes(UNSET),
+                                      m_rcLookahead(UNSET),
+                                      m_numaNode(UNSET) {}
+
+                /**
+                 * Value of the optional numeric parameters which are not set (the encoder's default is used).
+                 */
+                constexpr static int UNSET = -1;
 
                 // setters
 
+                EncoderParameters &setCodec(VideoCodec codec) {
+                    m_codec = codec;
+                    return *this;
+                }
+
                 EncoderParameters &setTune(std::string tune) {
                     m_tune = std::move(tune);
                     return *this;
@@ -108,8 +139,67 @@ namespace lirs {
                     return *this;
                 }
 
+                EncoderParameters &setSliceMaxSize(uint16_t sliceMaxSize) {
+                    m_sliceMaxSize = sliceMaxSize;
+                    return *this;
+                }
+
+                EncoderParameters &setKeyFrameRequestWindowMs(uint16_t keyFrameRequestWindowMs) {
+                    m_keyFrameRequestWindowMs = keyFrameRequestWindowMs;
+                    return *this;
+                }
+
+                EncoderParameters &setPools(std::string pools) {
+                    m_pools = std::move(pools);
+                    return *this;
+                }
+
+                EncoderParameters &setFrameThreads(int frameThreads) {
+                    m_frameThreads = frameThreads;
+                    return *this;
+                }
+
+                EncoderParameters &setWppEnabled(bool wppEnabled) {
+                    m_wppEnabled = wppEnabled;
+                    return *this;
+                }
+
+                EncoderParameters &setLookaheadSlices(int lookaheadSlices) {
+                    m_lookaheadSlices = lookaheadSlices;
+                    return *this;
+                }
+
+                EncoderParameters &setKeyint(int keyint) {
+                    m_keyint = keyint;
+                    return *this;
+                }
+
+                EncoderParameters &setBframes(int bframes) {
+                    m_bframes = bframes;
+                    return *this;
+                }
+
+                EncoderParameters &setRcLookahead(int rcLookahead) {
+                    m_rcLookahead = rcLookahead;
+                    return *this;
+                }
+
+                EncoderParameters &setCpuAffinity(std::vector<uint16_t> cpuAffinity) {
+                    m_cpuAffinity = std::move(cpuAffinity);
+                    return *this;
+                }
+
+                EncoderParameters &setNumaNode(int numaNode) {
+                    m_numaNode = numaNode;
+                    return *this;
+                }
+
                 // getters
 
+                VideoCodec getCodec() const {
+                    return m_codec;
+                }
+
                 std::string const &getTune() const {
                     return m_tune;
                 }
@@ -134,8 +224,58 @@ namespace lirs {
                     return m_intraRefreshEnabled;
                 }
 
+                // max size of the slice NAL units in bytes (0 - not limited)
+                uint16_t getSliceMaxSize() const {
+                    return m_sliceMaxSize;
+                }
+
+                // min interval between the key frames requested by the joining clients (0 - not requested)
+                uint16_t getKeyFrameRequestWindowMs() const {
+                    return m_keyFrameRequestWindowMs;
+                }
+
+                std::string const &getPools() const {
+                    return m_pools;
+                }
+
+                int getFrameThreads() const {
+                    return m_frameThreads;
+                }
+
+                bool isWppEnabled() const {
+                    return m_wppEnabled;
+                }
+
+                int getLookaheadSlices() const {
+                    return m_lookaheadSlices;
+                }
+
+                int getKeyint() const {
+                    return m_keyint;
+                }
+
+                int getBframes() const {
+                    return m_bframes;
+                }
+
+                int getRcLookahead() const {
+                    return m_rcLookahead;
+                }
+
+                std::vector<uint16_t> const &getCpuAffinity() const {
+                    return m_cpuAffinity;
+                }
+
+                int getNumaNode() const {
+                    return m_numaNode;
+                }
+
             private:
 
+                constexpr static uint16_t DEFAULT_KEY_FRAME_REQUEST_WINDOW_MS = 1000;
+
+                VideoCodec m_codec;
+
                 std::string m_tune;
 
                 std::string m_preset;
@@ -147,12 +287,299 @@ namespace lirs {
                 uint16_t m_vbvBufSize;
 
                 bool m_intraRefreshEnabled;
+
+                uint16_t m_sliceMaxSize;
+
+                uint16_t m_keyFrameRequestWindowMs;
+
+                // threading (x265)
+
+                std::string m_pools;
+
+                int m_frameThreads;
+
+                bool m_wppEnabled;
+
+                int m_lookaheadSlices;
+
+                // GOP and lookahead
+
+                int m_keyint;
+
+                int m_bframes;
+
+                int m_rcLookahead;
+
+                // CPUs the encoder's threads run on
+
+                std::vector<uint16_t> m_cpuAffinity;
+
+                int m_numaNode;
+            };
+
+            /**
+             * What to drop when a pipeline queue is full.
+             */
+            enum class DropPolicy : uint8_t {
+                DROP_OLDEST = 0, // the queued frame is dropped (lower latency)
+                DROP_NEWEST      // the incoming frame is dropped
+            };
+
+            /**
+             * What to do when the queue of encoded data (waiting to be streamed) is full.
+             */
+            enum class OverflowPolicy : uint8_t {
+                DROP_UNTIL_KEY_FRAME = 0, // the data is dropped until the next key frame (no decoding artifacts)
+                BLOCK                     // the encoder waits for the streaming to catch up
+            };
+
+            class PipelineParameters {
+
+            public:
+
+                /**
+                 * Idle timeout value meaning the camera is never paused.
+                 */
+                constexpr static int NEVER = -1;
+
+                // default constructor
+
+                PipelineParameters() : m_queueSize(DEFAULT_QUEUE_SIZE),
+                                       m_dropPolicy(DropPolicy::DROP_OLDEST),
+                                       m_nalQueueSize(DEFAULT_NAL_QUEUE_SIZE),
+                                       m_overflowPolicy(OverflowPolicy::DROP_UNTIL_KEY_FRAME),
+                                       m_gopCacheSize(DEFAULT_GOP_CACHE_SIZE),
+                                       m_idleTimeoutMs(DEFAULT_IDLE_TIMEOUT_MS) {}
+
+                // setters
+
+                PipelineParameters &setQueueSize(uint16_t queueSize) {
+                    m_queueSize = queueSize;
+                    return *this;
+                }
+
+                PipelineParameters &setDropPolicy(DropPolicy dropPolicy) {
+                    m_dropPolicy = dropPolicy;
+                    return *this;
+                }
+
+                PipelineParameters &setNalQueueSize(uint16_t nalQueueSize) {
+                    m_nalQueueSize = nalQueueSize;
+                    return *this;
+                }
+
+                PipelineParameters &setOverflowPolicy(OverflowPolicy overflowPolicy) {
+                    m_overflowPolicy = overflowPolicy;
+                    return *this;
+                }
+
+                PipelineParameters &setGopCacheSize(uint16_t gopCacheSize) {
+                    m_gopCacheSize = gopCacheSize;
+                    return *this;
+                }
+
+                PipelineParameters &setIdleTimeoutMs(int idleTimeoutMs) {
+                    m_idleTimeoutMs = idleTimeoutMs;
+                    return *this;
+                }
+
+                // getters
+
+                uint16_t getQueueSize() const {
+                    return m_queueSize;
+                }
+
+                DropPolicy getDropPolicy() const {
+                    return m_dropPolicy;
+                }
+
+                uint16_t getNalQueueSize() const {
+                    return m_nalQueueSize;
+                }
+
+                OverflowPolicy getOverflowPolicy() const {
+                    return m_overflowPolicy;
+                }
+
+                uint16_t getGopCacheSize() const {
+                    return m_gopCacheSize;
+                }
+
+                bool isGopCacheEnabled() const {
+                    return m_gopCacheSize > 0;
+                }
+
+                // time the camera keeps capturing without clients before it is paused (NEVER - not paused)
+                int getIdleTimeoutMs() const {
+                    return m_idleTimeoutMs;
+                }
+
+            private:
+
+                constexpr static uint16_t DEFAULT_QUEUE_SIZE = 2;
+
+                constexpr static uint16_t DEFAULT_NAL_QUEUE_SIZE = 128;
+
+                constexpr static uint16_t DEFAULT_GOP_CACHE_SIZE = 4096;
+
+                constexpr static int DEFAULT_IDLE_TIMEOUT_MS = 10000;
+
+                uint16_t m_queueSize;
+
+                DropPolicy m_dropPolicy;
+
+                // encoded data (NAL units) waiting to be streamed
+
+                uint16_t m_nalQueueSize;
+
+                OverflowPolicy m_overflowPolicy;
+
+                // max number of encoded units of the current group of pictures cached for new clients (0 - disabled)
+
+                uint16_t m_gopCacheSize;
+
+                int m_idleTimeoutMs;
+            };
+
+            /**
+             * Encoder's bitrate driven by the clients' RTCP receiver reports.
+             */
+            class AdaptiveBitrateParameters {
+
+            public:
+
+                // default constructor
+
+                AdaptiveBitrateParameters() : m_enabled(false),
+                                              m_minBitrate(0),
+                                              m_maxBitrate(0),
+                                              m_lossHigh(DEFAULT_LOSS_HIGH),
+                                              m_lossLow(DEFAULT_LOSS_LOW),
+                                              m_maxJitterMs(DEFAULT_MAX_JITTER_MS),
+                                              m_intervalMs(DEFAULT_INTERVAL_MS),
+                                              m_increaseHoldMs(DEFAULT_INCREASE_HOLD_MS) {}
+
+                // setters
+
+                AdaptiveBitrateParameters &setEnabled(bool enabled) {
+                    m_enabled = enabled;
+                    return *this;
+                }
+
+                AdaptiveBitrateParameters &setMinBitrate(uint16_t minBitrate) {
+                    m_minBitrate = minBitrate;
+                    return *this;
+                }
+
+                AdaptiveBitrateParameters &setMaxBitrate(uint16_t maxBitrate) {
+                    m_maxBitrate = maxBitrate;
+                    return *this;
+                }
+
+                AdaptiveBitrateParameters &setLossHigh(double lossHigh) {
+                    m_lossHigh = lossHigh;
+                    return *this;
+                }
+
+                AdaptiveBitrateParameters &setLossLow(double lossLow) {
+                    m_lossLow = lossLow;
+                    return *this;
+                }
+
+                AdaptiveBitrateParameters &setMaxJitterMs(int maxJitterMs) {
+                    m_maxJitterMs = maxJitterMs;
+                    return *this;
+                }
+
+                AdaptiveBitrateParameters &setIntervalMs(int intervalMs) {
+                    m_intervalMs = intervalMs;
+                    return *this;
+                }
+
+                AdaptiveBitrateParameters &setIncreaseHoldMs(int increaseHoldMs) {
+                    m_increaseHoldMs = increaseHoldMs;
+                    return *this;
+                }
+
+                // getters
+
+                bool isEnabled() const {
+                    return m_enabled;
+                }
+
+                // floor and ceiling of the bitrate (kbps)
+
+                uint16_t getMinBitrate() const {
+                    return m_minBitrate;
+                }
+
+                uint16_t getMaxBitrate() const {
+                    return m_maxBitrate;
+                }
+
+                // reported fraction of the lost packets above which the bitrate is decreased
+                double getLossHigh() const {
+                    return m_lossHigh;
+                }
+
+                // reported fraction of the lost packets below which the bitrate may be increased
+                double getLossLow() const {
+                    return m_lossLow;
+                }
+
+                // reported interarrival jitter above which the bitrate is not increased (0 - ignored)
+                int getMaxJitterMs() const {
+                    return m_maxJitterMs;
+                }
+
+                // how often the receiver reports are evaluated
+                int getIntervalMs() const {
+                    return m_intervalMs;
+                }
+
+                // min time between a change of the bitrate and its increase
+                int getIncreaseHoldMs() const {
+                    return m_increaseHoldMs;
+                }
+
+            private:
+
+                constexpr static double DEFAULT_LOSS_HIGH = 0.1;
+
+                constexpr static double DEFAULT_LOSS_LOW = 0.02;
+
+                constexpr static int DEFAULT_MAX_JITTER_MS = 0;
+
+                constexpr static int DEFAULT_INTERVAL_MS = 1000;
+
+                constexpr static int DEFAULT_INCREASE_HOLD_MS = 10000;
+
+                bool m_enabled;
+
+                uint16_t m_minBitrate;
+
+                uint16_t m_maxBitrate;
+
+                double m_lossHigh;
+
+                double m_lossLow;
+
+                int m_maxJitterMs;
+
+                int m_intervalMs;
+
+                int m_increaseHoldMs;
             };
 
             class CameraParameters {
 
             public:
 
+                // default constructor
+
+                CameraParameters() : m_zeroCopyCaptureEnabled(true),
+                                     m_passthroughCodec(VideoCodec::NONE) {}
+
                 // setters
 
                 CameraParameters &setName(std::string name) {
@@ -180,6 +607,26 @@ namespace lirs {
                     return *this;
                 }
 
+                CameraParameters &setPipelineParams(PipelineParameters const &pipelineParams) {
+                    m_pipelineParams = pipelineParams;
+                    return *this;
+                }
+
+                CameraParameters &setAdaptiveBitrateParams(AdaptiveBitrateParameters const &adaptiveBitrateParams) {
+                    m_adaptiveBitrateParams = adaptiveBitrateParams;
+                    return *this;
+                }
+
+                CameraParameters &setZeroCopyCaptureEnabled(bool zeroCopyCaptureEnabled) {
+                    m_zeroCopyCaptureEnabled = zeroCopyCaptureEnabled;
+                    return *this;
+                }
+
+                CameraParameters &setPassthroughCodec(VideoCodec passthroughCodec) {
+                    m_passthroughCodec = passthroughCodec;
+                    return *this;
+                }
+
                 // getters
 
                 std::string const &getName() const {
@@ -202,6 +649,27 @@ namespace lirs {
                     return m_encoderParams;
                 }
 
+                PipelineParameters const &getPipelineParams() const {
+                    return m_pipelineParams;
+                }
+
+                AdaptiveBitrateParameters const &getAdaptiveBitrateParams() const {
+                    return m_adaptiveBitrateParams;
+                }
+
+                bool isZeroCopyCaptureEnabled() const {
+                    return m_zeroCopyCaptureEnabled;
+                }
+
+                VideoCodec getPassthroughCodec() const {
+                    return m_passthroughCodec;
+                }
+
+                // the source's compressed video is streamed as is (no transcoding)
+                bool isPassthroughEnabled() const {
+                    return m_passthroughCodec != VideoCodec::NONE;
+                }
+
             private:
 
                 std::string m_name;
@@ -213,18 +681,73 @@ namespace lirs {
                 GenericCameraParameters m_outputParams;
 
                 EncoderParameters m_encoderParams;
+
+                PipelineParameters m_pipelineParams;
+
+                AdaptiveBitrateParameters m_adaptiveBitrateParams;
+
+                bool m_zeroCopyCaptureEnabled;
+
+                VideoCodec m_passthroughCodec;
+            };
+
+            /**
+             * How the event loop waits for the socket events.
+             */
+            enum class TaskSchedulerType : uint8_t {
+                SELECT = 0, // select() (Live555's basic scheduler, at most FD_SETSIZE sockets)
+                EPOLL       // epoll (Linux, no limit on the number of sockets)
             };
 
             class ServerParameters {
 
             public:
 
+                /**
+                 * Default TTL of the multicast streams (a few routers within the site).
+                 */
+                constexpr static uint8_t DEFAULT_MULTICAST_TTL = 16;
+
+                /**
+                 * Default size of the TCP clients' send queues in bytes (about a second of a few Mbps stream).
+                 */
+                constexpr static uint32_t DEFAULT_TCP_QUEUE_SIZE = 512 * 1024;
+
+                /**
+                 * Default pacing window as a fraction of the frame interval.
+                 */
+                constexpr static double DEFAULT_PACING_WINDOW = 0.5;
+
+                /**
+                 * Default number of max size packets sent back-to-back by the pacer.
+                 */
+                constexpr static uint16_t DEFAULT_PACING_BURST = 4;
+
+                /**
+                 * Default number of the recently sent packets kept for retransmission per client
+                 * (about a second of a few Mbps stream).
+                 */
+                constexpr static uint16_t DEFAULT_RETRANSMISSION_HISTORY_SIZE = 512;
+
                 // default constructor
                 ServerParameters() : m_maxPacketSize(0),
                                      m_rtspPortNum(0),
                                      m_maxBufSize(0),
                                      m_httpEnabled(false),
                                      m_httpPortNum(0),
+                                     m_sharedFanoutEnabled(true),
+                                     m_numWorkers(0),
+                                     m_taskSchedulerType(TaskSchedulerType::SELECT),
+                                     m_multicastEnabled(false),
+                                     m_multicastPortNum(0),
+                                     m_multicastTtl(DEFAULT_MULTICAST_TTL),
+                                     m_tcpQueueSize(DEFAULT_TCP_QUEUE_SIZE),
+                                     m_pacingEnabled(false),
+                                     m_pacingWindow(DEFAULT_PACING_WINDOW),
+                                     m_pacingBurst(DEFAULT_PACING_BURST),
+                                     m_retransmissionEnabled(false),
+                                     m_retransmissionHistorySize(DEFAULT_RETRANSMISSION_HISTORY_SIZE),
+                                     m_rtxEnabled(false),
                                      m_cameraTopicMappings({}) {}
 
                 ~ServerParameters() {
@@ -263,6 +786,76 @@ namespace lirs {
                     return *this;
                 }
 
+                ServerParameters &setSharedFanoutEnabled(bool sharedFanoutEnabled) {
+                    m_sharedFanoutEnabled = sharedFanoutEnabled;
+                    return *this;
+                }
+
+                ServerParameters &setNumWorkers(uint16_t numWorkers) {
+                    m_numWorkers = numWorkers;
+                    return *this;
+                }
+
+                ServerParameters &setTaskSchedulerType(TaskSchedulerType taskSchedulerType) {
+                    m_taskSchedulerType = taskSchedulerType;
+                    return *this;
+                }
+
+                ServerParameters &setMulticastEnabled(bool multicastEnabled) {
+                    m_multicastEnabled = multicastEnabled;
+                    return *this;
+                }
+
+                ServerParameters &setMulticastGroup(std::string multicastGroup) {
+                    m_multicastGroup = std::move(multicastGroup);
+                    return *this;
+                }
+
+                ServerParameters &setMulticastPortNum(uint16_t multicastPortNum) {
+                    m_multicastPortNum = multicastPortNum;
+                    return *this;
+                }
+
+                ServerParameters &setMulticastTtl(uint8_t multicastTtl) {
+                    m_multicastTtl = multicastTtl;
+                    return *this;
+                }
+
+                ServerParameters &setTcpQueueSize(uint32_t tcpQueueSize) {
+                    m_tcpQueueSize = tcpQueueSize;
+                    return *this;
+                }
+
+                ServerParameters &setPacingEnabled(bool pacingEnabled) {
+                    m_pacingEnabled = pacingEnabled;
+                    return *this;
+                }
+
+                ServerParameters &setPacingWindow(double pacingWindow) {
+                    m_pacingWindow = pacingWindow;
+                    return *this;
+                }
+
+                ServerParameters &setPacingBurst(uint16_t pacingBurst) {
+                    m_pacingBurst = pacingBurst;
+                    return *this;
+                }
+
+                ServerParameters &setRetransmissionEnabled(bool retransmissionEnabled) {
+                    m_retransmissionEnabled = retransmissionEnabled;
+                    return *this;
+                }
+
+                ServerParameters &setRetransmissionHistorySize(uint16_t retransmissionHistorySize) {
+                    m_retransmissionHistorySize = retransmissionHistorySize;
+                    return *this;
+                }
+
+                ServerParameters &setRtxEnabled(bool rtxEnabled) {
+                    m_rtxEnabled = rtxEnabled;
+                    return *this;
+                }
+
                 bool addCameraTopic(std::string cameraName, std::string topic) {
 
                     auto search = m_cameraTopicMappings.find(cameraName);
@@ -301,6 +894,62 @@ namespace lirs {
                     return m_httpPortNum;
                 }
 
+                bool isSharedFanoutEnabled() const {
+                    return m_sharedFanoutEnabled;
+                }
+
+                uint16_t getNumWorkers() const {
+                    return m_numWorkers;
+                }
+
+                TaskSchedulerType getTaskSchedulerType() const {
+                    return m_taskSchedulerType;
+                }
+
+                bool isMulticastEnabled() const {
+                    return m_multicastEnabled;
+                }
+
+                std::string const &getMulticastGroup() const {
+                    return m_multicastGroup;
+                }
+
+                uint16_t getMulticastPortNum() const {
+                    return m_multicastPortNum;
+                }
+
+                uint8_t getMulticastTtl() const {
+                    return m_multicastTtl;
+                }
+
+                uint32_t getTcpQueueSize() const {
+                    return m_tcpQueueSize;
+                }
+
+                bool isPacingEnabled() const {
+                    return m_pacingEnabled;
+                }
+
+                double getPacingWindow() const {
+                    return m_pacingWindow;
+                }
+
+                uint16_t getPacingBurst() const {
+                    return m_pacingBurst;
+                }
+
+                bool isRetransmissionEnabled() const {
+                    return m_retransmissionEnabled;
+                }
+
+                uint16_t getRetransmissionHistorySize() const {
+                    return m_retransmissionHistorySize;
+                }
+
+                bool isRtxEnabled() const {
+                    return m_rtxEnabled;
+                }
+
                 topic_mapping_t const &getCameraTopicMappings() const {
                     return m_cameraTopicMappings;
                 }
@@ -324,6 +973,73 @@ namespace lirs {
 
                 uint16_t m_httpPortNum;
 
+                /**
+                 * Whether the camera's clients share a single packetization of the stream
+                 * (otherwise each client gets its own replica of the stream).
+                 */
+                bool m_sharedFanoutEnabled;
+
+                /**
+                 * Number of event loops the clients are shared among (0 - everything runs on a single event loop).
+                 */
+                uint16_t m_numWorkers;
+
+                TaskSchedulerType m_taskSchedulerType;
+
+                /**
+                 * Whether each camera is also streamed to a source-specific multicast group.
+                 */
+                bool m_multicastEnabled;
+
+                /**
+                 * Multicast group of the first camera, the next cameras use the next addresses.
+                 */
+                std::string m_multicastGroup;
+
+                /**
+                 * RTP port of the multicast streams (RTCP - the next one).
+                 */
+                uint16_t m_multicastPortNum;
+
+                uint8_t m_multicastTtl;
+
+                /**
+                 * Max number of bytes waiting to be sent to a client streaming over TCP (RTSP or HTTP tunneling),
+                 * a client falling further behind skips the stream until the next key frame.
+                 */
+                uint32_t m_tcpQueueSize;
+
+                /**
+                 * Whether each frame's packets are spread over the pacing window (per client) instead of being sent
+                 * back-to-back.
+                 */
+                bool m_pacingEnabled;
+
+                /**
+                 * Pacing window as a fraction of the frame interval, (0, 1].
+                 */
+                double m_pacingWindow;
+
+                /**
+                 * Max number of max size packets sent back-to-back (pacer's token bucket size).
+                 */
+                uint16_t m_pacingBurst;
+
+                /**
+                 * Whether the packets reported lost by the clients' RTCP generic NACKs (RFC 4585) are resent.
+                 */
+                bool m_retransmissionEnabled;
+
+                /**
+                 * Number of the recently sent packets kept for retransmission per client.
+                 */
+                uint16_t m_retransmissionHistorySize;
+
+                /**
+                 * Whether the packets are resent as a separate RTX stream (RFC 4588) instead of as is.
+                 */
+                bool m_rtxEnabled;
+
                 topic_mapping_t m_cameraTopicMappings;
             };
 
@@ -0,0 +1,291 @@
+#ifndef LIRS_RTSP_VIDEO_SERVER_BOUNDED_QUEUE_HPP
+#define LIRS_RTSP_VIDEO_SERVER_BOUNDED_QUEUE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace lirs {
+
+    namespace utils {
+
+        /**
+         * Bounded lock-free FIFO queue (D. Vyukov's bounded MPMC queue).
+         *
+         * Pushing and popping never block. Consumers may wait for new elements using pop() with a timeout
+         * (producers may wait for free space using push() with a timeout), they are woken up only
+         * if someone is actually waiting (no syscalls on the hot path).
+         * Several producers or consumers are allowed, e.g. a producer may pop the oldest element
+         * in order to make room for a new one.
+         *
+         * @tparam T - element type (must be default constructible and movable).
+         */
+        template<typename T>
+        class BoundedQueue {
+
+        public:
+
+            explicit BoundedQueue(size_t capacity) : m_capacity(capacity > 0 ? capacity : 1),
+                                                     m_cells(m_capacity),
+                                                     m_enqueuePos(0),
+                                                     m_dequeuePos(0),
+                                                     m_numWaiters(0),
+                                                     m_numPushWaiters(0) {
+
+                for (size_t idx = 0; idx < m_capacity; ++idx) {
+                    m_cells[idx].sequence.store(idx, std::memory_order_relaxed);
+                }
+            }
+
+            BoundedQueue(const BoundedQueue &) = delete;
+
+            BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+            /**
+             * Pushes the element to the back of the queue.
+             *
+             * @param value - element to be pushed (is moved only on success).
+             * @return true - if the element has been pushed, false - the queue is full.
+             */
+            bool tryPush(T &value) {
+
+                if (!enqueue(value)) return false;
+
+                notify();
+
+                return true;
+            }
+
+            /**
+             * Pushes the element waiting for free space at most the specified amount of time.
+             *
+             * @param value - element to be pushed (is moved only on success).
+             * @param timeout - maximum waiting time.
+             * @return true - if the element has been pushed, false - timed out.
+             */
+            template<typename Rep, typename Period>
+            bool push(T &value, std::chrono::duration<Rep, Period> timeout) {
+
+                if (tryPush(value)) return true;
+
+                m_numPushWaiters.fetch_add(1);
+
+                bool isPushed;
+
+                {
+                    std::unique_lock<std::mutex> lock(m_pushWaitMutex);
+
+                    isPushed = m_notFull.wait_for(lock, timeout, [this, &value] { return enqueue(value); });
+                }
+
+                m_numPushWaiters.fetch_sub(1);
+
+                // consumers are woken up outside of the lock
+                if (isPushed) notify();
+
+                return isPushed;
+            }
+
+            /**
+             * Pops the element from the front of the queue.
+             *
+             * @param value - popped element.
+             * @return true - if the element has been popped, false - the queue is empty.
+             */
+            bool tryPop(T &value) {
+
+                if (!dequeue(value)) return false;
+
+                notifyPushWaiter();
+
+                return true;
+            }
+
+            /**
+             * Pops the element waiting for it at most the specified amount of time.
+             *
+             * @param value - popped element.
+             * @param timeout - maximum waiting time.
+             * @return true - if the element has been popped, false - timed out.
+             */
+            template<typename Rep, typename Period>
+            bool pop(T &value, std::chrono::duration<Rep, Period> timeout) {
+
+                if (tryPop(value)) return true;
+
+                m_numWaiters.fetch_add(1);
+
+                bool isPopped;
+
+                {
+                    std::unique_lock<std::mutex> lock(m_waitMutex);
+
+                    isPopped = m_notEmpty.wait_for(lock, timeout, [this, &value] { return dequeue(value); });
+                }
+
+                m_numWaiters.fetch_sub(1);
+
+                if (isPopped) notifyPushWaiter();
+
+                return isPopped;
+            }
+
+            /**
+             * Approximate number of elements (exact if no push/pop is in progress).
+             */
+            size_t size() const {
+
+                size_t enqueuePos = m_enqueuePos.load(std::memory_order_acquire);
+                size_t dequeuePos = m_dequeuePos.load(std::memory_order_acquire);
+
+                return enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0;
+            }
+
+            bool empty() const {
+                return size() == 0;
+            }
+
+            size_t capacity() const {
+                return m_capacity;
+            }
+
+        private:
+
+            struct Cell {
+
+                std::atomic<size_t> sequence;
+
+                T value;
+
+                Cell() : sequence(0), value() {}
+            };
+
+            /**
+             * Pushes the element without waking anyone up.
+             */
+            bool enqueue(T &value) {
+
+                size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+
+                Cell *cell;
+
+                while (true) {
+
+                    cell = &m_cells[pos % m_capacity];
+
+                    size_t sequence = cell->sequence.load(std::memory_order_acquire);
+
+                    auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+
+                    if (diff == 0) {
+                        if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                    } else if (diff < 0) {
+                        return false; // full
+                    } else {
+                        pos = m_enqueuePos.load(std::memory_order_relaxed);
+                    }
+                }
+
+                cell->value = std::move(value);
+                cell->sequence.store(pos + 1, std::memory_order_release);
+
+                return true;
+            }
+
+            /**
+             * Pops the element without waking anyone up.
+             */
+            bool dequeue(T &value) {
+
+                size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+
+                Cell *cell;
+
+                while (true) {
+
+                    cell = &m_cells[pos % m_capacity];
+
+                    size_t sequence = cell->sequence.load(std::memory_order_acquire);
+
+                    auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+
+                    if (diff == 0) {
+                        if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                    } else if (diff < 0) {
+                        return false; // empty
+                    } else {
+                        pos = m_dequeuePos.load(std::memory_order_relaxed);
+                    }
+                }
+
+                value = std::move(cell->value);
+                cell->sequence.store(pos + m_capacity, std::memory_order_release);
+
+                return true;
+            }
+
+            /**
+             * Wakes up the waiting consumer (if any).
+             */
+            void notify() {
+
+                // pairs with the waiter's increment: either it sees the element or we see the waiter
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+
+                if (m_numWaiters.load(std::memory_order_relaxed) > 0) {
+                    { std::lock_guard<std::mutex> lock(m_waitMutex); }
+                    m_notEmpty.notify_one();
+                }
+            }
+
+            /**
+             * Wakes up the producer waiting for free space (if any).
+             */
+            void notifyPushWaiter() {
+
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+
+                if (m_numPushWaiters.load(std::memory_order_relaxed) > 0) {
+                    { std::lock_guard<std::mutex> lock(m_pushWaitMutex); }
+                    m_notFull.notify_one();
+                }
+            }
+
+            constexpr static size_t CACHE_LINE_SIZE = 64;
+
+            size_t const m_capacity;
+
+            std::vector<Cell> m_cells;
+
+            // producers and consumers work on separate cache lines
+            // (padding instead of alignas, over-aligned types cannot be heap allocated in C++11)
+
+            char m_padding0[CACHE_LINE_SIZE];
+
+            std::atomic<size_t> m_enqueuePos;
+
+            char m_padding1[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+
+            std::atomic<size_t> m_dequeuePos;
+
+            char m_padding2[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+
+            std::atomic<size_t> m_numWaiters;
+
+            std::mutex m_waitMutex;
+
+            std::condition_variable m_notEmpty;
+
+            std::atomic<size_t> m_numPushWaiters;
+
+            std::mutex m_pushWaitMutex;
+
+            std::condition_variable m_notFull;
+        };
+    }
+}
+
+#endif //LIRS_RTSP_VIDEO_SERVER_BOUNDED_QUEUE_HPP
@@ -1,10 +1,13 @@
 #ifndef LIVE_VIDEO_STREAM_UTILS_HPP
 #define LIVE_VIDEO_STREAM_UTILS_HPP
 
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <initializer_list>
 
 #include "config/ConfigFileType.hpp"
+#include "config/params/Configuration.hpp"
 
 namespace lirs {
 
@@ -26,6 +29,98 @@ namespace lirs {
         std::string concatParams(std::initializer_list<size_t> args, std::string delimiter = {}, std::string tail = {});
 
         std::string to_string_with_prefix(size_t val, std::string prefix = {});
+
+        /**
+         * Converts a capture timestamp into the wall clock time (used for presentation times).
+         * Capture devices stamp frames using either monotonic or real time clock, the clock is detected
+         * by the timestamp's closeness to the current time.
+         *
+         * @param timestampUs - capture timestamp in microseconds.
+         * @return wall clock time in microseconds since the Epoch.
+         */
+        int64_t toWallClockUs(int64_t timestampUs);
+
+        /**
+         * Finds the next Annex B start code (0x000001) in the byte stream.
+         * Scans 16 bytes at a time using SSE2 (if available).
+         *
+         * @param begin - beginning of the byte stream.
+         * @param end - end of the byte stream.
+         * @return pointer to the first byte of the start code or end if there is no start code.
+         */
+        uint8_t const *findStartCode(uint8_t const *begin, uint8_t const *end);
+
+        /**
+         * Splits Annex B byte stream into NAL units (start codes and trailing zero bytes are stripped).
+         *
+         * @param data - byte stream (one or several NAL units prefixed with start codes).
+         * @param size - byte stream's size in bytes.
+         * @param onNalUnit - called for each NAL unit with its data and size.
+         */
+        template<typename Callback>
+        void splitNalUnits(uint8_t const *data, size_t size, Callback &&onNalUnit) {
+
+            uint8_t const *end = data + size;
+
+            uint8_t const *nalStart = findStartCode(data, end);
+
+            while (nalStart != end) {
+
+                nalStart += 3; // skip 0x000001
+
+                uint8_t const *nalEnd = findStartCode(nalStart, end);
+
+                uint8_t const *nextStart = nalEnd;
+
+                // the leading zero byte of a 4-byte start code (and trailing zero bytes) do not belong to the NAL
+                while (nalEnd > nalStart && nalEnd[-1] == 0) {
+                    --nalEnd;
+                }
+
+                if (nalEnd > nalStart) {
+                    onNalUnit(nalStart, static_cast<size_t>(nalEnd - nalStart));
+                }
+
+                nalStart = nextStart;
+            }
+        }
+
+        /**
+         * Whether the encoded unit starts a key frame, i.e. decoding can start from it:
+         * - H.264 - SPS or IDR slice;
+         * - H.265 - VPS, SPS or IRAP (IDR, CRA, BLA) slice;
+         * - VP8/VP9 - key frame.
+         *
+         * @param codec - codec of the stream.
+         * @param data - NAL unit (without start code) or VP8/VP9 frame.
+         * @param size - unit's size in bytes.
+         * @return true - if the unit starts a key frame, otherwise - false.
+         */
+        bool isKeyFrameStart(lirs::config::params::VideoCodec codec, uint8_t const *data, size_t size);
+
+        /**
+         * Parses CPU list in the Linux format, e.g. "0-3,8,10-11".
+         *
+         * @param cpuList - CPU list.
+         * @return CPU numbers.
+         */
+        std::vector<uint16_t> parseCpuList(std::string const &cpuList);
+
+        /**
+         * Returns CPUs of the NUMA node (read from sysfs).
+         *
+         * @param numaNode - NUMA node number.
+         * @return CPU numbers or empty if the node is unknown.
+         */
+        std::vector<uint16_t> getNumaNodeCpus(int numaNode);
+
+        /**
+         * Binds the calling thread to the CPUs (threads created by it inherit the affinity).
+         *
+         * @param cpus - CPU numbers.
+         * @return true - if the affinity is set, otherwise - false.
+         */
+        bool setThreadAffinity(std::vector<uint16_t> const &cpus);
     }
 
 }
@@ -4,7 +4,7 @@
 # FFmpeg compilation guides (see https://trac.ffmpeg.org/wiki/CompilationGuide/Ubuntu).
 
 # Building FFmpeg with dependencies (e.g. hardware encoding (vaapi),
-# encoding (libx264, libx265), Video4Linux API backend, etc.
+# encoding (libx264, libx265, libvpx), Video4Linux API backend, etc.
 
 sudo apt-get update -qq && sudo apt-get -y install \
 autoconf \
@@ -85,6 +85,19 @@ PATH="${FFMPEG_BIN_DIR}:$PATH" make -j$(nproc) VERBOSE=1 && \
 make -j$(nproc) install VERBOSE=1 && \
 make -j$(nproc) clean VERBOSE=1
 
+# VP8/VP9 (libvpx) - video codecs (encoding and decoding)
+cd "${FFMPEG_SRC_DIR}"
+
+if [ ! -d ${FFMPEG_SRC_DIR}/libvpx ]; then
+    git clone --depth 1 https://chromium.googlesource.com/webm/libvpx.git
+fi
+
+cd libvpx && \
+PATH="${FFMPEG_BIN_DIR}:$PATH" ./configure --prefix="${FFMPEG_BIN_DIR}" --disable-examples --disable-unit-tests --enable-pic && \
+PATH="${FFMPEG_BIN_DIR}:$PATH" make -j$(nproc) VERBOSE=1 && \
+make -j$(nproc) install VERBOSE=1 && \
+make -j$(nproc) clean VERBOSE=1
+
 # The following section is written to enable 
 # hardware encoding capabilities in FFmpeg (Intel QuickSync)
 
@@ -169,6 +182,7 @@ PATH="${FFMPEG_BIN_DIR}:$PATH" PKG_CONFIG_PATH="${FFMPEG_BIN_DIR}/lib/pkgconfig:
   --cpu=native \
   --enable-libx264 \
   --enable-libx265 \
+  --enable-libvpx \
   --enable-nonfree \
   --enable-libfreetype \
   --disable-ffserver
@@ -0,0 +1,123 @@
+#include "BitrateController.hpp"
+#include "FanoutRTPSink.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace LIRS {
+
+    namespace {
+
+        int64_t nowUs() {
+            return std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    }
+
+    BitrateController::BitrateController(UsageEnvironment &env, Transcoder &transcoder, RtpFanout const &fanout,
+                                         lirs::config::params::AdaptiveBitrateParameters const &params)
+            : env(env), transcoder(transcoder), fanout(fanout), params(params),
+              controllerId(transcoder.addRateController()), targetBitrate(0), lastEvaluationTime{},
+              lastChangeTimeUs(nowUs()), evaluationTask(nullptr) {
+
+        gettimeofday(&lastEvaluationTime, nullptr);
+
+        evaluationTask = env.taskScheduler().scheduleDelayedTask(params.getIntervalMs() * 1000LL, evaluate0, this);
+    }
+
+    BitrateController::~BitrateController() {
+
+        env.taskScheduler().unscheduleDelayedTask(evaluationTask);
+
+        setTargetBitrate(0);
+    }
+
+    uint16_t BitrateController::getTargetBitrate() const {
+        return targetBitrate;
+    }
+
+    void BitrateController::evaluate() {
+
+        evaluationTask = env.taskScheduler().scheduleDelayedTask(params.getIntervalMs() * 1000LL, evaluate0, this);
+
+        timeval evaluationTime{};
+        gettimeofday(&evaluationTime, nullptr);
+
+        auto const &sinks = fanout.getSinks();
+
+        if (sinks.empty()) {
+            setTargetBitrate(0); // the next clients start from the encoder's current bitrate
+            lastEvaluationTime = evaluationTime;
+            return;
+        }
+
+        // the worst of the clients' reports received since the last evaluation
+        double maxLoss = 0;
+        unsigned maxJitterMs = 0;
+        size_t numReports = 0;
+
+        for (auto sink : sinks) {
+
+            RTPTransmissionStatsDB::Iterator statsIter(sink->transmissionStatsDB());
+
+            RTPTransmissionStats *stats;
+
+            while ((stats = statsIter.next()) != nullptr) {
+
+                if (!timercmp(&stats->lastTimeReceived(), &lastEvaluationTime, >)) {
+                    continue;
+                }
+
+                ++numReports;
+
+                // 8-bit fixed point fraction, RTP timestamp units
+                maxLoss = std::max(maxLoss, stats->packetLossRatio() / 256.0);
+                maxJitterMs = std::max(maxJitterMs, stats->jitter() * 1000 / std::max(sink->rtpTimestampFrequency(), 1U));
+            }
+        }
+
+        lastEvaluationTime = evaluationTime;
+
+        auto currentBitrate = targetBitrate > 0 ? targetBitrate : transcoder.getBitrate();
+
+        auto bitrate = std::min(std::max(currentBitrate, params.getMinBitrate()), params.getMaxBitrate());
+
+        auto timeUs = nowUs();
+
+        if (numReports > 0 && maxLoss > params.getLossHigh()) {
+
+            bitrate = static_cast<uint16_t>(bitrate * (1 - DECREASE_FACTOR * maxLoss));
+
+            lastChangeTimeUs = timeUs;
+
+        } else if (numReports > 0 && maxLoss < params.getLossLow()
+                   && (params.getMaxJitterMs() == 0 || maxJitterMs <= static_cast<unsigned>(params.getMaxJitterMs()))
+                   && timeUs - lastChangeTimeUs >= params.getIncreaseHoldMs() * 1000LL) {
+
+            bitrate = static_cast<uint16_t>(std::min<double>(bitrate * INCREASE_FACTOR + 1, params.getMaxBitrate()));
+
+            lastChangeTimeUs = timeUs;
+        }
+
+        bitrate = std::max(bitrate, params.getMinBitrate());
+
+        if (bitrate != targetBitrate) {
+
+            LOG(DEBUG) << transcoder.getConfig().getName() << " target bitrate: " << bitrate << " (kbps), loss "
+                       << maxLoss << ", jitter " << maxJitterMs << " (ms), " << numReports << " report(s)";
+
+            setTargetBitrate(bitrate);
+        }
+    }
+
+    void BitrateController::evaluate0(void *clientData) {
+        ((BitrateController *) clientData)->evaluate();
+    }
+
+    void BitrateController::setTargetBitrate(uint16_t bitrate) {
+
+        targetBitrate = bitrate;
+
+        transcoder.setTargetBitrate(controllerId, bitrate);
+    }
+}
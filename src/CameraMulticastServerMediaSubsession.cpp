@@ -0,0 +1,80 @@
+#include "CameraMulticastServerMediaSubsession.hpp"
+#include "CameraUnicastServerMediaSubsession.hpp"
+
+#include <GroupsockHelper.hh>
+
+#include <sstream>
+
+namespace LIRS {
+
+    CameraMulticastServerMediaSubsession *
+    CameraMulticastServerMediaSubsession::createNew(RTPSink &rtpSink, RTCPInstance *rtcpInstance,
+                                                    Transcoder &transcoder, size_t udpDatagramSize) {
+        return new CameraMulticastServerMediaSubsession(rtpSink, rtcpInstance, transcoder, udpDatagramSize);
+    }
+
+    CameraMulticastServerMediaSubsession::CameraMulticastServerMediaSubsession(RTPSink &rtpSink,
+                                                                               RTCPInstance *rtcpInstance,
+                                                                               Transcoder &transcoder,
+                                                                               size_t udpDatagramSize)
+            : PassiveServerMediaSubsession(rtpSink, rtcpInstance), rtpSink(rtpSink), transcoder(transcoder),
+              udpDatagramSize(udpDatagramSize) {}
+
+    char const *CameraMulticastServerMediaSubsession::sdpLines() {
+
+        if (fSDPLines) {
+            return fSDPLines;
+        }
+
+        Groupsock const &groupsock = rtpSink.groupsockBeingUsed();
+
+        // the codec's sink describes the stream (the same payload type as the multicast sink)
+        struct in_addr dummyAddr{};
+        Groupsock dummyGroupsock(envir(), dummyAddr, 0, 0);
+
+        RTPSink *dummyRTPSink = CameraUnicastServerMediaSubsession::createCodecRTPSink(
+                envir(), &dummyGroupsock, rtpSink.rtpPayloadType(), transcoder, udpDatagramSize);
+
+        char const *auxSDPLine = dummyRTPSink->auxSDPLine();
+        char *rtpmapLine = dummyRTPSink->rtpmapLine();
+        char const *rangeLine = rangeSDPLine();
+
+        AddressString groupAddressStr(groupsock.groupAddress());
+
+        std::ostringstream sdp;
+
+        sdp << "m=" << dummyRTPSink->sdpMediaType() << " " << ntohs(groupsock.port().num()) << " RTP/AVP "
+            << static_cast<int>(rtpSink.rtpPayloadType()) << "\r\n"
+            << "c=IN IP4 " << groupAddressStr.val() << "/" << static_cast<int>(groupsock.ttl()) << "\r\n"
+            << "b=AS:" << transcoder.getConfig().getEncoderParams().getBitrate() << "\r\n"
+            << rtpmapLine
+            << (rtcpIsMuxed() ? "a=rtcp-mux\r\n" : "")
+            << rangeLine
+            << (auxSDPLine ? auxSDPLine : "")
+            << "a=control:" << trackId() << "\r\n";
+
+        delete[] rangeLine;
+        delete[] rtpmapLine;
+
+        Medium::close(dummyRTPSink);
+
+        fSDPLines = strDup(sdp.str().c_str());
+
+        return fSDPLines;
+    }
+
+    void CameraMulticastServerMediaSubsession::startStream(unsigned clientSessionId, void *streamToken,
+                                                           TaskFunc *rtcpRRHandler, void *rtcpRRHandlerClientData,
+                                                           unsigned short &rtpSeqNum, unsigned &rtpTimestamp,
+                                                           ServerRequestAlternativeByteHandler *serverRequestAlternativeByteHandler,
+                                                           void *serverRequestAlternativeByteHandlerClientData) {
+
+        // the joining client starts decoding from the key frame instead of waiting for the next one
+        transcoder.requestKeyFrame();
+
+        PassiveServerMediaSubsession::startStream(clientSessionId, streamToken, rtcpRRHandler,
+                                                  rtcpRRHandlerClientData, rtpSeqNum, rtpTimestamp,
+                                                  serverRequestAlternativeByteHandler,
+                                                  serverRequestAlternativeByteHandlerClientData);
+    }
+}
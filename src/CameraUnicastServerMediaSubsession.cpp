@@ -1,40 +1,211 @@
 #include <CameraUnicastServerMediaSubsession.hpp>
+#include <GopPrimingFilter.hpp>
+
+#include <sstream>
 
 namespace LIRS {
 
     CameraUnicastServerMediaSubsession *
     CameraUnicastServerMediaSubsession::createNew(UsageEnvironment &env, StreamReplicator *replicator,
-                                                  size_t estBitrate, size_t udpDatagramSize) {
-        return new CameraUnicastServerMediaSubsession(env, replicator, estBitrate, udpDatagramSize);
+                                                  Transcoder &transcoder, size_t udpDatagramSize,
+                                                  GopCache const *gopCache) {
+        return new CameraUnicastServerMediaSubsession(env, replicator, nullptr, transcoder, udpDatagramSize, gopCache);
+    }
+
+    CameraUnicastServerMediaSubsession *
+    CameraUnicastServerMediaSubsession::createNew(UsageEnvironment &env, RtpFanout *fanout, Transcoder &transcoder,
+                                                  size_t udpDatagramSize) {
+        // the fan-out primes the clients on its own
+        return new CameraUnicastServerMediaSubsession(env, nullptr, fanout, transcoder, udpDatagramSize, nullptr);
     }
 
     CameraUnicastServerMediaSubsession::CameraUnicastServerMediaSubsession(UsageEnvironment &env,
                                                                            StreamReplicator *replicator,
-                                                                           size_t estBitrate,
-                                                                           size_t udpDatagramSize)
-            : OnDemandServerMediaSubsession(env, False), replicator(replicator), estBitrate(estBitrate),
-              udpDatagramSize(udpDatagramSize) {
+                                                                           RtpFanout *fanout,
+                                                                           Transcoder &transcoder,
+                                                                           size_t udpDatagramSize,
+                                                                           GopCache const *gopCache)
+            : OnDemandServerMediaSubsession(env, False), replicator(replicator), fanout(fanout),
+              transcoder(transcoder), codec(transcoder.getCodec()), estBitrate(transcoder.getConfig().getEncoderParams().getBitrate()),
+              udpDatagramSize(udpDatagramSize), gopCache(gopCache) {
 
         LOG(DEBUG) << "Unicast media subsession with UDP datagram size of " << udpDatagramSize
                    << " and estimated bitrate of " << estBitrate << " (kbps) is created";
     }
 
+    char const *CameraUnicastServerMediaSubsession::sdpLines() {
+
+        if (fSDPLines || !isDescribable(transcoder)) {
+            return OnDemandServerMediaSubsession::sdpLines();
+        }
+
+        // the sink knows the parameter sets, so the 'a=fmtp' line is generated without any source
+        struct in_addr dummyAddr{};
+        Groupsock *dummyGroupsock = createGroupsock(dummyAddr, 0);
+
+        auto rtpPayloadType = static_cast<unsigned char>(96 + trackNumber() - 1);
+
+        RTPSink *dummyRTPSink = createCodecRTPSink(envir(), dummyGroupsock, rtpPayloadType, transcoder,
+                                                   udpDatagramSize);
+
+        char const *auxSDPLine = dummyRTPSink->auxSDPLine();
+        char *rtpmapLine = dummyRTPSink->rtpmapLine();
+        char const *rangeLine = rangeSDPLine();
+
+        AddressString ipAddressStr(fServerAddressForSDP);
+
+        bool isRetransmissionEnabled = fanout && fanout->getRetransmissionHistorySize() > 0;
+        bool isRtxEnabled = isRetransmissionEnabled && fanout->isRtxEnabled();
+
+        auto rtxPayloadType = FanoutRTPSink::getRtxPayloadType(rtpPayloadType);
+
+        std::ostringstream sdp;
+
+        sdp << "m=" << dummyRTPSink->sdpMediaType() << " " << fPortNumForSDP << " RTP/AVP "
+            << static_cast<int>(rtpPayloadType);
+
+        if (isRtxEnabled) {
+            sdp << " " << static_cast<int>(rtxPayloadType);
+        }
+
+        sdp << "\r\n"
+            << "c=IN IP4 " << ipAddressStr.val() << "\r\n"
+            << "b=AS:" << estBitrate << "\r\n"
+            << rtpmapLine
+            << rangeLine
+            << (auxSDPLine ? auxSDPLine : "");
+
+        // the lost packets are reported by generic NACKs (RFC 4585) and resent (as is or in the RTX stream)
+        if (isRetransmissionEnabled) {
+            sdp << "a=rtcp-fb:" << static_cast<int>(rtpPayloadType) << " nack\r\n";
+        }
+
+        if (isRtxEnabled) {
+            sdp << "a=rtpmap:" << static_cast<int>(rtxPayloadType) << " rtx/" << dummyRTPSink->rtpTimestampFrequency()
+                << "\r\n"
+                << "a=fmtp:" << static_cast<int>(rtxPayloadType) << " apt=" << static_cast<int>(rtpPayloadType)
+                << "\r\n";
+        }
+
+        sdp << "a=control:" << trackId() << "\r\n";
+
+        delete[] rangeLine;
+        delete[] rtpmapLine;
+
+        Medium::close(dummyRTPSink);
+        delete dummyGroupsock;
+
+        fSDPLines = strDup(sdp.str().c_str());
+
+        return fSDPLines;
+    }
+
+    bool CameraUnicastServerMediaSubsession::isDescribable(Transcoder const &transcoder) {
+
+        auto const &parameterSets = transcoder.getParameterSets();
+
+        switch (transcoder.getCodec()) {
+            case lirs::config::params::VideoCodec::H264:
+                return !parameterSets.sps.empty() && !parameterSets.pps.empty();
+            case lirs::config::params::VideoCodec::H265:
+                return !parameterSets.vps.empty() && !parameterSets.sps.empty() && !parameterSets.pps.empty();
+            default: // VP8 and VP9 streams have no 'a=fmtp' line
+                return true;
+        }
+    }
+
     FramedSource *
     CameraUnicastServerMediaSubsession::createNewStreamSource(unsigned clientSessionId, unsigned &estBitrate) {
 
         estBitrate = static_cast<unsigned int>(this->estBitrate);
 
+        if (fanout) {
+            return FanoutClientSource::createNew(envir());
+        }
+
         auto source = replicator->createStreamReplica();
 
+        // the client starts with the cached group of pictures instead of waiting for the next key frame
+        if (gopCache && gopCache->isEnabled()) {
+            source = GopPrimingFilter::createNew(envir(), source, *gopCache);
+        }
+
         // only discrete frames are being sent (w/o start code bytes)
-        return H265VideoStreamDiscreteFramer::createNew(envir(), source);
+        switch (codec) {
+            case lirs::config::params::VideoCodec::H264:
+                return H264VideoStreamDiscreteFramer::createNew(envir(), source);
+            case lirs::config::params::VideoCodec::H265:
+                return H265VideoStreamDiscreteFramer::createNew(envir(), source);
+            default: // VP8 and VP9 frames are sent as is
+                return source;
+        }
     }
 
     RTPSink *
     CameraUnicastServerMediaSubsession::createNewRTPSink(Groupsock *rtpGroupsock, unsigned char rtpPayloadTypeIfDynamic,
                                                          FramedSource *inputSource) {
 
-        auto sink = H265VideoRTPSink::createNew(envir(), rtpGroupsock, rtpPayloadTypeIfDynamic);
+        RTPSink *sink;
+
+        if (fanout) {
+            sink = FanoutRTPSink::createNew(envir(), rtpGroupsock, rtpPayloadTypeIfDynamic, *fanout);
+        } else {
+            sink = createCodecRTPSink(envir(), rtpGroupsock, rtpPayloadTypeIfDynamic, transcoder, udpDatagramSize);
+        }
+
+        // a TCP client that fell behind skips the stream until the next key frame, which is requested right away
+        sink->setTCPOverflowHandler(requestKeyFrame0, this);
+
+        return sink;
+    }
+
+    void CameraUnicastServerMediaSubsession::requestKeyFrame0(void *clientData) {
+        ((CameraUnicastServerMediaSubsession *) clientData)->transcoder.requestKeyFrame();
+    }
+
+    RTPSink *
+    CameraUnicastServerMediaSubsession::createCodecRTPSink(UsageEnvironment &env, Groupsock *rtpGroupsock,
+                                                           unsigned char rtpPayloadTypeIfDynamic,
+                                                           Transcoder &transcoder, size_t udpDatagramSize) {
+
+        VideoRTPSink *sink = nullptr;
+
+        auto const &parameterSets = transcoder.getParameterSets();
+
+        bool hasParameterSets = isDescribable(transcoder);
+
+        switch (transcoder.getCodec()) {
+            case lirs::config::params::VideoCodec::H264:
+                if (hasParameterSets) { // the parameter sets are not read from the stream
+                    sink = H264VideoRTPSink::createNew(env, rtpGroupsock, rtpPayloadTypeIfDynamic,
+                                                       parameterSets.sps.data(),
+                                                       static_cast<unsigned>(parameterSets.sps.size()),
+                                                       parameterSets.pps.data(),
+                                                       static_cast<unsigned>(parameterSets.pps.size()));
+                } else {
+                    sink = H264VideoRTPSink::createNew(env, rtpGroupsock, rtpPayloadTypeIfDynamic);
+                }
+                break;
+            case lirs::config::params::VideoCodec::VP8:
+                sink = VP8VideoRTPSink::createNew(env, rtpGroupsock, rtpPayloadTypeIfDynamic);
+                break;
+            case lirs::config::params::VideoCodec::VP9:
+                sink = VP9VideoRTPSink::createNew(env, rtpGroupsock, rtpPayloadTypeIfDynamic);
+                break;
+            default:
+                if (hasParameterSets) {
+                    sink = H265VideoRTPSink::createNew(env, rtpGroupsock, rtpPayloadTypeIfDynamic,
+                                                       parameterSets.vps.data(),
+                                                       static_cast<unsigned>(parameterSets.vps.size()),
+                                                       parameterSets.sps.data(),
+                                                       static_cast<unsigned>(parameterSets.sps.size()),
+                                                       parameterSets.pps.data(),
+                                                       static_cast<unsigned>(parameterSets.pps.size()));
+                } else {
+                    sink = H265VideoRTPSink::createNew(env, rtpGroupsock, rtpPayloadTypeIfDynamic);
+                }
+                break;
+        }
 
         // set the UDP datagram size
         sink->setPacketSizes(static_cast<unsigned int>(udpDatagramSize), static_cast<unsigned int>(udpDatagramSize));
@@ -42,6 +213,36 @@ namespace LIRS {
         return sink;
     }
 
-}
+    RTCPInstance *CameraUnicastServerMediaSubsession::createRTCP(Groupsock *RTCPgs, unsigned totSessionBW,
+                                                                 unsigned char const *cname, RTPSink *sink) {
+
+        auto rtcpInstance = OnDemandServerMediaSubsession::createRTCP(RTCPgs, totSessionBW, cname, sink);
+
+        // the fan-out's clients have FanoutRTPSink sinks (see createNewRTPSink)
+        if (rtcpInstance && sink && fanout && fanout->getRetransmissionHistorySize() > 0) {
+
+            auto fanoutSink = static_cast<FanoutRTPSink *>(sink);
+
+            fanoutSink->enableRetransmission();
 
+            rtcpInstance->setGenericNACKHandler(FanoutRTPSink::handleGenericNACK0, fanoutSink);
+        }
 
+        return rtcpInstance;
+    }
+
+    void CameraUnicastServerMediaSubsession::startStream(unsigned clientSessionId, void *streamToken,
+                                                         TaskFunc *rtcpRRHandler, void *rtcpRRHandlerClientData,
+                                                         unsigned short &rtpSeqNum, unsigned &rtpTimestamp,
+                                                         ServerRequestAlternativeByteHandler *serverRequestAlternativeByteHandler,
+                                                         void *serverRequestAlternativeByteHandlerClientData) {
+
+        // the client starts decoding from the key frame instead of waiting for the next one
+        transcoder.requestKeyFrame();
+
+        OnDemandServerMediaSubsession::startStream(clientSessionId, streamToken, rtcpRRHandler, rtcpRRHandlerClientData,
+                                                   rtpSeqNum, rtpTimestamp, serverRequestAlternativeByteHandler,
+                                                   serverRequestAlternativeByteHandlerClientData);
+    }
+
+}
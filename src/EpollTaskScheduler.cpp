@@ -0,0 +1,201 @@
+#include "EpollTaskScheduler.hpp"
+#include "utils/Logger.hpp"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace LIRS {
+
+    namespace {
+
+        /**
+         * Max time to wait for the events in milliseconds (the delay queue's "eternity" does not fit epoll's timeout).
+         */
+        constexpr int64_t MAX_TIMEOUT_MS = 1000000000;
+    }
+
+    EpollTaskScheduler *EpollTaskScheduler::createNew() {
+
+        int epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+        if (epollFd < 0) {
+            LOG(ERROR) << "Failed to create epoll instance: " << strerror(errno);
+            return nullptr;
+        }
+
+        int eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if (eventFd < 0) {
+            LOG(ERROR) << "Failed to create eventfd: " << strerror(errno);
+            close(epollFd);
+            return nullptr;
+        }
+
+        return new EpollTaskScheduler(epollFd, eventFd);
+    }
+
+    EpollTaskScheduler::EpollTaskScheduler(int epollFd, int eventFd) : epollFd(epollFd), eventTriggers(eventFd) {
+        updateEpollEvents(eventFd, EPOLLIN);
+    }
+
+    EpollTaskScheduler::~EpollTaskScheduler() {
+        close(epollFd);
+    }
+
+    EventTriggerRegistry &EpollTaskScheduler::getEventTriggerRegistry() {
+        return eventTriggers;
+    }
+
+    uint32_t EpollTaskScheduler::toEpollEvents(int conditionSet) {
+
+        uint32_t epollEvents = 0;
+
+        if (conditionSet & SOCKET_READABLE) epollEvents |= EPOLLIN;
+        if (conditionSet & SOCKET_WRITABLE) epollEvents |= EPOLLOUT;
+        if (conditionSet & SOCKET_EXCEPTION) epollEvents |= EPOLLPRI;
+
+        return epollEvents;
+    }
+
+    void EpollTaskScheduler::updateEpollEvents(int socketNum, uint32_t epollEvents) {
+
+        if (epollEvents == 0) {
+            // the socket may be closed already (removed from epoll along with it)
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, socketNum, nullptr);
+            return;
+        }
+
+        epoll_event event{};
+        event.events = epollEvents;
+        event.data.fd = socketNum;
+
+        // the socket number may be reused after the previous socket is closed without turning its handling off
+        if (epoll_ctl(epollFd, EPOLL_CTL_MOD, socketNum, &event) == 0) {
+            return;
+        }
+
+        if (errno != ENOENT || epoll_ctl(epollFd, EPOLL_CTL_ADD, socketNum, &event) != 0) {
+            LOG(ERROR) << "Failed to register socket " << socketNum << " with epoll: " << strerror(errno);
+        }
+    }
+
+    void EpollTaskScheduler::setBackgroundHandling(int socketNum, int conditionSet, BackgroundHandlerProc *handlerProc,
+                                                   void *clientData) {
+        if (socketNum < 0) {
+            return;
+        }
+
+        if (conditionSet == 0) {
+            handlers.erase(socketNum);
+            updateEpollEvents(socketNum, 0);
+            return;
+        }
+
+        handlers[socketNum] = Handler{conditionSet, handlerProc, clientData};
+
+        updateEpollEvents(socketNum, toEpollEvents(conditionSet));
+    }
+
+    void EpollTaskScheduler::moveSocketHandling(int oldSocketNum, int newSocketNum) {
+
+        if (oldSocketNum < 0 || newSocketNum < 0) {
+            return;
+        }
+
+        auto it = handlers.find(oldSocketNum);
+
+        if (it == handlers.end()) {
+            return;
+        }
+
+        auto handler = it->second;
+
+        handlers.erase(it);
+        updateEpollEvents(oldSocketNum, 0);
+
+        handlers[newSocketNum] = handler;
+        updateEpollEvents(newSocketNum, toEpollEvents(handler.conditionSet));
+    }
+
+    EventTriggerId EpollTaskScheduler::createEventTrigger(TaskFunc *eventHandlerProc) {
+        return eventTriggers.create(eventHandlerProc);
+    }
+
+    void EpollTaskScheduler::deleteEventTrigger(EventTriggerId eventTriggerId) {
+        eventTriggers.remove(eventTriggerId);
+    }
+
+    void EpollTaskScheduler::triggerEvent(EventTriggerId eventTriggerId, void *clientData) {
+        eventTriggers.trigger(eventTriggerId, clientData);
+    }
+
+    void EpollTaskScheduler::SingleStep(unsigned maxDelayTime) {
+
+        DelayInterval const &timeToDelay = fDelayQueue.timeToNextAlarm();
+
+        // rounded up, so the loop does not spin until the alarm is due
+        int64_t timeoutMs = static_cast<int64_t>(timeToDelay.seconds()) * 1000 + (timeToDelay.useconds() + 999) / 1000;
+
+        if (maxDelayTime > 0 && timeoutMs > (maxDelayTime + 999) / 1000) {
+            timeoutMs = (maxDelayTime + 999) / 1000;
+        }
+
+        if (timeoutMs > MAX_TIMEOUT_MS) {
+            timeoutMs = MAX_TIMEOUT_MS;
+        }
+
+        // local, the handlers may run the event loop reentrantly
+        epoll_event events[MAX_NUM_EVENTS];
+
+        int numEvents = epoll_wait(epollFd, events, MAX_NUM_EVENTS, static_cast<int>(timeoutMs));
+
+        if (numEvents < 0) {
+            if (errno != EINTR) {
+                LOG(ERROR) << "Failed to wait for the socket events: " << strerror(errno);
+                internalError();
+            }
+            numEvents = 0;
+        }
+
+        for (int idx = 0; idx < numEvents; ++idx) {
+
+            int socketNum = events[idx].data.fd;
+
+            if (socketNum == eventTriggers.getEventFd()) {
+                eventTriggers.acknowledgeWakeup(); // the triggers are handled below
+                continue;
+            }
+
+            // looked up again, the previous handlers may have turned the socket's handling off
+            auto it = handlers.find(socketNum);
+
+            if (it == handlers.end()) {
+                continue;
+            }
+
+            auto const &handler = it->second;
+
+            int resultConditionSet = 0;
+
+            // select() reports the hangups and errors as readability
+            if (events[idx].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) resultConditionSet |= SOCKET_READABLE;
+            if (events[idx].events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) resultConditionSet |= SOCKET_WRITABLE;
+            if (events[idx].events & EPOLLPRI) resultConditionSet |= SOCKET_EXCEPTION;
+
+            resultConditionSet &= handler.conditionSet;
+
+            if (resultConditionSet != 0 && handler.handlerProc != nullptr) {
+                fLastHandledSocketNum = socketNum;
+                (*handler.handlerProc)(handler.clientData, resultConditionSet);
+            }
+        }
+
+        // after the socket handlers, the triggered handlers may modify the set of sockets
+        eventTriggers.handlePending();
+
+        fDelayQueue.handleAlarm();
+    }
+}
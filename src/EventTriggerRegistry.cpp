@@ -0,0 +1,190 @@
+#include "EventTriggerRegistry.hpp"
+#include "utils/Logger.hpp"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace LIRS {
+
+    EventTriggerRegistry::EventTriggerRegistry(int eventFd) : eventFd(eventFd), pendingHead(nullptr), numUsedIds(0) {
+        for (auto &chunk : chunks) {
+            chunk.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    EventTriggerRegistry::~EventTriggerRegistry() {
+
+        for (auto &chunk : chunks) {
+            delete[] chunk.load(std::memory_order_relaxed);
+        }
+
+        close(eventFd);
+    }
+
+    EventTriggerRegistry::Trigger *EventTriggerRegistry::find(EventTriggerId triggerId) const {
+
+        if (triggerId == 0 || triggerId > MAX_NUM_TRIGGERS) {
+            return nullptr;
+        }
+
+        size_t index = triggerId - 1;
+
+        Trigger *chunk = chunks[index / CHUNK_SIZE].load(std::memory_order_acquire);
+
+        return chunk ? &chunk[index % CHUNK_SIZE] : nullptr;
+    }
+
+    EventTriggerId EventTriggerRegistry::create(TaskFunc *handler, size_t maxNumPayloads) {
+
+        EventTriggerId triggerId;
+
+        if (!freeIds.empty()) {
+
+            triggerId = freeIds.back();
+            freeIds.pop_back();
+
+        } else {
+
+            if (numUsedIds == MAX_NUM_TRIGGERS) {
+                LOG(ERROR) << "Failed to create event trigger: too many triggers (" << MAX_NUM_TRIGGERS << ")";
+                return 0;
+            }
+
+            if (numUsedIds % CHUNK_SIZE == 0) {
+                chunks[numUsedIds / CHUNK_SIZE].store(new Trigger[CHUNK_SIZE], std::memory_order_release);
+            }
+
+            triggerId = static_cast<EventTriggerId>(++numUsedIds);
+        }
+
+        Trigger *trigger = find(triggerId);
+
+        trigger->id = triggerId;
+        trigger->handler = handler;
+        trigger->clientData.store(nullptr, std::memory_order_relaxed);
+
+        if (maxNumPayloads > 0) {
+            trigger->payloads.reset(new lirs::utils::BoundedQueue<void *>(maxNumPayloads));
+        }
+
+        return triggerId;
+    }
+
+    void EventTriggerRegistry::remove(EventTriggerId triggerId) {
+
+        Trigger *trigger = find(triggerId);
+
+        if (!trigger || !trigger->handler) {
+            return;
+        }
+
+        trigger->handler = nullptr;
+        trigger->payloads.reset();
+
+        if (trigger->isPending.load(std::memory_order_acquire)) {
+            trigger->isRetired = true; // skipped on the pending list, the id is reused afterwards
+            return;
+        }
+
+        freeIds.push_back(triggerId);
+    }
+
+    void EventTriggerRegistry::trigger(EventTriggerId triggerId, void *clientData) {
+
+        Trigger *trigger = find(triggerId);
+
+        if (!trigger) {
+            return;
+        }
+
+        trigger->clientData.store(clientData, std::memory_order_relaxed);
+
+        if (trigger->isPending.exchange(true, std::memory_order_acq_rel)) {
+            return; // coalesced with the pending one
+        }
+
+        Trigger *head = pendingHead.load(std::memory_order_relaxed);
+
+        do {
+            trigger->nextPending = head;
+        } while (!pendingHead.compare_exchange_weak(head, trigger, std::memory_order_release,
+                                                    std::memory_order_relaxed));
+
+        if (head != nullptr) {
+            return; // the event loop is woken up by the first pending trigger
+        }
+
+        uint64_t one = 1;
+
+        if (write(eventFd, &one, sizeof one) < 0 && errno != EAGAIN) {
+            LOG(ERROR) << "Failed to wake the event loop up: " << strerror(errno);
+        }
+    }
+
+    bool EventTriggerRegistry::post(EventTriggerId triggerId, void *payload, void *clientData) {
+
+        Trigger *trigger = find(triggerId);
+
+        if (!trigger || !trigger->payloads || !trigger->payloads->tryPush(payload)) {
+            return false;
+        }
+
+        this->trigger(triggerId, clientData);
+
+        return true;
+    }
+
+    bool EventTriggerRegistry::takePayload(EventTriggerId triggerId, void *&payload) {
+
+        Trigger *trigger = find(triggerId);
+
+        return trigger && trigger->payloads && trigger->payloads->tryPop(payload);
+    }
+
+    void EventTriggerRegistry::handlePending() {
+
+        Trigger *pending = pendingHead.exchange(nullptr, std::memory_order_acquire);
+
+        // reversed, so the triggers are handled in the order they were fired
+        Trigger *ordered = nullptr;
+
+        while (pending) {
+            Trigger *next = pending->nextPending;
+            pending->nextPending = ordered;
+            ordered = pending;
+            pending = next;
+        }
+
+        while (ordered) {
+
+            Trigger *trigger = ordered;
+
+            ordered = trigger->nextPending;
+
+            // fired again while (or after) being handled - handled again in the next step
+            trigger->isPending.store(false, std::memory_order_seq_cst);
+
+            if (trigger->handler) {
+                (*trigger->handler)(trigger->clientData.load(std::memory_order_relaxed));
+            } else if (trigger->isRetired) {
+                trigger->isRetired = false;
+                freeIds.push_back(trigger->id);
+            }
+        }
+    }
+
+    int EventTriggerRegistry::getEventFd() const {
+        return eventFd;
+    }
+
+    void EventTriggerRegistry::acknowledgeWakeup() {
+
+        uint64_t counter;
+
+        if (read(eventFd, &counter, sizeof counter) < 0 && errno != EAGAIN) {
+            LOG(ERROR) << "Failed to read eventfd: " << strerror(errno);
+        }
+    }
+}
@@ -0,0 +1,245 @@
+#include "FanoutRTPSink.hpp"
+#include "utils/Logger.hpp"
+
+#include <GroupsockHelper.hh>
+
+#include <cstring>
+
+namespace LIRS {
+
+    FanoutRTPSink *FanoutRTPSink::createNew(UsageEnvironment &env, Groupsock *rtpGroupsock,
+                                            unsigned char rtpPayloadType, RtpFanout &fanout) {
+        return new FanoutRTPSink(env, rtpGroupsock, rtpPayloadType, fanout);
+    }
+
+    FanoutRTPSink::FanoutRTPSink(UsageEnvironment &env, Groupsock *rtpGroupsock, unsigned char rtpPayloadType,
+                                 RtpFanout &fanout)
+            : RTPSink(env, rtpGroupsock, rtpPayloadType, 90000, fanout.getRtpPayloadFormatName(), 1),
+              fanout(fanout), isAttached(false), isRtxEnabled(fanout.isRtxEnabled()), rtxSSRC(0), rtxSeqNo(0),
+              numLostPackets(0), numRetransmittedPackets(0) {
+
+        if (fanout.getPacingWindowUs() > 0) {
+            pacer.reset(new RtpPacer(env, fanout.getPacingWindowUs(), fanout.getPacingBucketSize(),
+                                     [this](std::vector<std::shared_ptr<RtpPacket>> const &packets) {
+                                         transmit(packets);
+                                     }));
+        }
+    }
+
+    FanoutRTPSink::~FanoutRTPSink() {
+
+        if (isAttached) {
+            fanout.detach(this);
+        }
+
+        if (pacer) {
+            LOG(DEBUG) << "Client's pacer delayed " << pacer->getNumDelayedPackets()
+                       << " packets, max queue depth: " << pacer->getMaxQueueBytes() << " (bytes)";
+        }
+
+        if (history) {
+            LOG(DEBUG) << "Client reported " << numLostPackets << " lost packets, " << numRetransmittedPackets
+                       << " of them were resent";
+        }
+    }
+
+    RtpPacer const *FanoutRTPSink::getPacer() const {
+        return pacer.get();
+    }
+
+    void FanoutRTPSink::enableRetransmission() {
+
+        if (history || fanout.getRetransmissionHistorySize() == 0) {
+            return;
+        }
+
+        history.reset(new RtpPacketHistory(fanout.getRetransmissionHistorySize()));
+
+        do {
+            rtxSSRC = our_random32();
+        } while (rtxSSRC == SSRC());
+
+        rtxSeqNo = static_cast<u_int16_t>(our_random());
+    }
+
+    void FanoutRTPSink::handleGenericNACK0(void *clientData, u_int32_t mediaSSRC, u_int16_t packetID,
+                                           u_int16_t bitmaskOfLostPackets) {
+        ((FanoutRTPSink *) clientData)->handleGenericNACK(mediaSSRC, packetID, bitmaskOfLostPackets);
+    }
+
+    unsigned char FanoutRTPSink::getRtxPayloadType(unsigned char rtpPayloadType) {
+        return static_cast<unsigned char>(rtpPayloadType + 1); // the next dynamic payload type (single track)
+    }
+
+    char const *FanoutRTPSink::sdpMediaType() const {
+        return "video";
+    }
+
+    Boolean FanoutRTPSink::continuePlaying() {
+
+        if (!isAttached) {
+            isAttached = true;
+            fanout.attach(this);
+        }
+
+        return True;
+    }
+
+    void FanoutRTPSink::stopPlaying() {
+
+        if (isAttached) {
+            isAttached = false;
+            fanout.detach(this);
+        }
+
+        if (pacer) {
+            pacer->clear(); // the packets would be sent to nobody
+        }
+
+        if (history) {
+            history->clear();
+        }
+
+        RTPSink::stopPlaying();
+    }
+
+    void FanoutRTPSink::send(std::vector<std::shared_ptr<RtpPacket>> const &packets) {
+
+        if (pacer) {
+            pacer->enqueue(packets);
+            return;
+        }
+
+        transmit(packets);
+    }
+
+    void FanoutRTPSink::transmit(std::vector<std::shared_ptr<RtpPacket>> const &packets) {
+
+        packetData.clear();
+        packetSizes.clear();
+        syncPoints.clear();
+
+        // the packets are sent right away, so the other clients' header fields are overwritten afterwards
+        for (auto const &packet : packets) {
+
+            writeHeader(packet);
+
+            packetData.push_back(packet->data.data());
+            packetSizes.push_back(static_cast<unsigned int>(packet->data.size()));
+            syncPoints.push_back(packet->isSyncPoint ? True : False);
+        }
+
+        // UDP GSO or sendmmsg where available (a frame's packets in a few system calls),
+        // a TCP client that fell behind skips the packets until the next key frame
+        fRTPInterface.sendPackets(packetData.data(), packetSizes.data(), static_cast<unsigned int>(packetData.size()),
+                                  syncPoints.data());
+    }
+
+    void FanoutRTPSink::writeHeader(std::shared_ptr<RtpPacket> const &packet) {
+
+        auto timestamp = convertToRTPTimestamp(packet->presentationTime);
+
+        fillHeader(packet->data.data(), packet->isMarked, fRTPPayloadType, fSeqNo, timestamp, SSRC());
+
+        if (history) {
+            history->add(fSeqNo, timestamp, packet);
+        }
+
+        auto packetSize = static_cast<unsigned int>(packet->data.size());
+
+        // RTCP SR statistics (see MultiFramedRTPSink)
+        ++fPacketCount;
+        fTotalOctetCount += packetSize;
+        fOctetCount += packetSize - RtpPacket::HEADER_SIZE;
+
+        ++fSeqNo;
+
+        fCurrentTimestamp = timestamp;
+
+        fMostRecentPresentationTime = packet->presentationTime;
+
+        if (fInitialPresentationTime.tv_sec == 0 && fInitialPresentationTime.tv_usec == 0) {
+            fInitialPresentationTime = packet->presentationTime;
+        }
+    }
+
+    void FanoutRTPSink::handleGenericNACK(u_int32_t mediaSSRC, u_int16_t packetID, u_int16_t bitmaskOfLostPackets) {
+
+        if (!history || mediaSSRC != SSRC()) {
+            return;
+        }
+
+        // the packet ID and the following packets marked in the bitmask
+        for (int idx = -1; idx < 16; ++idx) {
+
+            if (idx >= 0 && !(bitmaskOfLostPackets & (1 << idx))) {
+                continue;
+            }
+
+            ++numLostPackets;
+
+            auto entry = history->find(static_cast<u_int16_t>(packetID + idx + 1));
+
+            if (entry) {
+                retransmit(*entry);
+                ++numRetransmittedPackets;
+            }
+        }
+    }
+
+    void FanoutRTPSink::retransmit(RtpPacketHistory::Entry const &entry) {
+
+        auto &packet = *entry.packet;
+
+        if (!isRtxEnabled) {
+
+            // the shared header holds the fields of the client the packet was sent to last
+            fillHeader(packet.data.data(), packet.isMarked, fRTPPayloadType, entry.seqNo, entry.timestamp, SSRC());
+
+            fRTPInterface.sendPacket(packet.data.data(), static_cast<unsigned int>(packet.data.size()));
+
+            return;
+        }
+
+        // RTX payload: the original sequence number followed by the original payload (RFC 4588, section 4)
+        rtxPacket.resize(packet.data.size() + 2);
+
+        fillHeader(rtxPacket.data(), packet.isMarked, getRtxPayloadType(fRTPPayloadType), rtxSeqNo++, entry.timestamp,
+                   rtxSSRC);
+
+        rtxPacket[RtpPacket::HEADER_SIZE] = static_cast<uint8_t>(entry.seqNo >> 8);
+        rtxPacket[RtpPacket::HEADER_SIZE + 1] = static_cast<uint8_t>(entry.seqNo);
+
+        memcpy(rtxPacket.data() + RtpPacket::HEADER_SIZE + 2, packet.data.data() + RtpPacket::HEADER_SIZE,
+               packet.data.size() - RtpPacket::HEADER_SIZE);
+
+        fRTPInterface.sendPacket(rtxPacket.data(), static_cast<unsigned int>(rtxPacket.size()));
+    }
+
+    void FanoutRTPSink::fillHeader(uint8_t *header, bool isMarked, unsigned char payloadType, u_int16_t seqNo,
+                                   u_int32_t timestamp, u_int32_t ssrc) {
+
+        header[0] = 0x80; // version 2, no padding, extension and CSRCs
+        header[1] = static_cast<uint8_t>((isMarked ? 0x80 : 0x00) | payloadType);
+        header[2] = static_cast<uint8_t>(seqNo >> 8);
+        header[3] = static_cast<uint8_t>(seqNo);
+        header[4] = static_cast<uint8_t>(timestamp >> 24);
+        header[5] = static_cast<uint8_t>(timestamp >> 16);
+        header[6] = static_cast<uint8_t>(timestamp >> 8);
+        header[7] = static_cast<uint8_t>(timestamp);
+        header[8] = static_cast<uint8_t>(ssrc >> 24);
+        header[9] = static_cast<uint8_t>(ssrc >> 16);
+        header[10] = static_cast<uint8_t>(ssrc >> 8);
+        header[11] = static_cast<uint8_t>(ssrc);
+    }
+
+    FanoutClientSource *FanoutClientSource::createNew(UsageEnvironment &env) {
+        return new FanoutClientSource(env);
+    }
+
+    FanoutClientSource::FanoutClientSource(UsageEnvironment &env) : FramedSource(env) {}
+
+    void FanoutClientSource::doGetNextFrame() {
+        // never read, the client's sink is fed by the fan-out
+    }
+}
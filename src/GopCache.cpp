@@ -0,0 +1,71 @@
+#include "GopCache.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Utils.hpp"
+
+namespace LIRS {
+
+    GopCache::GopCache(lirs::config::params::VideoCodec codec, size_t maxSize)
+            : codec(codec), maxSize(maxSize), generation(0), isOverflown(false) {}
+
+    void GopCache::add(NalUnit const &data, timeval presentationTime) {
+
+        if (!isEnabled()) {
+            return;
+        }
+
+        bool isKeyFrameStart = lirs::utils::isKeyFrameStart(codec, data.data(), data.size());
+
+        // the key frame's parameter sets and slices belong to the same frame
+        bool isNewKeyFrame = isKeyFrameStart && (units.empty() || isOverflown
+                                                 || units.front().presentationTime.tv_sec != presentationTime.tv_sec
+                                                 || units.front().presentationTime.tv_usec != presentationTime.tv_usec);
+
+        if (isNewKeyFrame) {
+            clear();
+        } else if (units.empty() || isOverflown) {
+            return; // waiting for the key frame
+        }
+
+        if (units.size() == maxSize) {
+
+            LOG(WARN) << "Group of pictures exceeds the cache size of " << maxSize
+                      << " units, it is not cached (decrease the key frame interval)";
+
+            clear();
+
+            isOverflown = true;
+
+            return;
+        }
+
+        units.push_back({data, presentationTime});
+    }
+
+    void GopCache::clear() {
+
+        if (!units.empty()) {
+            ++generation;
+        }
+
+        units.clear();
+
+        isOverflown = false;
+    }
+
+    timeval GopCache::toPrimedTime(timeval presentationTime, int64_t referenceTimeUs) {
+
+        auto timeUs = static_cast<int64_t>(presentationTime.tv_sec) * 1000000 + presentationTime.tv_usec;
+
+        if (timeUs >= referenceTimeUs) {
+            return presentationTime;
+        }
+
+        timeUs = referenceTimeUs - (referenceTimeUs - timeUs) / PRIMED_TIME_SCALE;
+
+        timeval primedTime{};
+        primedTime.tv_sec = static_cast<time_t>(timeUs / 1000000);
+        primedTime.tv_usec = static_cast<suseconds_t>(timeUs % 1000000);
+
+        return primedTime;
+    }
+}
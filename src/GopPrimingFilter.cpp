@@ -0,0 +1,152 @@
+#include "GopPrimingFilter.hpp"
+#include "utils/Logger.hpp"
+
+namespace LIRS {
+
+    namespace {
+
+        int64_t toMicroseconds(timeval time) {
+            return static_cast<int64_t>(time.tv_sec) * 1000000 + time.tv_usec;
+        }
+
+        bool isSameTime(timeval lhs, timeval rhs) {
+            return lhs.tv_sec == rhs.tv_sec && lhs.tv_usec == rhs.tv_usec;
+        }
+    }
+
+    GopPrimingFilter *GopPrimingFilter::createNew(UsageEnvironment &env, FramedSource *inputSource,
+                                                  GopCache const &gopCache) {
+        return new GopPrimingFilter(env, inputSource, gopCache);
+    }
+
+    GopPrimingFilter::GopPrimingFilter(UsageEnvironment &env, FramedSource *inputSource, GopCache const &gopCache)
+            : FramedFilter(env, inputSource), gopCache(gopCache), state(State::PRIMING), generation(0), cursor(0),
+              referenceTimeUs(0), lastFrameTime{} {}
+
+    void GopPrimingFilter::doGetNextFrame() {
+
+        if (state == State::PRIMING) {
+            deliverCachedUnit();
+        } else {
+            getNextLiveFrame();
+        }
+    }
+
+    void GopPrimingFilter::doStopGettingFrames() {
+
+        // the client is primed again when it resumes playing
+        state = State::PRIMING;
+        cursor = 0;
+        referenceTimeUs = 0;
+        lastFrameUnits.clear();
+
+        FramedFilter::doStopGettingFrames();
+    }
+
+    void GopPrimingFilter::deliverCachedUnit() {
+
+        if (cursor == 0 || gopCache.getGeneration() != generation) { // (re)started by the key frame
+
+            generation = gopCache.getGeneration();
+
+            cursor = 0;
+
+            if (!gopCache.empty() && referenceTimeUs == 0) {
+                referenceTimeUs = toMicroseconds(gopCache[gopCache.size() - 1].presentationTime);
+            }
+        }
+
+        if (cursor == gopCache.size()) { // caught up with the live stream
+
+            if (cursor > 0) {
+                LOG(DEBUG) << "Client is primed with " << cursor << " cached units";
+            }
+
+            state = cursor == 0 ? State::LIVE : State::JOINING;
+
+            referenceTimeUs = 0;
+
+            getNextLiveFrame();
+
+            return;
+        }
+
+        auto const &unit = gopCache[cursor++];
+
+        if (lastFrameUnits.empty() || !isSameTime(unit.presentationTime, lastFrameTime)) {
+            lastFrameUnits.clear();
+            lastFrameTime = unit.presentationTime;
+        }
+
+        lastFrameUnits.push_back(unit.data);
+
+        if (unit.data.size() > fMaxSize) {
+            fFrameSize = fMaxSize;
+            fNumTruncatedBytes = static_cast<unsigned int>(unit.data.size() - fMaxSize);
+        } else {
+            fFrameSize = static_cast<unsigned int>(unit.data.size());
+            fNumTruncatedBytes = 0;
+        }
+
+        memcpy(fTo, unit.data.data(), fFrameSize);
+
+        fPresentationTime = GopCache::toPrimedTime(unit.presentationTime, referenceTimeUs);
+
+        fDurationInMicroseconds = 0;
+
+        // the cached units are delivered via the event loop (no recursion)
+        nextTask() = envir().taskScheduler().scheduleDelayedTask(0, (TaskFunc *) FramedSource::afterGetting, this);
+    }
+
+    void GopPrimingFilter::getNextLiveFrame() {
+        fInputSource->getNextFrame(fTo, fMaxSize, afterGettingFrame, this, FramedSource::handleClosure, this);
+    }
+
+    bool GopPrimingFilter::isDelivered(unsigned frameSize, timeval presentationTime) const {
+
+        auto timeUs = toMicroseconds(presentationTime);
+        auto lastFrameTimeUs = toMicroseconds(lastFrameTime);
+
+        if (timeUs != lastFrameTimeUs) {
+            return timeUs < lastFrameTimeUs;
+        }
+
+        // the rest of the last cached frame is not cached yet
+        for (auto const &unit : lastFrameUnits) {
+            if (unit.size() == frameSize && memcmp(unit.data(), fTo, frameSize) == 0) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void GopPrimingFilter::afterGettingFrame(void *clientData, unsigned frameSize, unsigned numTruncatedBytes,
+                                             timeval presentationTime, unsigned durationInMicroseconds) {
+        ((GopPrimingFilter *) clientData)->afterGettingFrame(frameSize, numTruncatedBytes, presentationTime,
+                                                             durationInMicroseconds);
+    }
+
+    void GopPrimingFilter::afterGettingFrame(unsigned frameSize, unsigned numTruncatedBytes, timeval presentationTime,
+                                             unsigned durationInMicroseconds) {
+
+        if (state == State::JOINING) {
+
+            if (numTruncatedBytes == 0 && isDelivered(frameSize, presentationTime)) {
+                getNextLiveFrame();
+                return;
+            }
+
+            state = State::LIVE;
+
+            lastFrameUnits.clear();
+        }
+
+        fFrameSize = frameSize;
+        fNumTruncatedBytes = numTruncatedBytes;
+        fPresentationTime = presentationTime;
+        fDurationInMicroseconds = durationInMicroseconds;
+
+        FramedSource::afterGetting(this);
+    }
+}
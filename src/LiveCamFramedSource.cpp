@@ -8,103 +8,250 @@ namespace LIRS {
 
     LiveCamFramedSource::~LiveCamFramedSource() {
 
+        // unblock the encoding thread (if it waits for the queue)
+        isStreaming.store(false);
+
         transcoder.stop();
 
+        envir().taskScheduler().unscheduleDelayedTask(stopStreamingTask);
+        envir().taskScheduler().unscheduleDelayedTask(idleTask);
+
         // delete trigger
         envir().taskScheduler().deleteEventTrigger(eventTriggerId);
         eventTriggerId = 0;
 
-        // cleanup encoded data buffer
-        encodedDataBuffer.clear();
-        encodedDataBuffer.shrink_to_fit();
-
+        // cleanup encoded data queue
+        clearQueue();
     }
 
     LiveCamFramedSource::LiveCamFramedSource(UsageEnvironment &env, Transcoder &transcoder) :
-            FramedSource(env), transcoder(transcoder), eventTriggerId(0), max_nalu_size_bytes(0) {
+            FramedSource(env), transcoder(transcoder), eventTriggerId(0),
+            encodedDataQueue(transcoder.getConfig().getPipelineParams().getNalQueueSize()),
+            overflowPolicy(transcoder.getConfig().getPipelineParams().getOverflowPolicy()),
+            isStreaming(false), isDroppingUntilKeyFrame(false), numDroppedUnits(0), numOverflows(0),
+            gopCache(transcoder.getCodec(), transcoder.getConfig().getPipelineParams().getGopCacheSize()),
+            isStopped(true), stopStreamingTask(nullptr), isTranscoderAcquired(false), idleTask(nullptr),
+            isLastUnitFrameEnd(false), max_nalu_size_bytes(0) {
 
         // create trigger invoking method which will deliver frame
         eventTriggerId = envir().taskScheduler().createEventTrigger(LiveCamFramedSource::deliverFrame0);
 
-        encodedDataBuffer.reserve(5); // reserve enough space for handling incoming encoded data
-
         // set transcoder's callback indicating new encoded data availability
-        transcoder.setOnEncodedDataCallback(std::bind(&LiveCamFramedSource::onEncodedData, this,
-                                                      std::placeholders::_1));
+        transcoder.addOnEncodedDataCallback(std::bind(&LiveCamFramedSource::onEncodedData, this,
+                                                      std::placeholders::_1, std::placeholders::_2));
 
-        // start video data encoding/decoding in a new thread
+        // capturing and encoding start when the first client starts playing (see startStreaming)
+    }
 
-        LOG(DEBUG) << "Starting to capture and encode video from the camera: "
-                   << transcoder.getConfig().getName();
+    uint64_t LiveCamFramedSource::getNumDroppedUnits() const {
+        return numDroppedUnits.load(std::memory_order_relaxed);
+    }
 
-        std::thread([&transcoder]() {
-            transcoder.run();
-        }).detach();
+    uint64_t LiveCamFramedSource::getNumOverflows() const {
+        return numOverflows.load(std::memory_order_relaxed);
     }
 
-    void LiveCamFramedSource::onEncodedData(std::vector<uint8_t> &&newData) {
+    GopCache const &LiveCamFramedSource::getGopCache() const {
+        return gopCache;
+    }
 
-        if (!isCurrentlyAwaitingData()) {
+    bool LiveCamFramedSource::isFrameEnd() const {
+        return isLastUnitFrameEnd;
+    }
+
+    void LiveCamFramedSource::onEncodedData(NalUnit &&newData, int64_t captureTimeUs) {
+
+        // nobody reads the frames (the data would be stale by the time the streaming starts)
+        if (!isStreaming.load(std::memory_order_acquire)) {
             return;
         }
 
-        encodedDataMutex.lock();
+        if (isDroppingUntilKeyFrame) {
+
+            // the decoder cannot recover from the missing data before the next key frame anyway
+            if (!lirs::utils::isKeyFrameStart(transcoder.getCodec(), newData.data(), newData.size())) {
+                numDroppedUnits.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
 
-        // store encoded data to be processed later
-        encodedDataBuffer.emplace_back(std::move(newData));
+            isDroppingUntilKeyFrame = false;
+
+            LOG(DEBUG) << "Resumed streaming at the key frame: " << transcoder.getConfig().getName()
+                       << ", dropped units: " << getNumDroppedUnits();
+        }
 
-        encodedDataMutex.unlock();
+        timeval presentationTime{};
+        presentationTime.tv_sec = static_cast<time_t>(captureTimeUs / 1000000);
+        presentationTime.tv_usec = static_cast<suseconds_t>(captureTimeUs % 1000000);
+
+        EncodedData encodedData{std::move(newData), presentationTime};
+
+        if (!enqueue(encodedData)) {
+            return;
+        }
 
         // publish an event to be handled by the event loop
         envir().taskScheduler().triggerEvent(eventTriggerId, this);
     }
 
+    bool LiveCamFramedSource::enqueue(EncodedData &encodedData) {
+
+        if (encodedDataQueue.tryPush(encodedData)) {
+            return true;
+        }
+
+        numOverflows.fetch_add(1, std::memory_order_relaxed);
+
+        if (overflowPolicy == lirs::config::params::OverflowPolicy::BLOCK) {
+
+            // wait for the event loop to catch up (the capture queues drop frames meanwhile)
+            while (isStreaming.load(std::memory_order_acquire)) {
+                if (encodedDataQueue.push(encodedData, std::chrono::milliseconds(100))) {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        LOG(WARN) << "Encoded data queue is full, dropping data until the next key frame: "
+                  << transcoder.getConfig().getName();
+
+        numDroppedUnits.fetch_add(1, std::memory_order_relaxed);
+
+        isDroppingUntilKeyFrame = true;
+
+        // the stream resumes at the next key frame, do not wait for the next GOP
+        transcoder.requestKeyFrame();
+
+        return false;
+    }
+
+    void LiveCamFramedSource::clearQueue() {
+
+        EncodedData encodedData;
+
+        while (encodedDataQueue.tryPop(encodedData)) {
+            // the unit is released when the next one is popped
+        }
+    }
+
     void LiveCamFramedSource::deliverFrame0(void *clientData) {
         ((LiveCamFramedSource *) clientData)->deliverData();
     }
 
     void LiveCamFramedSource::doStopGettingFrames() {
 
-        LOG(DEBUG) << "Stop getting frames from the camera: " << transcoder.getConfig().getName();
+        LOG(DEBUG) << "Stop getting frames from the camera: " << transcoder.getConfig().getName()
+                   << ", dropped units: " << getNumDroppedUnits() << ", queue overflows: " << getNumOverflows();
+
+        // the replicator restarts reading right away when the reading replica leaves, so the streaming is stopped
+        // only if nobody resumes reading during this event loop iteration
+        isStopped = true;
+
+        envir().taskScheduler().unscheduleDelayedTask(stopStreamingTask);
+        stopStreamingTask = envir().taskScheduler().scheduleDelayedTask(0, LiveCamFramedSource::stopStreaming0, this);
 
         FramedSource::doStopGettingFrames();
     }
 
+    void LiveCamFramedSource::stopStreaming0(void *clientData) {
+        ((LiveCamFramedSource *) clientData)->stopStreaming();
+    }
+
+    void LiveCamFramedSource::startStreaming() {
+
+        envir().taskScheduler().unscheduleDelayedTask(idleTask);
+
+        isStreaming.store(true, std::memory_order_release);
+
+        // the transcoder is shared by the sources of all the event loops
+        if (!isTranscoderAcquired) {
+            isTranscoderAcquired = true;
+            transcoder.acquire();
+        }
+    }
+
+    void LiveCamFramedSource::stopStreaming() {
+
+        stopStreamingTask = nullptr;
+
+        if (!isStopped) {
+            return; // resumed
+        }
+
+        isStreaming.store(false, std::memory_order_release);
+
+        // stale data should not be delivered when the streaming is restarted
+        clearQueue();
+
+        gopCache.clear();
+
+        auto idleTimeoutMs = transcoder.getConfig().getPipelineParams().getIdleTimeoutMs();
+
+        // the camera keeps capturing for a while (clients often reconnect)
+        if (idleTimeoutMs != lirs::config::params::PipelineParameters::NEVER) {
+            idleTask = envir().taskScheduler().scheduleDelayedTask(idleTimeoutMs * 1000LL,
+                                                                   LiveCamFramedSource::pauseTranscoder0, this);
+        }
+    }
+
+    void LiveCamFramedSource::pauseTranscoder0(void *clientData) {
+        ((LiveCamFramedSource *) clientData)->pauseTranscoder();
+    }
+
+    void LiveCamFramedSource::pauseTranscoder() {
+
+        idleTask = nullptr;
+
+        LOG(DEBUG) << "No clients are watching the camera: " << transcoder.getConfig().getName();
+
+        isTranscoderAcquired = false;
+
+        transcoder.release(); // paused unless the camera is watched via the other event loops
+    }
+
     void LiveCamFramedSource::deliverData() {
 
         if (!isCurrentlyAwaitingData()) {
             return;
         }
 
-        encodedDataMutex.lock();
+        // the unit (and its packet along with the packet's last unit) is released right after copying (unless cached)
+        EncodedData encodedData;
 
-        encodedData = std::move(encodedDataBuffer.back());
+        // already delivered by doGetNextFrame (several triggers are handled at once)
+        if (!encodedDataQueue.tryPop(encodedData)) {
+            return;
+        }
 
-        encodedDataBuffer.pop_back();
+        auto const &data = encodedData.data;
 
-        encodedDataMutex.unlock();
+        gopCache.add(data, encodedData.presentationTime);
 
-        if (encodedData.size() > max_nalu_size_bytes) {
-            max_nalu_size_bytes = encodedData.size();
+        if (data.size() > max_nalu_size_bytes) {
+            max_nalu_size_bytes = data.size();
         }
 
-        if (encodedData.size() > fMaxSize) { // truncate data
+        if (data.size() > fMaxSize) { // truncate data
 
-            LOG(WARN) << "Exceeded max size, truncated: " << fNumTruncatedBytes << ", size: " << encodedData.size();
+            LOG(WARN) << "Exceeded max size, truncated: " << fNumTruncatedBytes << ", size: " << data.size();
 
             fFrameSize = fMaxSize;
 
-            fNumTruncatedBytes = static_cast<unsigned int>(encodedData.size() - fMaxSize);
+            fNumTruncatedBytes = static_cast<unsigned int>(data.size() - fMaxSize);
 
         } else {
-            fFrameSize = static_cast<unsigned int>(encodedData.size());
+            fFrameSize = static_cast<unsigned int>(data.size());
         }
 
-        // can be changed to the actual frame's captured time
-        gettimeofday(&fPresentationTime, nullptr);
+        // the frame's capture time, so the RTP timestamps and RTCP SR times are free of encoding/delivery jitter
+        fPresentationTime = encodedData.presentationTime;
+
+        isLastUnitFrameEnd = data.isFrameEnd();
 
         // DO NOT CHANGE ADDRESS, ONLY COPY (see Live555 docs)
-        memcpy(fTo, encodedData.data(), fFrameSize);
+        memcpy(fTo, data.data(), fFrameSize);
 
         // should be invoked after successfully getting data
         FramedSource::afterGetting(this);
@@ -112,7 +259,13 @@ namespace LIRS {
 
     void LiveCamFramedSource::doGetNextFrame() {
 
-        if (!encodedDataBuffer.empty()) {
+        isStopped = false;
+
+        if (!isStreaming.load(std::memory_order_relaxed)) {
+            startStreaming();
+        }
+
+        if (!encodedDataQueue.empty()) {
             deliverData();
         } else {
             fFrameSize = 0;
@@ -1,23 +1,115 @@
 #include "LiveCameraRTSPServer.hpp"
 
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <functional>
+
 namespace LIRS {
 
-    LiveCameraRTSPServer::LiveCameraRTSPServer(lirs::config::params::ServerParameters const &config) : watcher(0),
-            scheduler(nullptr), env(nullptr), server(nullptr), config(config) {
+    LiveCameraRTSPServer::LiveCameraRTSPServer(lirs::config::params::ServerParameters const &config)
+            : LiveCameraRTSPServer(config, false, 0) {}
+
+    LiveCameraRTSPServer::LiveCameraRTSPServer(lirs::config::params::ServerParameters const &config, bool isWorker,
+                                               size_t workerIndex)
+            : watcher(0), scheduler(nullptr), eventTriggers(nullptr), env(nullptr), server(nullptr), config(config),
+              isWorker(isWorker), workerIndex(workerIndex), rtspServerSocket(-1), httpServerSocket(-1),
+              connectionEventTriggerId(0), stopEventTriggerId(0) {
 
         OutPacketBuffer::maxSize = config.getMaxBufSize();
 
         LOG(DEBUG) << "Setting OutPacketBuffer max size to " << OutPacketBuffer::maxSize << " (bytes)";
 
+        RTPInterface::maxTCPQueueSize = config.getTcpQueueSize();
+
+        LOG(DEBUG) << "Setting TCP clients' send queue size to " << RTPInterface::maxTCPQueueSize << " (bytes)";
+
         // create scheduler and environment
-        scheduler = BasicTaskScheduler::createNew();
+        if (config.getTaskSchedulerType() == lirs::config::params::TaskSchedulerType::EPOLL) {
+            auto epollScheduler = EpollTaskScheduler::createNew();
+            if (epollScheduler) {
+                scheduler = epollScheduler;
+                eventTriggers = &epollScheduler->getEventTriggerRegistry();
+            }
+        }
+
+        if (!scheduler) { // select() based one (also if epoll is not available)
+
+            auto selectScheduler = SelectTaskScheduler::createNew();
+
+            if (!selectScheduler) {
+                LOG(ERROR) << "Failed to create task scheduler";
+                exit(1);
+            }
+
+            scheduler = selectScheduler;
+            eventTriggers = &selectScheduler->getEventTriggerRegistry();
+        }
+
         env = BasicUsageEnvironment::createNew(*scheduler);
+
+        if (isWorker) {
+            connectionEventTriggerId = eventTriggers->create(LiveCameraRTSPServer::handOverConnections0,
+                                                             MAX_NUM_PENDING_CONNECTIONS);
+
+            stopEventTriggerId = eventTriggers->create(LiveCameraRTSPServer::handleStop0);
+        }
     }
 
     LiveCameraRTSPServer::~LiveCameraRTSPServer() {
 
+        // the workers are stopped by now (see runWorkers)
+        workers.clear();
+
+        // the controllers read the fan-outs' sinks
+        rateControllers.clear();
+
+        if (rtspServerSocket >= 0) {
+            env->taskScheduler().turnOffBackgroundReadHandling(rtspServerSocket);
+            ::closeSocket(rtspServerSocket);
+        }
+
+        if (httpServerSocket >= 0) {
+            env->taskScheduler().turnOffBackgroundReadHandling(httpServerSocket);
+            ::closeSocket(httpServerSocket);
+        }
+
+        if (connectionEventTriggerId != 0) {
+
+            void *payload;
+
+            // close the connections which have not been handed over
+            while (eventTriggers->takePayload(connectionEventTriggerId, payload)) {
+                std::unique_ptr<ClientConnection> connection(static_cast<ClientConnection *>(payload));
+                ::closeSocket(connection->socket);
+            }
+
+            eventTriggers->remove(connectionEventTriggerId);
+        }
+
+        if (stopEventTriggerId != 0) {
+            eventTriggers->remove(stopEventTriggerId);
+        }
+
         Medium::close(server); // deletes all server media sessions
 
+        // stop the multicast streams (before their sources are closed)
+        for (auto &output : multicastOutputs) {
+            output.sink->stopPlaying();
+            Medium::close(output.rtcpInstance);
+            Medium::close(output.sink);
+            Medium::close(output.source);
+            delete output.rtpGroupsock;
+            delete output.rtcpGroupsock;
+        }
+
+        multicastOutputs.clear();
+
+        // close all fan-outs (the clients' sinks are deleted along with the sessions)
+        for (auto &fanout : allocatedFanouts) {
+            if (fanout) Medium::close(fanout);
+        }
+
         // close all framed sources
         for (auto &src : allocatedVideoSources) {
             if (src) Medium::close(src);
@@ -28,6 +120,7 @@ namespace LIRS {
         delete scheduler;
 
         transcoders.clear();
+        allocatedFanouts.clear();
         allocatedVideoSources.clear();
         watcher = 0;
 
@@ -39,52 +132,209 @@ namespace LIRS {
         LOG(DEBUG) << "Stop server is invoked!";
 
         watcher = 's';
+
+        if (stopEventTriggerId != 0) { // the worker's event loop checks the watch variable once woken up
+            eventTriggers->trigger(stopEventTriggerId, this);
+        }
+
+        for (auto &worker : workers) {
+            worker->stopServer();
+        }
     }
 
     void LiveCameraRTSPServer::run() {
 
-        if (server) {
+        if (server || !workers.empty()) {
 
             LOG(WARN) << "Server is already running!";
 
             return; // already running
         }
 
-        // create server listening on the specified RTSP port
-        server = RTSPServer::createNew(*env, config.getRtspPortNum());
+        if (!isWorker && config.getNumWorkers() > 0) {
+            runWorkers();
+            return;
+        }
+
+        createServer();
+
+        env->taskScheduler().doEventLoop(&watcher); // do not return
+    }
+
+    void LiveCameraRTSPServer::createServer() {
+
+        if (isWorker) { // the connections are accepted by the main event loop
+
+            server = WorkerRTSPServer::createNew(*env, config.getRtspPortNum());
+
+        } else {
+
+            // create server listening on the specified RTSP port
+            server = RTSPServer::createNew(*env, config.getRtspPortNum());
+
+            if (!server) {
+                LOG(ERROR) << "Failed to create RTSP server: " << env->getResultMsg();
+                exit(1);
+            }
+
+            LOG(DEBUG) << "Server has been created on port " << config.getRtspPortNum();
+
+            if (config.isHttpEnabled()) { // set up HTTP tunneling (see Live555 docs)
+                auto res = server->setUpTunnelingOverHTTP(config.getHttpPortNum());
+                if (res) {
+                    LOG(INFO) << "Enabled HTTP tunneling over: " << config.getHttpPortNum();
+                }
+            }
+        }
+
+        LOG(DEBUG) << "Creating media session for each transcoder";
 
-        if (!server) {
+        // create media session for each video source (transcoder)
+        for (size_t idx = 0; idx < transcoders.size(); ++idx) {
+            addMediaSession(transcoders[idx], transcoders[idx]->getConfig().getName(), "stream description", idx);
+        }
+    }
+
+    void LiveCameraRTSPServer::runWorkers() {
+
+        Port rtspPort(config.getRtspPortNum());
+
+        rtspServerSocket = WorkerRTSPServer::setUpListeningSocket(*env, rtspPort);
+
+        if (rtspServerSocket < 0) {
             LOG(ERROR) << "Failed to create RTSP server: " << env->getResultMsg();
             exit(1);
         }
 
-        LOG(DEBUG) << "Server has been created on port " << config.getRtspPortNum();
+        env->taskScheduler().turnOnBackgroundReadHandling(rtspServerSocket, acceptRtspConnection0, this);
+
+        if (config.isHttpEnabled()) { // RTSP-over-HTTP connections are handed over the same way
+
+            Port httpPort(config.getHttpPortNum());
 
-        if (config.isHttpEnabled()) { // set up HTTP tunneling (see Live555 docs)
-            auto res = server->setUpTunnelingOverHTTP(config.getHttpPortNum());
-            if (res) {
+            httpServerSocket = WorkerRTSPServer::setUpListeningSocket(*env, httpPort);
+
+            if (httpServerSocket >= 0) {
+                env->taskScheduler().turnOnBackgroundReadHandling(httpServerSocket, acceptHttpConnection0, this);
                 LOG(INFO) << "Enabled HTTP tunneling over: " << config.getHttpPortNum();
             }
         }
 
-        LOG(DEBUG) << "Creating media session for each transcoder";
+        if (config.isMulticastEnabled()) {
+            LOG(WARN) << "Multicast streams are not supported along with the workers, the cameras are streamed via unicast";
+        }
 
-        // create media session for each video source (transcoder)
-        for (auto &transcoder : transcoders) {
-            addMediaSession(transcoder, transcoder->getConfig().getName(), "stream description");
+        // the sessions (and the sources reading the transcoders) are created before any of the workers runs
+        for (size_t idx = 0; idx < config.getNumWorkers(); ++idx) {
+
+            std::unique_ptr<LiveCameraRTSPServer> worker(new LiveCameraRTSPServer(config, true, idx));
+
+            for (auto &transcoder : transcoders) {
+                worker->addTranscoder(transcoder);
+            }
+
+            worker->createServer();
+
+            workers.push_back(std::move(worker));
         }
 
-        env->taskScheduler().doEventLoop(&watcher); // do not return
+        for (auto &worker : workers) {
+            workerThreads.emplace_back(&TaskScheduler::doEventLoop, &worker->env->taskScheduler(), &worker->watcher);
+        }
+
+        LOG(INFO) << "Streaming to the clients via " << workers.size() << " event loops";
+
+        env->taskScheduler().doEventLoop(&watcher); // accept the connections until the server is stopped
+
+        for (auto &worker : workers) {
+            worker->stopServer();
+        }
+
+        for (auto &thread : workerThreads) {
+            thread.join();
+        }
+
+        workerThreads.clear();
+    }
+
+    void LiveCameraRTSPServer::acceptRtspConnection0(void *clientData, int) {
+        auto rtspServer = (LiveCameraRTSPServer *) clientData;
+        rtspServer->acceptConnection(rtspServer->rtspServerSocket);
+    }
+
+    void LiveCameraRTSPServer::acceptHttpConnection0(void *clientData, int) {
+        auto rtspServer = (LiveCameraRTSPServer *) clientData;
+        rtspServer->acceptConnection(rtspServer->httpServerSocket);
+    }
+
+    void LiveCameraRTSPServer::acceptConnection(int serverSocket) {
+
+        ClientConnection connection{};
+
+        socklen_t addressSize = sizeof connection.address;
+
+        connection.socket = accept(serverSocket, (struct sockaddr *) &connection.address, &addressSize);
+
+        if (connection.socket < 0) {
+            if (env->getErrno() != EWOULDBLOCK) {
+                LOG(WARN) << "Failed to accept connection: " << strerror(env->getErrno());
+            }
+            return;
+        }
+
+        // the same client's connections end up in the same worker (sessions, HTTP tunneling)
+        auto workerIdx = std::hash<uint32_t>()(connection.address.sin_addr.s_addr) % workers.size();
+
+        workers[workerIdx]->addClientConnection(connection);
+    }
+
+    void LiveCameraRTSPServer::addClientConnection(ClientConnection const &connection) {
+
+        std::unique_ptr<ClientConnection> pendingConnection(new ClientConnection(connection));
+
+        if (!eventTriggers->post(connectionEventTriggerId, pendingConnection.get(), this)) {
+
+            LOG(WARN) << "Too many pending connections, the connection is rejected";
+
+            ::closeSocket(connection.socket);
+
+            return;
+        }
+
+        pendingConnection.release(); // taken out by the worker
+    }
+
+    void LiveCameraRTSPServer::handOverConnections0(void *clientData) {
+        ((LiveCameraRTSPServer *) clientData)->handOverConnections();
+    }
+
+    void LiveCameraRTSPServer::handOverConnections() {
+
+        void *payload;
+
+        while (eventTriggers->takePayload(connectionEventTriggerId, payload)) {
+            std::unique_ptr<ClientConnection> connection(static_cast<ClientConnection *>(payload));
+            static_cast<WorkerRTSPServer *>(server)->addClientConnection(connection->socket, connection->address);
+        }
+    }
+
+    void LiveCameraRTSPServer::handleStop0(void *clientData) {
+        ((LiveCameraRTSPServer *) clientData)->watcher = 's';
     }
 
     void LiveCameraRTSPServer::announceStream(ServerMediaSession *sms, const std::string &deviceName) {
+
+        if (isWorker && workerIndex > 0) {
+            return; // announced by the first worker
+        }
+
         auto url = server->rtspURL(sms);
         LOG(INFO) << "Play the stream of the '" << deviceName.data() << "' camera using the following URL: " << url;
         delete[] url;
     }
 
     void LiveCameraRTSPServer::addMediaSession(std::shared_ptr<Transcoder> transcoder, const std::string &streamName,
-                                               const std::string &streamDesc) {
+                                               const std::string &streamDesc, size_t cameraIndex) {
 
         LOG(DEBUG) << "Adding media session for camera: " << transcoder->getConfig().getName();
 
@@ -94,21 +344,173 @@ namespace LIRS {
         // store it in order to cleanup after
         allocatedVideoSources.push_back(framedSource);
 
-        // create stream replicator for the framed source
-        auto replicator = StreamReplicator::createNew(*env, framedSource, False);
-
         // create media session with the specified topic and description
-        auto sms = ServerMediaSession::createNew(*env, streamName.c_str(), "stream information", streamDesc.c_str(),
-                                                 False, "a=fmtp:96\n");
+        // the subsession's 'a=fmtp' line carries the parameter sets
+        auto sms = ServerMediaSession::createNew(*env, streamName.c_str(), "stream information", streamDesc.c_str());
+
+        RtpFanout *fanout = nullptr;
+
+        StreamReplicator *replicator = nullptr;
 
         // add unicast subsession
-        sms->addSubsession(CameraUnicastServerMediaSubsession::createNew(*env, replicator,
-                                                                         transcoder->getConfig().getEncoderParams().getBitrate(), config.getMaxPacketSize()));
+        if (config.isSharedFanoutEnabled()) {
+
+            // the stream is packetized once for all the clients
+            fanout = RtpFanout::createNew(*env, framedSource, transcoder->getCodec(), config.getMaxPacketSize(),
+                                          &framedSource->getGopCache());
+
+            if (config.isPacingEnabled()) {
+
+                auto const &frameRate = transcoder->getConfig().getOutputParams().getFrameRate();
+
+                // the frame interval is num/den of the frame rate inverted
+                auto windowUs = static_cast<int64_t>(config.getPacingWindow() * 1000000.0 * frameRate.second
+                                                     / frameRate.first);
+
+                fanout->setPacing(windowUs, static_cast<size_t>(config.getPacingBurst()) * config.getMaxPacketSize());
+
+                LOG(DEBUG) << "Clients' packets are paced over " << windowUs << " (us) in bursts of at most "
+                           << config.getPacingBurst() << " packets";
+            }
+
+            if (config.isRetransmissionEnabled()) {
+
+                fanout->setRetransmission(config.getRetransmissionHistorySize(), config.isRtxEnabled());
+
+                LOG(DEBUG) << "Packets reported lost are resent" << (config.isRtxEnabled() ? " as RTX" : "")
+                           << ", " << config.getRetransmissionHistorySize() << " packets are kept per client";
+            }
+
+            allocatedFanouts.push_back(fanout);
+
+            auto const &adaptiveBitrateParams = transcoder->getConfig().getAdaptiveBitrateParams();
+
+            if (adaptiveBitrateParams.isEnabled()) {
+
+                if (transcoder->isBitrateAdjustable()) {
+
+                    rateControllers.emplace_back(new BitrateController(*env, *transcoder, *fanout,
+                                                                       adaptiveBitrateParams));
+
+                    LOG(DEBUG) << "Bitrate follows the clients' receiver reports within ["
+                               << adaptiveBitrateParams.getMinBitrate() << ", "
+                               << adaptiveBitrateParams.getMaxBitrate() << "] (kbps)";
+                } else {
+                    LOG(WARN) << "Adaptive bitrate requires H.264 encoding, the bitrate of '"
+                              << transcoder->getConfig().getName() << "' is not adapted";
+                }
+            }
+
+            sms->addSubsession(CameraUnicastServerMediaSubsession::createNew(*env, fanout, *transcoder,
+                                                                             config.getMaxPacketSize()));
+        } else {
+
+            if (config.isPacingEnabled()) {
+                LOG(WARN) << "Pacing requires the shared fan-out, the packets are not paced";
+            }
+
+            if (transcoder->getConfig().getAdaptiveBitrateParams().isEnabled()) {
+                LOG(WARN) << "Adaptive bitrate requires the shared fan-out, the bitrate is not adapted";
+            }
+
+            if (config.isRetransmissionEnabled()) {
+                LOG(WARN) << "Retransmission requires the shared fan-out, the lost packets are not resent";
+            }
+
+            // create stream replicator for the framed source
+            replicator = StreamReplicator::createNew(*env, framedSource, False);
+
+            sms->addSubsession(CameraUnicastServerMediaSubsession::createNew(*env, replicator, *transcoder,
+                                                                             config.getMaxPacketSize(),
+                                                                             &framedSource->getGopCache()));
+        }
 
         server->addServerMediaSession(sms);
 
         // announce stream
         announceStream(sms, transcoder->getConfig().getName());
+
+        if (config.isMulticastEnabled() && !isWorker) {
+            addMulticastSession(transcoder, streamName + "_multicast", cameraIndex, fanout, replicator);
+        }
+    }
+
+    void LiveCameraRTSPServer::addMulticastSession(std::shared_ptr<Transcoder> const &transcoder,
+                                                   const std::string &streamName, size_t cameraIndex,
+                                                   RtpFanout *fanout, StreamReplicator *replicator) {
+
+        struct in_addr groupAddr{};
+
+        inet_pton(AF_INET, config.getMulticastGroup().c_str(), &groupAddr);
+
+        // each camera has its own group, so the receivers get the joined cameras only
+        groupAddr.s_addr = htonl(ntohl(groupAddr.s_addr) + static_cast<uint32_t>(cameraIndex));
+
+        Port rtpPort(config.getMulticastPortNum());
+        Port rtcpPort(static_cast<portNumBits>(config.getMulticastPortNum() + 1));
+
+        MulticastOutput output{};
+
+        // source-specific multicast: the server is the only sender, the clients do not send to the group
+        output.rtpGroupsock = new Groupsock(*env, groupAddr, rtpPort, config.getMulticastTtl());
+        output.rtpGroupsock->multicastSendOnly();
+
+        output.rtcpGroupsock = new Groupsock(*env, groupAddr, rtcpPort, config.getMulticastTtl());
+        output.rtcpGroupsock->multicastSendOnly();
+
+        unsigned char const rtpPayloadType = 96;
+
+        if (fanout) { // the shared packets are sent to the group as to one more client
+
+            output.source = FanoutClientSource::createNew(*env);
+            output.sink = FanoutRTPSink::createNew(*env, output.rtpGroupsock, rtpPayloadType, *fanout);
+
+        } else {
+
+            auto source = replicator->createStreamReplica();
+
+            // only discrete frames are being sent (w/o start code bytes)
+            switch (transcoder->getCodec()) {
+                case lirs::config::params::VideoCodec::H264:
+                    output.source = H264VideoStreamDiscreteFramer::createNew(*env, source);
+                    break;
+                case lirs::config::params::VideoCodec::H265:
+                    output.source = H265VideoStreamDiscreteFramer::createNew(*env, source);
+                    break;
+                default: // VP8 and VP9 frames are sent as is
+                    output.source = source;
+                    break;
+            }
+
+            output.sink = CameraUnicastServerMediaSubsession::createCodecRTPSink(
+                    *env, output.rtpGroupsock, rtpPayloadType, *transcoder, config.getMaxPacketSize());
+        }
+
+        unsigned char cname[101] = {};
+        gethostname(reinterpret_cast<char *>(cname), sizeof cname - 1);
+
+        auto bitrate = static_cast<unsigned>(transcoder->getConfig().getEncoderParams().getBitrate());
+
+        output.rtcpInstance = RTCPInstance::createNew(*env, output.rtcpGroupsock, bitrate, cname, output.sink,
+                                                      nullptr, True);
+
+        auto sms = ServerMediaSession::createNew(*env, streamName.c_str(), "stream information",
+                                                 "multicast stream", True);
+
+        sms->addSubsession(CameraMulticastServerMediaSubsession::createNew(*output.sink, output.rtcpInstance,
+                                                                           *transcoder, config.getMaxPacketSize()));
+
+        server->addServerMediaSession(sms);
+
+        // the camera is streamed as long as the server runs (the receivers may join the group without RTSP)
+        output.sink->startPlaying(*output.source, nullptr, nullptr);
+
+        multicastOutputs.push_back(output);
+
+        LOG(INFO) << "Multicast stream of the '" << transcoder->getConfig().getName() << "' camera is sent to "
+                  << AddressString(groupAddr).val() << ":" << config.getMulticastPortNum();
+
+        announceStream(sms, transcoder->getConfig().getName());
     }
 
     void LiveCameraRTSPServer::addTranscoder(std::shared_ptr<Transcoder> transcoder) {
@@ -0,0 +1,313 @@
+#include "RtpFanout.hpp"
+#include "FanoutRTPSink.hpp"
+#include "LiveCamFramedSource.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Utils.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace LIRS {
+
+    namespace {
+
+        int64_t toMicroseconds(timeval time) {
+            return static_cast<int64_t>(time.tv_sec) * 1000000 + time.tv_usec;
+        }
+
+        /**
+         * Max size of the payload headers (H.265 fragmentation unit).
+         */
+        constexpr size_t MAX_PAYLOAD_HEADER_SIZE = 3;
+    }
+
+    RtpFanout *RtpFanout::createNew(UsageEnvironment &env, LiveCamFramedSource *source,
+                                    lirs::config::params::VideoCodec codec, size_t maxPacketSize,
+                                    GopCache const *gopCache) {
+        return new RtpFanout(env, source, codec, maxPacketSize, gopCache);
+    }
+
+    RtpFanout::RtpFanout(UsageEnvironment &env, LiveCamFramedSource *source, lirs::config::params::VideoCodec codec,
+                         size_t maxPacketSize, GopCache const *gopCache)
+            : MediaSink(env), source(source), codec(codec), maxPayloadSize(maxPacketSize - RtpPacket::HEADER_SIZE),
+              gopCache(gopCache), pacingWindowUs(0), pacingBucketSize(0),
+              retransmissionHistorySize(0), isRtxEnabledFlag(false), attachTask(nullptr),
+              buffer(OutPacketBuffer::maxSize) {
+
+        if (maxPacketSize <= RtpPacket::HEADER_SIZE + MAX_PAYLOAD_HEADER_SIZE) {
+            LOG(ERROR) << "Max packet size of " << maxPacketSize << " bytes is too small for RTP";
+            assert(false);
+        }
+
+        LOG(DEBUG) << "RTP fan-out with max payload size of " << maxPayloadSize << " bytes is created";
+    }
+
+    RtpFanout::~RtpFanout() {
+
+        envir().taskScheduler().unscheduleDelayedTask(attachTask);
+
+        stopPlaying();
+    }
+
+    std::vector<FanoutRTPSink *> const &RtpFanout::getSinks() const {
+        return sinks;
+    }
+
+    char const *RtpFanout::getRtpPayloadFormatName() const {
+
+        switch (codec) {
+            case lirs::config::params::VideoCodec::H264:
+                return "H264";
+            case lirs::config::params::VideoCodec::VP8:
+                return "VP8";
+            case lirs::config::params::VideoCodec::VP9:
+                return "VP9";
+            default:
+                return "H265";
+        }
+    }
+
+    void RtpFanout::setPacing(int64_t windowUs, size_t bucketSize) {
+        pacingWindowUs = windowUs;
+        pacingBucketSize = bucketSize;
+    }
+
+    int64_t RtpFanout::getPacingWindowUs() const {
+        return pacingWindowUs;
+    }
+
+    size_t RtpFanout::getPacingBucketSize() const {
+        return pacingBucketSize;
+    }
+
+    void RtpFanout::setRetransmission(size_t historySize, bool isRtxEnabled) {
+        retransmissionHistorySize = historySize;
+        isRtxEnabledFlag = isRtxEnabled;
+    }
+
+    size_t RtpFanout::getRetransmissionHistorySize() const {
+        return retransmissionHistorySize;
+    }
+
+    bool RtpFanout::isRtxEnabled() const {
+        return isRtxEnabledFlag;
+    }
+
+    void RtpFanout::attach(FanoutRTPSink *sink) {
+
+        // the client is attached via the event loop: the sink is started while the client's PLAY request is
+        // handled, i.e. before the server reads the sink's sequence number and timestamp for the response
+        // (the primed packets would precede the reported ones) and before the response is sent
+        pendingSinks.push_back(sink);
+
+        if (!attachTask) {
+            attachTask = envir().taskScheduler().scheduleDelayedTask(0, attachPending0, this);
+        }
+    }
+
+    void RtpFanout::attachPending0(void *clientData) {
+        ((RtpFanout *) clientData)->attachPending();
+    }
+
+    void RtpFanout::attachPending() {
+
+        attachTask = nullptr;
+
+        for (auto sink : pendingSinks) {
+
+            prime(sink);
+
+            sinks.push_back(sink);
+
+            LOG(DEBUG) << "Client is attached to the fan-out, clients: " << sinks.size();
+        }
+
+        pendingSinks.clear();
+
+        if (!sinks.empty() && fSource == nullptr) {
+            startPlaying(*source, nullptr, nullptr);
+        }
+    }
+
+    void RtpFanout::detach(FanoutRTPSink *sink) {
+
+        auto pendingIt = std::find(pendingSinks.begin(), pendingSinks.end(), sink);
+
+        if (pendingIt != pendingSinks.end()) {
+
+            pendingSinks.erase(pendingIt);
+
+            if (pendingSinks.empty()) {
+                envir().taskScheduler().unscheduleDelayedTask(attachTask);
+            }
+
+            return;
+        }
+
+        auto it = std::find(sinks.begin(), sinks.end(), sink);
+
+        if (it == sinks.end()) {
+            return;
+        }
+
+        sinks.erase(it);
+
+        LOG(DEBUG) << "Client is detached from the fan-out, clients: " << sinks.size();
+
+        if (sinks.empty()) {
+            stopPlaying(); // the source is no longer read
+        }
+    }
+
+    void RtpFanout::prime(FanoutRTPSink *sink) {
+
+        if (!gopCache || gopCache->empty()) {
+            return;
+        }
+
+        auto referenceTimeUs = toMicroseconds((*gopCache)[gopCache->size() - 1].presentationTime);
+
+        // the cached units are exactly the units of the group of pictures sent to the other clients so far
+        std::vector<std::shared_ptr<RtpPacket>> primingPackets;
+
+        for (size_t index = 0; index < gopCache->size(); ++index) {
+            auto const &unit = (*gopCache)[index];
+            packetize(unit.data.data(), unit.data.size(), GopCache::toPrimedTime(unit.presentationTime, referenceTimeUs),
+                      unit.data.isFrameEnd(), primingPackets);
+        }
+
+        sink->send(primingPackets);
+
+        LOG(DEBUG) << "Client is primed with " << gopCache->size() << " cached units (" << primingPackets.size()
+                   << " packets)";
+    }
+
+    Boolean RtpFanout::continuePlaying() {
+
+        if (fSource == nullptr) {
+            return False;
+        }
+
+        fSource->getNextFrame(buffer.data(), static_cast<unsigned int>(buffer.size()), afterGettingFrame, this,
+                              onSourceClosure, this);
+
+        return True;
+    }
+
+    void RtpFanout::continuePlaying0(void *clientData) {
+        ((RtpFanout *) clientData)->continuePlaying();
+    }
+
+    void RtpFanout::afterGettingFrame(void *clientData, unsigned frameSize, unsigned numTruncatedBytes,
+                                      timeval presentationTime, unsigned) {
+        ((RtpFanout *) clientData)->afterGettingFrame(frameSize, numTruncatedBytes, presentationTime);
+    }
+
+    void RtpFanout::afterGettingFrame(unsigned frameSize, unsigned numTruncatedBytes, timeval presentationTime) {
+
+        if (numTruncatedBytes > 0) {
+            LOG(WARN) << "Encoded unit is truncated by " << numTruncatedBytes << " bytes (increase max_buf_size)";
+        }
+
+        // packetized once for all the clients
+        packets.clear();
+
+        packetize(buffer.data(), frameSize, presentationTime, source->isFrameEnd(), packets);
+
+        for (size_t index = 0; index < sinks.size(); ++index) {
+            sinks[index]->send(packets);
+        }
+
+        if (fSource == nullptr) { // the last client is detached
+            return;
+        }
+
+        // the next unit is read via the event loop (the source delivers the queued units at once)
+        nextTask() = envir().taskScheduler().scheduleDelayedTask(0, continuePlaying0, this);
+    }
+
+    void RtpFanout::packetize(uint8_t const *data, size_t size, timeval presentationTime, bool isFrameEnd,
+                              std::vector<std::shared_ptr<RtpPacket>> &result) const {
+
+        if (size == 0) {
+            return;
+        }
+
+        bool isUnitKeyFrameStart = lirs::utils::isKeyFrameStart(codec, data, size);
+
+        bool isH26x = codec == lirs::config::params::VideoCodec::H264
+                      || codec == lirs::config::params::VideoCodec::H265;
+
+        // NAL units fitting the packet are sent as is (single NAL unit packets), others are fragmented
+        bool isFragmented = isH26x && size > maxPayloadSize;
+
+        uint8_t nalUnitHeader[2] = {data[0], size >= 2 ? data[1] : uint8_t(0)};
+
+        size_t payloadHeaderSize = 0;
+
+        if (isFragmented) {
+            if (codec == lirs::config::params::VideoCodec::H264) {
+                payloadHeaderSize = 2; // FU indicator and FU header
+                data += 1;             // the NAL unit header is carried by the FU headers
+                size -= 1;
+            } else {
+                payloadHeaderSize = 3; // payload header (type 49) and FU header
+                data += 2;
+                size -= 2;
+            }
+        } else if (!isH26x) {
+            payloadHeaderSize = 1; // VP8/VP9 payload descriptor
+        }
+
+        size_t const fragmentSize = maxPayloadSize - payloadHeaderSize;
+
+        for (size_t offset = 0; offset < size;) {
+
+            auto chunkSize = std::min(fragmentSize, size - offset);
+
+            bool isFirst = offset == 0;
+            bool isLast = offset + chunkSize == size;
+
+            auto packet = std::make_shared<RtpPacket>();
+
+            packet->data.resize(RtpPacket::HEADER_SIZE + payloadHeaderSize + chunkSize);
+            packet->presentationTime = presentationTime;
+            packet->isMarked = isLast && isFrameEnd;
+            packet->isSyncPoint = isFirst && isUnitKeyFrameStart;
+
+            uint8_t *payload = packet->data.data() + RtpPacket::HEADER_SIZE;
+
+            // the same payload headers as the Live555 sinks write
+            switch (codec) {
+                case lirs::config::params::VideoCodec::H264:
+                    if (isFragmented) {
+                        payload[0] = static_cast<uint8_t>((nalUnitHeader[0] & 0xE0) | 28);
+                        payload[1] = static_cast<uint8_t>((nalUnitHeader[0] & 0x1F) | (isFirst ? 0x80 : 0x00)
+                                                          | (isLast ? 0x40 : 0x00));
+                    }
+                    break;
+                case lirs::config::params::VideoCodec::VP8:
+                    payload[0] = static_cast<uint8_t>(isFirst ? 0x10 : 0x00);
+                    break;
+                case lirs::config::params::VideoCodec::VP9:
+                    payload[0] = static_cast<uint8_t>((isFirst ? 0x10 : 0x00) | (isLast ? 0x08 : 0x00));
+                    break;
+                default:
+                    if (isFragmented) {
+                        payload[0] = static_cast<uint8_t>((nalUnitHeader[0] & 0x81) | (49 << 1));
+                        payload[1] = nalUnitHeader[1];
+                        payload[2] = static_cast<uint8_t>(((nalUnitHeader[0] & 0x7E) >> 1) | (isFirst ? 0x80 : 0x00)
+                                                          | (isLast ? 0x40 : 0x00));
+                    }
+                    break;
+            }
+
+            memcpy(payload + payloadHeaderSize, data + offset, chunkSize);
+
+            result.push_back(std::move(packet));
+
+            offset += chunkSize;
+        }
+    }
+}
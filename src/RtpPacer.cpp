@@ -0,0 +1,127 @@
+#include "RtpPacer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace LIRS {
+
+    namespace {
+
+        int64_t nowUs() {
+            return std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    }
+
+    RtpPacer::RtpPacer(UsageEnvironment &env, int64_t windowUs, size_t bucketSize, Transmitter transmitter)
+            : env(env), windowUs(std::max<int64_t>(windowUs, 1)), bucketSize(bucketSize),
+              transmitter(std::move(transmitter)), queueBytes(0), maxQueueBytes(0), numDelayedPackets(0),
+              tokens(static_cast<double>(bucketSize)), rate(0), lastRefillTimeUs(nowUs()), sendTask(nullptr) {}
+
+    RtpPacer::~RtpPacer() {
+        env.taskScheduler().unscheduleDelayedTask(sendTask);
+    }
+
+    void RtpPacer::enqueue(std::vector<std::shared_ptr<RtpPacket>> const &packets) {
+
+        if (packets.empty()) {
+            return;
+        }
+
+        refill();
+
+        for (auto const &packet : packets) {
+            queue.push_back(packet);
+            queueBytes += packet->data.size();
+        }
+
+        maxQueueBytes = std::max(maxQueueBytes, queueBytes);
+
+        // everything queued (including the previous frame's leftovers) is sent by the end of the window
+        rate = static_cast<double>(queueBytes) / static_cast<double>(windowUs);
+
+        if (!sendTask) {
+            sendReady();
+        }
+
+        // the frame's packets left waiting (they are at the end of the queue)
+        numDelayedPackets += std::min(packets.size(), queue.size());
+    }
+
+    void RtpPacer::clear() {
+
+        env.taskScheduler().unscheduleDelayedTask(sendTask);
+
+        queue.clear();
+        queueBytes = 0;
+    }
+
+    size_t RtpPacer::getQueueSize() const {
+        return queue.size();
+    }
+
+    size_t RtpPacer::getQueueBytes() const {
+        return queueBytes;
+    }
+
+    size_t RtpPacer::getMaxQueueBytes() const {
+        return maxQueueBytes;
+    }
+
+    uint64_t RtpPacer::getNumDelayedPackets() const {
+        return numDelayedPackets;
+    }
+
+    void RtpPacer::refill() {
+
+        auto timeUs = nowUs();
+
+        tokens = std::min(getCapacity(), tokens + rate * static_cast<double>(timeUs - lastRefillTimeUs));
+
+        lastRefillTimeUs = timeUs;
+    }
+
+    double RtpPacer::getCapacity() const {
+        return std::max(static_cast<double>(bucketSize), rate * TIMER_RESOLUTION_US);
+    }
+
+    void RtpPacer::sendReady() {
+
+        sendTask = nullptr;
+
+        refill();
+
+        batch.clear();
+
+        // a packet larger than the bucket would never be sent otherwise
+        while (!queue.empty() && tokens >= std::min(static_cast<double>(queue.front()->data.size()), getCapacity())) {
+
+            auto packetSize = queue.front()->data.size();
+
+            tokens -= static_cast<double>(packetSize);
+            queueBytes -= packetSize;
+
+            batch.push_back(std::move(queue.front()));
+            queue.pop_front();
+        }
+
+        if (!batch.empty()) {
+            transmitter(batch);
+        }
+
+        if (queue.empty()) {
+            return;
+        }
+
+        // woken up when the tokens for the next packet are accumulated
+        auto deficit = std::min(static_cast<double>(queue.front()->data.size()), getCapacity()) - tokens;
+        auto delayUs = static_cast<int64_t>(std::ceil(deficit / rate));
+
+        sendTask = env.taskScheduler().scheduleDelayedTask(delayUs, sendReady0, this);
+    }
+
+    void RtpPacer::sendReady0(void *clientData) {
+        ((RtpPacer *) clientData)->sendReady();
+    }
+}
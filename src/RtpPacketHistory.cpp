@@ -0,0 +1,35 @@
+#include "RtpPacketHistory.hpp"
+
+#include <algorithm>
+
+namespace LIRS {
+
+    RtpPacketHistory::RtpPacketHistory(size_t size) : entries(std::max<size_t>(size, 1)) {}
+
+    void RtpPacketHistory::add(uint16_t seqNo, uint32_t timestamp, std::shared_ptr<RtpPacket> const &packet) {
+
+        auto &entry = entries[seqNo % entries.size()];
+
+        entry.packet = packet;
+        entry.seqNo = seqNo;
+        entry.timestamp = timestamp;
+    }
+
+    RtpPacketHistory::Entry const *RtpPacketHistory::find(uint16_t seqNo) const {
+
+        auto const &entry = entries[seqNo % entries.size()];
+
+        // overwritten by a later packet
+        if (!entry.packet || entry.seqNo != seqNo) {
+            return nullptr;
+        }
+
+        return &entry;
+    }
+
+    void RtpPacketHistory::clear() {
+        for (auto &entry : entries) {
+            entry.packet.reset();
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#include "SelectTaskScheduler.hpp"
+#include "utils/Logger.hpp"
+
+#include <sys/eventfd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace LIRS {
+
+    SelectTaskScheduler *SelectTaskScheduler::createNew() {
+
+        int eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if (eventFd < 0) {
+            LOG(ERROR) << "Failed to create eventfd: " << strerror(errno);
+            return nullptr;
+        }
+
+        return new SelectTaskScheduler(eventFd);
+    }
+
+    // no scheduler tick, the triggers wake the event loop up
+    SelectTaskScheduler::SelectTaskScheduler(int eventFd) : BasicTaskScheduler(0), eventTriggers(eventFd) {
+        turnOnBackgroundReadHandling(eventFd, acknowledgeWakeup0, this);
+    }
+
+    SelectTaskScheduler::~SelectTaskScheduler() {
+        turnOffBackgroundReadHandling(eventTriggers.getEventFd());
+    }
+
+    EventTriggerRegistry &SelectTaskScheduler::getEventTriggerRegistry() {
+        return eventTriggers;
+    }
+
+    void SelectTaskScheduler::acknowledgeWakeup0(void *clientData, int) {
+        ((SelectTaskScheduler *) clientData)->eventTriggers.acknowledgeWakeup();
+    }
+
+    EventTriggerId SelectTaskScheduler::createEventTrigger(TaskFunc *eventHandlerProc) {
+        return eventTriggers.create(eventHandlerProc);
+    }
+
+    void SelectTaskScheduler::deleteEventTrigger(EventTriggerId eventTriggerId) {
+        eventTriggers.remove(eventTriggerId);
+    }
+
+    void SelectTaskScheduler::triggerEvent(EventTriggerId eventTriggerId, void *clientData) {
+        eventTriggers.trigger(eventTriggerId, clientData);
+    }
+
+    void SelectTaskScheduler::SingleStep(unsigned maxDelayTime) {
+
+        BasicTaskScheduler::SingleStep(maxDelayTime);
+
+        eventTriggers.handlePending();
+    }
+}
@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <pthread.h>
+#include <sstream>
+
 #include "Config.hpp"
 #include "Transcoder.hpp"
 
@@ -10,8 +14,24 @@ namespace LIRS {
     }
 
     Transcoder::Transcoder(lirs::config::params::CameraParameters const &config)
-            : config(config), needToStopFlag(false),
-              isRunningFlag(false) {
+            : config(config), encodingPacket(nullptr), converterContext(nullptr), frameIntervalUs(0),
+              nextFrameTimeUs(AV_NOPTS_VALUE), nextFramePts(0),
+              dropPolicy(config.getPipelineParams().getDropPolicy()),
+              rawFrameQueue(config.getPipelineParams().getQueueSize()),
+              convertedFrameQueue(config.getPipelineParams().getQueueSize()),
+              freeFrameQueue(config.getPipelineParams().getQueueSize() + NUM_FRAMES_IN_PROCESSING),
+              captureTimes(CAPTURE_TIMES_HISTORY_SIZE, AV_NOPTS_VALUE),
+              keyFrameRequestedFlag(false), lastKeyFrameRequestUs(AV_NOPTS_VALUE),
+              bitrate(config.getEncoderParams().getBitrate()), lastTargetBitrate(config.getEncoderParams().getBitrate()),
+              needToStopFlag(false), isRunningFlag(false), isPausedFlag(false), resumeTimeUs(0),
+              numReaders(0), isStarted(false) {
+
+        registerAll();
+
+        if (config.isPassthroughEnabled()) {
+            initializePassthrough();
+            return;
+        }
 
         // get the pixel format enum
         this->rawPixFormat = av_get_pix_fmt(config.getInputParams().getPixelFormat().data());
@@ -22,15 +42,11 @@ namespace LIRS {
         //set framerate
         frameRate = (AVRational) {static_cast<int>(config.getInputParams().getFrameRate().first), 1};
 
-        registerAll();
-
-        initializeDecoder();
+        initializeInput();
 
         initializeEncoder();
 
         initializeConverter();
-
-        initFilters();
     }
 
     void Transcoder::run() {
@@ -38,82 +54,297 @@ namespace LIRS {
         // set the flag
         isRunningFlag.store(true);
 
-        // read raw data from the device into the packet
+        if (packetInput) { // nothing to convert and encode
+
+            while (!needToStopFlag.load()) {
+
+                if (isPausedFlag.load()) {
+                    waitWhilePaused(CAPTURE_TIMEOUT_MS);
+                    continue;
+                }
+
+                passPacket();
+            }
+
+            isRunningFlag.store(false);
+
+            return;
+        }
+
+        // conversion and encoding stages (capturing is done in the current thread)
+        std::thread converterThread(&Transcoder::runConverter, this);
+        std::thread encoderThread(&Transcoder::runEncoder, this);
+
+        // read raw data from the video source
+        while (!needToStopFlag.load()) {
+
+            // the converter and the encoder are idle as well (waiting for frames)
+            if (isPausedFlag.load()) {
+                waitWhilePaused(CAPTURE_TIMEOUT_MS);
+                continue;
+            }
+
+            captureFrame();
+        }
+
+        converterThread.join();
+        encoderThread.join();
+
+        releaseQueuedFrames();
+
+        isRunningFlag.store(false);
+    }
+
+    void Transcoder::captureFrame() {
+
+        AVFrame *frame = input->grab(CAPTURE_TIMEOUT_MS);
+
+        if (!frame) {
+            return;
+        }
+
+        int64_t captureTimeUs = frame->pts;
+
+        int64_t wallClockTimeUs = lirs::utils::toWallClockUs(captureTimeUs);
+
+        // captured (buffered by the device) while paused
+        if (wallClockTimeUs < resumeTimeUs.load()) {
+            input->release(frame);
+            return;
+        }
+
+        // drop frames exceeding the output framerate (replaces the 'fps' filter)
+        if (nextFrameTimeUs != AV_NOPTS_VALUE && captureTimeUs < nextFrameTimeUs - frameIntervalUs / 2) {
+            input->release(frame);
+            return;
+        }
+
+        // do not try to catch up after a long pause
+        if (nextFrameTimeUs == AV_NOPTS_VALUE || captureTimeUs - nextFrameTimeUs > frameIntervalUs) {
+            nextFrameTimeUs = captureTimeUs;
+        }
+
+        nextFrameTimeUs += frameIntervalUs;
+
+        frame->pts = nextFramePts++;
+
+        // keep the capture time (in the wall clock) along with the frame
+        frame->best_effort_timestamp = wallClockTimeUs;
+
+        // the frame is read in place by the converter, it is released right after the conversion
+        pushOrDrop(rawFrameQueue, frame, [this](AVFrame *droppedFrame) { releaseRawFrame(droppedFrame); });
+    }
+
+    void Transcoder::passPacket() {
+
+        AVPacket *packet = packetInput->grabPacket(CAPTURE_TIMEOUT_MS);
+
+        if (!packet) {
+            return;
+        }
+
+        deliverPacket(packet, lirs::utils::toWallClockUs(packet->pts), true);
+
+        packetInput->releasePacket(packet);
+    }
+
+    void Transcoder::runConverter() {
+
+        AVFrame *frame = nullptr;
+        AVFrame *convertedFrame = nullptr;
+
         while (!needToStopFlag.load()) {
 
-            int statusCode = av_read_frame(decoderContext.formatContext, decodingPacket);
+            if (!rawFrameQueue.pop(frame, std::chrono::milliseconds(STAGE_TIMEOUT_MS))) {
+                continue;
+            }
 
-            if (statusCode != 0) {
-                av_packet_unref(decodingPacket);
+            // take a frame back from the encoder
+            if (!freeFrameQueue.pop(convertedFrame, std::chrono::milliseconds(STAGE_TIMEOUT_MS))) {
+                releaseRawFrame(frame);
                 continue;
             }
 
-            // check whether it is a video stream's data
-            if (decodingPacket->stream_index == decoderContext.videoStream->index) {
+            // a no-op unless the encoder still references the frame's data
+            av_frame_make_writable(convertedFrame);
 
-                statusCode = decode(decoderContext.codecContext, rawFrame, decodingPacket);
+            // convert raw frame into another pixel format
+            sws_scale(converterContext, reinterpret_cast<const uint8_t *const *>(frame->data),
+                      frame->linesize, 0, static_cast<int>(frameHeight),
+                      convertedFrame->data, convertedFrame->linesize);
 
-                av_packet_unref(decodingPacket);
+            // copy pts/dts, etc.
+            av_frame_copy_props(convertedFrame, frame);
 
-                if (statusCode == 0) {
-                    continue;
-                }
+            releaseRawFrame(frame);
 
-                // push frames to the buffer
-                statusCode = av_buffersrc_add_frame_flags(bufferSrcCtx, rawFrame, AV_BUFFERSRC_FLAG_KEEP_REF);
+            pushOrDrop(convertedFrameQueue, convertedFrame, [this](AVFrame *droppedFrame) {
+                freeFrameQueue.tryPush(droppedFrame);
+            });
+        }
+    }
 
-                if (statusCode < 0) { // workaround for buggy cameras
-                    av_frame_unref(filterFrame);
-                    continue;
-                }
+    void Transcoder::runEncoder() {
 
-                // pull frames from the filter graph
-                while (true) {
+        AVFrame *convertedFrame = nullptr;
 
-                    statusCode = av_buffersink_get_frame(bufferSinkCtx, filterFrame);
+        auto codec = config.getEncoderParams().getCodec();
 
-                    if (statusCode == AVERROR(EAGAIN) || statusCode == AVERROR_EOF) {
-                        av_frame_unref(filterFrame);
-                        break;
-                    }
+        bool isNalStream = codec == lirs::config::params::VideoCodec::H264 ||
+                           codec == lirs::config::params::VideoCodec::H265;
 
-                    av_frame_make_writable(convertedFrame);
+        // run along with the encoder's own threads
+        if (!encoderCpus.empty()) {
+            lirs::utils::setThreadAffinity(encoderCpus);
+        }
+
+        while (!needToStopFlag.load()) {
 
-                    // convert raw frame into another pixel format
-                    sws_scale(converterContext, reinterpret_cast<const uint8_t *const *>(filterFrame->data),
-                              filterFrame->linesize, 0, static_cast<int>(frameHeight),
-                              convertedFrame->data, convertedFrame->linesize);
+            if (!convertedFrameQueue.pop(convertedFrame, std::chrono::milliseconds(STAGE_TIMEOUT_MS))) {
+                continue;
+            }
 
-                    // copy pts/dts, etc.
-                    av_frame_copy_props(convertedFrame, filterFrame);
+            if (!targetBitrates.empty()) {
+                applyTargetBitrate();
+            }
 
-                    statusCode = encode(encoderContext.codecContext, convertedFrame, encodingPacket);
+            // forced key frame (libx264 and libx265 emit IDR, libvpx - key frame)
+            convertedFrame->pict_type = keyFrameRequestedFlag.exchange(false) ? AV_PICTURE_TYPE_I
+                                                                              : AV_PICTURE_TYPE_NONE;
 
-                    if (statusCode >= 0) {
+            // the encoder may delay frames, remember the capture time to find it by the packet's pts
+            captureTimes[convertedFrame->pts % CAPTURE_TIMES_HISTORY_SIZE] = convertedFrame->best_effort_timestamp;
 
-                        // new encoded data is available (one NALU)
-                        if (onEncodedDataCallback) {
-                            onEncodedDataCallback(std::vector<uint8_t>(encodingPacket->data + NALU_START_CODE_BYTES_NUMBER,
-                                                         encodingPacket->data + encodingPacket->size));
-                        }
-                    }
+            if (sliceEncoder) { // the slices are passed to the callbacks while encoding
 
-                    av_frame_unref(filterFrame);
-                    av_packet_unref(encodingPacket);
+                if (!sliceEncoder->encode(convertedFrame)) {
+                    LOG(WARN) << "Cannot encode " << config.getName() << " frame";
                 }
+
+                freeFrameQueue.tryPush(convertedFrame);
+
+                continue;
+            }
+
+            int statusCode = encode(encoderContext.codecContext, convertedFrame, encodingPacket);
+
+            // the encoder has its own copy of the frame, give it back to the converter
+            freeFrameQueue.tryPush(convertedFrame);
+
+            if (statusCode >= 0) {
+                deliverPacket(encodingPacket, captureTimes[encodingPacket->pts % CAPTURE_TIMES_HISTORY_SIZE],
+                              isNalStream);
             }
 
+            av_packet_unref(encodingPacket);
         }
+    }
 
-        isRunningFlag.store(false);
+    void Transcoder::deliverPacket(AVPacket *packet, int64_t captureTimeUs, bool isNalStream) {
+
+        if (onEncodedDataCallbacks.empty()) {
+            return;
+        }
+
+        // the units share one reference to the packet's data, it stays alive until the last of them is sent
+        AVBufferRef *bufferRef = nullptr;
+
+        if (packet->buf) {
+            bufferRef = av_buffer_ref(packet->buf);
+        } else { // not reference counted (valid until the next packet), copy it once
+            bufferRef = av_buffer_alloc(packet->size);
+            memcpy(bufferRef->data, packet->data, static_cast<size_t>(packet->size));
+        }
+
+        uint8_t const *data = packet->buf ? packet->data : bufferRef->data;
+
+        auto packetBuffer = NalUnit::shareBuffer(bufferRef);
+
+        if (isNalStream) { // e.g. parameter sets and SEI precede the slices of a key frame
+
+            // the packet is the whole access unit, each unit is passed once the next one is found,
+            // so the last one is known to end the frame
+            NalUnit previousUnit;
+
+            lirs::utils::splitNalUnits(data, static_cast<size_t>(packet->size),
+                                       [this, &packetBuffer, captureTimeUs, &previousUnit](uint8_t const *nalData,
+                                                                                            size_t nalSize) {
+                                           if (!previousUnit.empty()) {
+                                               broadcast(std::move(previousUnit), captureTimeUs);
+                                           }
+                                           previousUnit = NalUnit(packetBuffer, nalData, nalSize);
+                                       });
+
+            if (!previousUnit.empty()) {
+                previousUnit.setFrameEnd(true);
+                broadcast(std::move(previousUnit), captureTimeUs);
+            }
+
+        } else { // one frame per packet (VP8, VP9)
+            broadcast(NalUnit(std::move(packetBuffer), data, static_cast<size_t>(packet->size), true), captureTimeUs);
+        }
+    }
+
+    void Transcoder::broadcast(NalUnit &&unit, int64_t captureTimeUs) {
+
+        // the readers share the packet's reference (copying does not allocate), the last one takes the unit itself
+        for (size_t idx = 0; idx + 1 < onEncodedDataCallbacks.size(); ++idx) {
+            onEncodedDataCallbacks[idx](NalUnit(unit), captureTimeUs);
+        }
+
+        onEncodedDataCallbacks.back()(std::move(unit), captureTimeUs);
+    }
+
+    template<typename Disposer>
+    void Transcoder::pushOrDrop(lirs::utils::BoundedQueue<AVFrame *> &queue, AVFrame *frame, Disposer dispose) {
+
+        if (queue.tryPush(frame)) {
+            return;
+        }
+
+        if (dropPolicy == lirs::config::params::DropPolicy::DROP_OLDEST) {
+
+            AVFrame *oldestFrame = nullptr;
+
+            // make room for the new frame
+            if (queue.tryPop(oldestFrame)) {
+                dispose(oldestFrame);
+            }
+
+            if (queue.tryPush(frame)) {
+                return;
+            }
+        }
+
+        dispose(frame);
+    }
+
+    void Transcoder::releaseRawFrame(AVFrame *frame) {
+        input->release(frame); // e.g. re-queue the driver's buffer
+    }
+
+    void Transcoder::releaseQueuedFrames() {
+
+        AVFrame *frame = nullptr;
+
+        while (rawFrameQueue.tryPop(frame)) {
+            releaseRawFrame(frame);
+        }
+
+        while (convertedFrameQueue.tryPop(frame)) {
+            freeFrameQueue.tryPush(frame);
+        }
     }
 
     void Transcoder::stop() {
 
+        // set even if not running yet (the thread may be about to run)
+        needToStopFlag.store(true);
+
         if (!isRunningFlag.load())
             return;
 
-        needToStopFlag.store(true);
+        resumeCondition.notify_all();
 
         // wait
         while (isRunningFlag.load()) {
@@ -121,98 +352,167 @@ namespace LIRS {
         }
     }
 
-    void Transcoder::registerAll() {
+    void Transcoder::pause() {
 
-        LOG(DEBUG) << "Registering ffmpeg stuff";
+        if (isPausedFlag.exchange(true)) {
+            return;
+        }
 
-        av_register_all();
+        LOG(INFO) << config.getName() << " is paused";
+    }
 
-        avdevice_register_all();
+    void Transcoder::resume() {
 
-        avcodec_register_all();
+        if (!isPausedFlag.load()) {
+            return;
+        }
+
+        resumeTimeUs.store(av_gettime());
 
-        avfilter_register_all();
+        // the clients cannot decode the stream until the next key frame otherwise
+        keyFrameRequestedFlag.store(true);
+
+        {
+            std::lock_guard<std::mutex> lock(pauseMutex);
+            isPausedFlag.store(false);
+        }
+
+        resumeCondition.notify_all();
+
+        LOG(INFO) << config.getName() << " is resumed";
     }
 
-    void Transcoder::initializeDecoder() {
+    bool Transcoder::isPaused() const {
+        return isPausedFlag.load();
+    }
 
-        // holds the general information about the format (container)
-        decoderContext.formatContext = avformat_alloc_context();
+    void Transcoder::acquire() {
 
-        LOG(DEBUG) << "Using Video4Linux2 API for decoding raw data";
+        std::lock_guard<std::mutex> lock(readersMutex);
 
-        AVInputFormat *inputFormat = av_find_input_format("v4l2"); // using Video4Linux API for capturing
+        if (numReaders++ > 0) {
+            return;
+        }
 
-        auto frameResolutionStr = lirs::utils::concatParams({config.getInputParams().getWidth(),
-                                                             config.getInputParams().getHeight()}, "x");
+        if (isStarted) {
+            resume();
+            return;
+        }
 
-        auto framerateStr = lirs::utils::concatParams({(size_t) frameRate.num, (size_t) frameRate.den}, "/");
+        isStarted = true;
 
-        AVDictionary *options = nullptr;
+        LOG(DEBUG) << "Starting to capture and encode video from the camera: " << config.getName();
 
-        av_dict_set(&options, "video_size", frameResolutionStr.data(), 0);
-        av_dict_set(&options, "pixel_format", av_get_pix_fmt_name(rawPixFormat), 0);
-        av_dict_set(&options, "framerate", framerateStr.data(), 0);
+        std::thread(&Transcoder::run, this).detach();
+    }
 
-        int statCode = avformat_open_input(&decoderContext.formatContext, config.getResource().c_str(),
-                                           inputFormat, &options);
-        av_dict_free(&options);
-        assert(statCode == 0);
+    void Transcoder::release() {
 
-        // get the info on all available streams
-        statCode = avformat_find_stream_info(decoderContext.formatContext, nullptr);
-        assert(statCode >= 0);
+        std::lock_guard<std::mutex> lock(readersMutex);
 
-        av_dump_format(decoderContext.formatContext, 0, config.getResource().c_str(), 0);
+        if (numReaders == 0 || --numReaders > 0) {
+            return;
+        }
 
-        // find video stream (if multiple video streams are available then you should choose one manually)
-        int videoStreamIndex = av_find_best_stream(decoderContext.formatContext, AVMEDIA_TYPE_VIDEO, -1, -1,
-                                                   &decoderContext.codec, 0);
-        assert(videoStreamIndex >= 0);
-        assert(decoderContext.codec);
-        decoderContext.videoStream = decoderContext.formatContext->streams[videoStreamIndex];
+        pause();
+    }
 
-        // create codec context (for each codec its own codec context)
-        decoderContext.codecContext = avcodec_alloc_context3(decoderContext.codec);
-        assert(decoderContext.codecContext);
+    void Transcoder::waitWhilePaused(int timeoutMs) {
 
-        // copy video stream parameters to the codec context
-        statCode = avcodec_parameters_to_context(decoderContext.codecContext, decoderContext.videoStream->codecpar);
-        assert(statCode >= 0);
+        std::unique_lock<std::mutex> lock(pauseMutex);
 
-        // initialize the codec context to use the created codec context
-        statCode = avcodec_open2(decoderContext.codecContext, decoderContext.codec, &options);
-        assert(statCode == 0);
+        resumeCondition.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] {
+            return !isPausedFlag.load() || needToStopFlag.load();
+        });
+    }
+
+    void Transcoder::registerAll() {
+
+        LOG(DEBUG) << "Registering ffmpeg stuff";
+
+        av_register_all();
+
+        avdevice_register_all();
+
+        avcodec_register_all();
+    }
+
+    void Transcoder::initializeInput() {
+
+        input = VideoInput::create(config);
+
+        if (!input) {
+            LOG(ERROR) << "Cannot open video source: " << config.getResource();
+        }
+
+        assert(input);
 
         // update parameters
-        frameRate = decoderContext.videoStream->r_frame_rate;
-        frameWidth = static_cast<size_t>(decoderContext.codecContext->width);
-        frameHeight = static_cast<size_t>(decoderContext.codecContext->height);
-        rawPixFormat = decoderContext.codecContext->pix_fmt;
-        sourceBitRate = static_cast<size_t>(decoderContext.codecContext->bit_rate);
+        frameRate = input->getFrameRate();
+        frameWidth = static_cast<size_t>(input->getWidth());
+        frameHeight = static_cast<size_t>(input->getHeight());
+        rawPixFormat = input->getPixelFormat();
+
+        auto const &outputFrameRate = config.getOutputParams().getFrameRate();
+
+        frameIntervalUs = 1000000LL * outputFrameRate.second / outputFrameRate.first;
+    }
 
-        LOG(DEBUG) << "Decoder params: width: " << frameWidth << ", height: " << frameHeight << ", pixel_fmt: "
-                   << av_get_pix_fmt_name(rawPixFormat) << ", framerate: " << frameRate.num;
+    void Transcoder::initializePassthrough() {
 
-        // allocate decoding packet
-        decodingPacket = av_packet_alloc();
-        av_init_packet(decodingPacket);
+        packetInput = VideoInput::createPassthrough(config);
 
-        // allocate frame
-        rawFrame = av_frame_alloc();
+        if (!packetInput) {
+            LOG(ERROR) << "Cannot pass through the compressed video of " << config.getResource();
+        }
+
+        assert(packetInput);
+
+        // update parameters
+        frameRate = packetInput->getFrameRate();
+        frameWidth = static_cast<size_t>(packetInput->getWidth());
+        frameHeight = static_cast<size_t>(packetInput->getHeight());
+
+        auto const *packetParameters = packetInput->getPacketParameters();
+
+        initializeParameterSets(packetParameters->extradata, packetParameters->extradata_size);
+
+        LOG(INFO) << config.getName() << " is passed through without transcoding";
     }
 
     void Transcoder::initializeEncoder() {
 
-        LOG(DEBUG) << "Initialize HEVC encoder";
+        auto const &encoderParams = config.getEncoderParams();
+
+        auto encoderName = getEncoderName(encoderParams.getCodec());
+
+        LOG(DEBUG) << "Initialize " << encoderName << " encoder";
+
+        // the slices of the frame are sent before the rest of it is encoded
+        if (encoderParams.getCodec() == lirs::config::params::VideoCodec::H264
+            && (encoderParams.getSlices() > 1 || encoderParams.getSliceMaxSize() > 0) && initializeSliceEncoder()) {
+            return;
+        }
 
         // allocate format context for an output format (null - no output file)
         int statCode = avformat_alloc_output_context2(&encoderContext.formatContext, nullptr, "null", nullptr);
         assert(statCode >= 0);
 
-        encoderContext.codec = avcodec_find_encoder_by_name("libx265");
+        encoderContext.codec = avcodec_find_encoder_by_name(encoderName);
+
+        if (!encoderContext.codec) {
+            LOG(ERROR) << "Encoder is not available (ffmpeg is built without it?): " << encoderName;
+        }
+
         assert(encoderContext.codec);
 
+        if (!isPixelFormatSupported(encoderContext.codec, encoderPixFormat)) {
+            LOG(ERROR) << encoderName << " does not support " << av_get_pix_fmt_name(encoderPixFormat)
+                       << " pixel format (check the output pixel format)";
+        }
+
+        assert(isPixelFormatSupported(encoderContext.codec, encoderPixFormat));
+
         // create new video output stream (dummy)
         encoderContext.videoStream = avformat_new_stream(encoderContext.formatContext, encoderContext.codec);
         assert(encoderContext.videoStream);
@@ -226,46 +526,67 @@ namespace LIRS {
         encoderContext.codecContext->width = static_cast<int>(config.getOutputParams().getWidth());
         encoderContext.codecContext->height = static_cast<int>(config.getOutputParams().getHeight());
 
-        encoderContext.codecContext->profile = FF_PROFILE_HEVC_MAIN;
-
         encoderContext.codecContext->time_base = (AVRational) {1, static_cast<int>(config.getOutputParams().getFrameRate().first)};
         encoderContext.codecContext->framerate = (AVRational) {static_cast<int>(config.getOutputParams().getFrameRate().first), 1};
 
         // set encoder's pixel format (it is advised to use yuv420p)
         encoderContext.codecContext->pix_fmt = encoderPixFormat;
 
-        if (encoderContext.formatContext->flags & AVFMT_GLOBALHEADER) {
+        // the parameter sets are exported as extradata (to describe the stream before encoding), the encoders
+        // are asked to repeat them in the stream as well (see the encoder options)
+        if (encoderParams.getCodec() == lirs::config::params::VideoCodec::H264 ||
+            encoderParams.getCodec() == lirs::config::params::VideoCodec::H265) {
             encoderContext.codecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
         }
 
-        // copy encoder parameters to the video stream parameters
-        avcodec_parameters_from_context(encoderContext.videoStream->codecpar, encoderContext.codecContext);
+        // GOP (understood by all the encoders)
+        if (encoderParams.getKeyint() != lirs::config::params::EncoderParameters::UNSET) {
+            encoderContext.codecContext->gop_size = encoderParams.getKeyint();
+        }
+
+        if (encoderParams.getBframes() != lirs::config::params::EncoderParameters::UNSET) {
+            encoderContext.codecContext->max_b_frames = encoderParams.getBframes();
+        }
 
         AVDictionary *options = nullptr;
 
-        // the faster you get, the less compression is achieved
-        av_dict_set(&options, "preset", config.getEncoderParams().getPreset().c_str(), 0);
+        av_dict_set(&options, "b", lirs::utils::to_string_with_prefix(encoderParams.getBitrate(), "K").data(), 0);
 
-        // optimization for fast encoding and low latency streaming
-        av_dict_set(&options, "tune", config.getEncoderParams().getTune().c_str(), 0);
+        switch (encoderParams.getCodec()) {
 
-        av_dict_set(&options, "b", lirs::utils::to_string_with_prefix(config.getEncoderParams().getBitrate(), "K").data(), 0);
+            case lirs::config::params::VideoCodec::H264:
+                setX264Options(&options);
+                break;
 
-        char x265_params[128];
+            case lirs::config::params::VideoCodec::VP8:
+            case lirs::config::params::VideoCodec::VP9:
+                setVpxOptions(&options);
+                break;
 
-        sprintf(x265_params, "vbv-maxrate=%d:vbv-bufsize=%d",
-                config.getEncoderParams().getBitrate(), config.getEncoderParams().getVbvBufSize());
+            default:
+                setX265Options(&options);
+                break;
+        }
 
-        LOG(INFO) << x265_params;
+        // copy encoder parameters to the video stream parameters
+        avcodec_parameters_from_context(encoderContext.videoStream->codecpar, encoderContext.codecContext);
 
-        // set additional codec options
-        av_opt_set(encoderContext.codecContext->priv_data, "x265-params", x265_params, 0);
+        // threads created by the encoder (e.g. x265 thread pools) inherit the affinity of the opening thread
+        cpu_set_t originalCpuSet;
+        pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &originalCpuSet);
+
+        initializeEncoderAffinity();
 
         // open the output format to use given codec
         statCode = avcodec_open2(encoderContext.codecContext, encoderContext.codec, &options);
         av_dict_free(&options);
+
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &originalCpuSet);
+
         assert(statCode == 0);
 
+        initializeParameterSets(encoderContext.codecContext->extradata, encoderContext.codecContext->extradata_size);
+
         // initializes time base automatically
         statCode = avformat_write_header(encoderContext.formatContext, nullptr);
         assert(statCode >= 0);
@@ -279,109 +600,380 @@ namespace LIRS {
 
     }
 
-    void Transcoder::initializeConverter() {
+    bool Transcoder::initializeSliceEncoder() {
 
-        // allocate frame to be used in converter
-        convertedFrame = av_frame_alloc();
-        convertedFrame->width = static_cast<int>(config.getOutputParams().getWidth());
-        convertedFrame->height = static_cast<int>(config.getOutputParams().getHeight());
-        convertedFrame->format = encoderPixFormat;
-        int statCode = av_frame_get_buffer(convertedFrame, 0); // ref counted frame
-        assert(statCode == 0);
+        // the capture times are found by the pts of the units' frame
+        auto onNalUnit = [this](NalUnit &&unit, int64_t pts) {
+            if (!onEncodedDataCallbacks.empty()) {
+                broadcast(std::move(unit), captureTimes[pts % CAPTURE_TIMES_HISTORY_SIZE]);
+            }
+        };
 
-        // create converter from raw pixel format to encoder supported pixel format
-        converterContext = sws_getCachedContext(nullptr, static_cast<int>(frameWidth), static_cast<int>(frameHeight),
-                                                rawPixFormat,
-                                                convertedFrame->width, convertedFrame->height,
-                                                encoderPixFormat,
-                                                SWS_LANCZOS, nullptr, nullptr, nullptr);
+        cpu_set_t originalCpuSet;
+        pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &originalCpuSet);
+
+        initializeEncoderAffinity();
+
+        sliceEncoder = X264SliceEncoder::create(config, encoderPixFormat, onNalUnit);
+
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &originalCpuSet);
+
+        if (!sliceEncoder) {
+            LOG(WARN) << "Slices of " << config.getName() << " are passed on along with their frame";
+            return false;
+        }
+
+        auto const &headers = sliceEncoder->getHeaders();
+
+        initializeParameterSets(headers.data(), static_cast<int>(headers.size()));
+
+        LOG(INFO) << config.getName() << " slices are passed on as soon as they are encoded (libx264)";
+
+        return true;
     }
 
-    void Transcoder::initFilters() {
+    void Transcoder::initializeParameterSets(uint8_t const *extradata, int size) {
 
-        // allocate filter frame (where the filtered frame will be stored)
-        filterFrame = av_frame_alloc();
+        if (!extradata || size <= 0) {
+            return;
+        }
+
+        auto codec = getCodec();
+
+        auto onNalUnit = [this, codec](uint8_t const *nal, size_t nalSize) {
+
+            if (codec == lirs::config::params::VideoCodec::H264) {
+
+                switch (nal[0] & 0x1F) {
+                    case 7:
+                        parameterSets.sps.assign(nal, nal + nalSize);
+                        break;
+                    case 8:
+                        parameterSets.pps.assign(nal, nal + nalSize);
+                        break;
+                    default: // e.g. SEI
+                        break;
+                }
+
+            } else if (codec == lirs::config::params::VideoCodec::H265) {
+
+                switch ((nal[0] >> 1) & 0x3F) {
+                    case 32:
+                        parameterSets.vps.assign(nal, nal + nalSize);
+                        break;
+                    case 33:
+                        parameterSets.sps.assign(nal, nal + nalSize);
+                        break;
+                    case 34:
+                        parameterSets.pps.assign(nal, nal + nalSize);
+                        break;
+                    default:
+                        break;
+                }
+            }
+        };
 
-        // create buffer source and sink
-        AVFilter *bufferSrc = avfilter_get_by_name("buffer");
-        AVFilter *bufferSink = avfilter_get_by_name("buffersink");
+        lirs::utils::splitNalUnits(extradata, static_cast<size_t>(size), onNalUnit);
 
-        AVFilterInOut *outputs = avfilter_inout_alloc();
-        AVFilterInOut *inputs = avfilter_inout_alloc();
+        LOG(DEBUG) << config.getName() << " parameter sets (bytes): VPS " << parameterSets.vps.size()
+                   << ", SPS " << parameterSets.sps.size() << ", PPS " << parameterSets.pps.size();
+    }
 
-        // allocate filter graph
-        filterGraph = avfilter_graph_alloc();
+    void Transcoder::setX265Options(AVDictionary **options) {
 
-        char args[128];
-        snprintf(args, sizeof(args), "width=%d:height=%d:pix_fmt=%d:time_base=%d/%d:sar=%d/%d:frame_rate=%d/%d",
-                 (int) frameWidth, (int) frameHeight, rawPixFormat, decoderContext.videoStream->time_base.num,
-                 decoderContext.videoStream->time_base.den, decoderContext.videoStream->sample_aspect_ratio.num,
-                 decoderContext.videoStream->sample_aspect_ratio.den, frameRate.num, frameRate.den);
+        auto const &encoderParams = config.getEncoderParams();
 
-        // create buffer source with the specified params
-        auto status = avfilter_graph_create_filter(&bufferSrcCtx, bufferSrc, "in", args, nullptr, filterGraph);
-        assert(status >= 0);
+        encoderContext.codecContext->profile = FF_PROFILE_HEVC_MAIN;
 
-        // create buffer sink
-        status = avfilter_graph_create_filter(&bufferSinkCtx, bufferSink, "out", nullptr, nullptr, filterGraph);
-        assert(status >= 0);
+        // the faster you get, the less compression is achieved
+        av_dict_set(options, "preset", encoderParams.getPreset().c_str(), 0);
 
-        outputs->name = av_strdup("in");
-        outputs->filter_ctx = bufferSrcCtx;
-        outputs->pad_idx = 0;
-        outputs->next = nullptr;
+        // optimization for fast encoding and low latency streaming
+        av_dict_set(options, "tune", encoderParams.getTune().c_str(), 0);
 
-        inputs->name = av_strdup("out");
-        inputs->filter_ctx = bufferSinkCtx;
-        inputs->pad_idx = 0;
-        inputs->next = nullptr;
+        std::ostringstream x265Params;
 
-        // create filter query
-        char frameStepFilterQuery[16];
+        x265Params << "vbv-maxrate=" << encoderParams.getBitrate() << ":vbv-bufsize=" << encoderParams.getVbvBufSize();
 
-        if (this->filterQuery.empty()) {
+        // threading: do not let the thread pools of several cameras oversubscribe all the cores
+        if (!encoderParams.getPools().empty()) {
+            x265Params << ":pools=" << encoderParams.getPools();
+        } else if (encoderParams.getNumaNode() != lirs::config::params::EncoderParameters::UNSET) {
 
-            snprintf(frameStepFilterQuery, sizeof(frameStepFilterQuery), "fps=fps=%d/%d",
-                     static_cast<int>(config.getOutputParams().getFrameRate().first), 1);
+            // e.g. "-,+" - no threads on the node 0, all the node's 1 cores
+            x265Params << ":pools=";
 
-            // add graph represented by the filter query
-            status = avfilter_graph_parse(filterGraph, frameStepFilterQuery, inputs, outputs, nullptr);
-            assert(status >= 0);
+            for (int node = 0; node < encoderParams.getNumaNode(); ++node) {
+                x265Params << "-,";
+            }
 
-        } else {
+            x265Params << "+";
+        }
 
-            status = avfilter_graph_parse(filterGraph, filterQuery.c_str(), inputs, outputs, nullptr);
-            assert(status >= 0);
+        if (encoderParams.getFrameThreads() != lirs::config::params::EncoderParameters::UNSET) {
+            x265Params << ":frame-threads=" << encoderParams.getFrameThreads();
         }
 
-        status = avfilter_graph_config(filterGraph, nullptr);
-        assert(status >= 0);
+        x265Params << ":wpp=" << (encoderParams.isWppEnabled() ? 1 : 0);
+
+        if (encoderParams.getLookaheadSlices() != lirs::config::params::EncoderParameters::UNSET) {
+            x265Params << ":lookahead-slices=" << encoderParams.getLookaheadSlices();
+        }
+
+        // GOP and lookahead
+        if (encoderParams.getKeyint() != lirs::config::params::EncoderParameters::UNSET) {
+            x265Params << ":keyint=" << encoderParams.getKeyint();
+        }
+
+        if (encoderParams.getBframes() != lirs::config::params::EncoderParameters::UNSET) {
+            x265Params << ":bframes=" << encoderParams.getBframes();
+        }
+
+        if (encoderParams.getRcLookahead() != lirs::config::params::EncoderParameters::UNSET) {
+            x265Params << ":rc-lookahead=" << encoderParams.getRcLookahead();
+        }
+
+        int slices = encoderParams.getSlices();
+
+        if (encoderParams.getSliceMaxSize() > 0) {
+
+            // x265 cannot limit the slice size, split the average frame into slices fitting the limit
+            auto const &frameRate = config.getOutputParams().getFrameRate();
+
+            int64_t frameSize = encoderParams.getBitrate() * 1000LL / 8 * frameRate.second / frameRate.first;
+
+            auto fittingSlices = static_cast<int>((frameSize + encoderParams.getSliceMaxSize() - 1) /
+                                                  encoderParams.getSliceMaxSize());
+
+            // at most one slice per CTU row
+            int maxSlices = (config.getOutputParams().getHeight() + X265_CTU_SIZE - 1) / X265_CTU_SIZE;
+
+            slices = std::max(slices, std::min(fittingSlices, maxSlices));
+        }
+
+        if (slices > 0) {
+            x265Params << ":slices=" << slices;
+        }
+
+        if (encoderParams.isIntraRefreshEnabled()) { // periodic intra refresh instead of key frames
+            x265Params << ":intra-refresh=1";
+        }
+
+        // the parameter sets are repeated before each key frame (not only exported as extradata)
+        x265Params << ":repeat-headers=1";
+
+        // requested key frames (I frames) are IDR frames whenever requested (not CRA or non-key I frames)
+        if (encoderParams.getKeyFrameRequestWindowMs() > 0) {
+            x265Params << ":open-gop=0:min-keyint=1";
+        }
+
+        LOG(INFO) << x265Params.str();
+
+        // set additional codec options
+        av_opt_set(encoderContext.codecContext->priv_data, "x265-params", x265Params.str().c_str(), 0);
     }
 
-    int Transcoder::decode(AVCodecContext *codecContext, AVFrame *frame, AVPacket *packet) {
+    void Transcoder::setX264Options(AVDictionary **options) {
 
-        // send a packet to be filled with raw data
-        int statCode = avcodec_send_packet(codecContext, packet);
+        auto const &encoderParams = config.getEncoderParams();
 
-        if (statCode < 0) {
-//            LOG(ERROR) << "Error sending a packet for decoding: " << config.get_streaming_source();
-            return statCode;
+        av_dict_set(options, "preset", encoderParams.getPreset().c_str(), 0);
+
+        av_dict_set(options, "tune", encoderParams.getTune().c_str(), 0);
+
+        // VBV (kbps -> bps)
+        encoderContext.codecContext->rc_max_rate = encoderParams.getBitrate() * 1000LL;
+        encoderContext.codecContext->rc_buffer_size = encoderParams.getVbvBufSize() * 1000;
+
+        if (encoderParams.getRcLookahead() != lirs::config::params::EncoderParameters::UNSET) {
+            av_dict_set_int(options, "rc-lookahead", encoderParams.getRcLookahead(), 0);
         }
 
-        // receive decoded raw frame
-        statCode = avcodec_receive_frame(codecContext, frame);
+        if (encoderParams.getSlices() > 0) {
+            encoderContext.codecContext->slices = encoderParams.getSlices();
+        }
 
-        if (statCode == AVERROR(EAGAIN) || statCode == AVERROR_EOF) {
-//            LOG(WARN) << "No frames available or end of file has been reached";
-            return statCode;
+        if (encoderParams.isIntraRefreshEnabled()) {
+            av_dict_set(options, "intra-refresh", "1", 0);
         }
 
-        if (statCode < 0) {
-//            LOG(ERROR) << "Error during decoding";
-            return statCode;
+        // requested key frames are IDR frames
+        av_dict_set(options, "forced-idr", "1", 0);
+
+        // the parameter sets are repeated before each key frame (not only exported as extradata)
+        std::string x264Params = "repeat-headers=1";
+
+        // each slice NAL unit fits an RTP packet (no fragmentation units)
+        if (encoderParams.getSliceMaxSize() > 0) {
+            x264Params += ":slice-max-size=" + std::to_string(encoderParams.getSliceMaxSize());
         }
 
-        return true;
+        av_dict_set(options, "x264-params", x264Params.c_str(), 0);
+    }
+
+    void Transcoder::applyTargetBitrate() {
+
+        uint16_t targetBitrate = 0;
+
+        for (auto const &controllerBitrate : targetBitrates) {
+
+            auto askedBitrate = controllerBitrate.load();
+
+            if (askedBitrate > 0 && (targetBitrate == 0 || askedBitrate < targetBitrate)) {
+                targetBitrate = askedBitrate;
+            }
+        }
+
+        if (targetBitrate == 0) {
+            targetBitrate = config.getEncoderParams().getBitrate();
+        }
+
+        if (targetBitrate == lastTargetBitrate) {
+            return;
+        }
+
+        lastTargetBitrate = targetBitrate;
+
+        if (!reconfigureBitrate(targetBitrate)) {
+            LOG(WARN) << "Cannot change " << config.getName() << " encoder's bitrate to " << targetBitrate << " (kbps)";
+            return;
+        }
+
+        LOG(INFO) << config.getName() << " encoder's bitrate is changed from " << bitrate.load() << " to "
+                  << targetBitrate << " (kbps)";
+
+        bitrate.store(targetBitrate);
+    }
+
+    bool Transcoder::reconfigureBitrate(uint16_t targetBitrate) {
+
+        auto const &encoderParams = config.getEncoderParams();
+
+        auto codecContext = encoderContext.codecContext;
+
+        // the VBV buffer holds the same time of the stream
+        auto vbvBufSize = std::max<int64_t>(encoderParams.getVbvBufSize() * static_cast<int64_t>(targetBitrate)
+                                            / std::max<uint16_t>(encoderParams.getBitrate(), 1), 1);
+
+        switch (encoderParams.getCodec()) {
+
+            case lirs::config::params::VideoCodec::H264:
+
+                if (sliceEncoder) {
+                    return sliceEncoder->reconfigureBitrate(targetBitrate, static_cast<int>(vbvBufSize));
+                }
+
+                // libx264 wrapper reconfigures the encoder when these are changed between the frames (kbps -> bps)
+                codecContext->bit_rate = targetBitrate * 1000LL;
+                codecContext->rc_max_rate = targetBitrate * 1000LL;
+                codecContext->rc_buffer_size = static_cast<int>(vbvBufSize * 1000);
+
+                return true;
+
+            default: // libx265 and libvpx wrappers apply the rate control settings when the encoder is opened only
+                return false;
+        }
+    }
+
+    void Transcoder::initializeEncoderAffinity() {
+
+        auto const &encoderParams = config.getEncoderParams();
+
+        encoderCpus = encoderParams.getCpuAffinity();
+
+        if (encoderCpus.empty() && encoderParams.getNumaNode() != lirs::config::params::EncoderParameters::UNSET) {
+
+            encoderCpus = lirs::utils::getNumaNodeCpus(encoderParams.getNumaNode());
+
+            if (encoderCpus.empty()) {
+                LOG(WARN) << "Unknown NUMA node: " << encoderParams.getNumaNode();
+            }
+        }
+
+        if (encoderCpus.empty()) {
+            return;
+        }
+
+        if (!lirs::utils::setThreadAffinity(encoderCpus)) {
+
+            LOG(WARN) << "Cannot bind " << config.getName() << " encoder's threads to the specified CPUs";
+
+            encoderCpus.clear();
+
+            return;
+        }
+
+        LOG(INFO) << config.getName() << " encoder's threads are bound to " << encoderCpus.size() << " CPU(s)";
+    }
+
+    void Transcoder::setVpxOptions(AVDictionary **options) {
+
+        auto const &encoderParams = config.getEncoderParams();
+
+        // realtime mode: no frame lagging, the fastest speed settings
+        av_dict_set(options, "deadline", "realtime", 0);
+        av_dict_set(options, "lag-in-frames", "0", 0);
+        av_dict_set_int(options, "cpu-used", VPX_CPU_USED, 0);
+
+        // decoders may recover from the lost packets
+        av_dict_set(options, "error-resilient", "1", 0);
+
+        // VBV (kbps -> bps)
+        encoderContext.codecContext->rc_max_rate = encoderParams.getBitrate() * 1000LL;
+        encoderContext.codecContext->rc_buffer_size = encoderParams.getVbvBufSize() * 1000;
+    }
+
+    const char *Transcoder::getEncoderName(lirs::config::params::VideoCodec codec) {
+
+        switch (codec) {
+            case lirs::config::params::VideoCodec::H264:
+                return "libx264";
+            case lirs::config::params::VideoCodec::VP8:
+                return "libvpx";
+            case lirs::config::params::VideoCodec::VP9:
+                return "libvpx-vp9";
+            default:
+                return "libx265";
+        }
+    }
+
+    bool Transcoder::isPixelFormatSupported(AVCodec const *codec, AVPixelFormat pixelFormat) {
+
+        if (!codec->pix_fmts) { // unknown
+            return true;
+        }
+
+        for (auto pixFmt = codec->pix_fmts; *pixFmt != AV_PIX_FMT_NONE; ++pixFmt) {
+            if (*pixFmt == pixelFormat) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void Transcoder::initializeConverter() {
+
+        int width = static_cast<int>(config.getOutputParams().getWidth());
+        int height = static_cast<int>(config.getOutputParams().getHeight());
+
+        // allocate frames circulating between the converter and the encoder
+        for (size_t idx = 0; idx < freeFrameQueue.capacity(); ++idx) {
+
+            AVFrame *convertedFrame = av_frame_alloc();
+            convertedFrame->width = width;
+            convertedFrame->height = height;
+            convertedFrame->format = encoderPixFormat;
+            int statCode = av_frame_get_buffer(convertedFrame, 0); // ref counted frame
+            assert(statCode == 0);
+
+            freeFrameQueue.tryPush(convertedFrame);
+        }
+
+        // create converter from raw pixel format to encoder supported pixel format
+        converterContext = sws_getCachedContext(nullptr, static_cast<int>(frameWidth), static_cast<int>(frameHeight),
+                                                rawPixFormat, width, height, encoderPixFormat,
+                                                SWS_LANCZOS, nullptr, nullptr, nullptr);
     }
 
     int Transcoder::encode(AVCodecContext *codecContext, AVFrame *frame, AVPacket *packet) {
@@ -413,43 +1005,100 @@ namespace LIRS {
 
     void Transcoder::cleanup() {
 
-        avfilter_graph_free(&filterGraph);
-
         // close dummy file
-        avio_close(encoderContext.formatContext->pb);
+        if (encoderContext.formatContext) {
+            avio_close(encoderContext.formatContext->pb);
+        }
 
         // cleanup converter
         sws_freeContext(converterContext);
 
-        // cleanup packets used for decoding and encoding
-        av_packet_free(&decodingPacket);
+        // cleanup packet used for encoding
         av_packet_free(&encodingPacket);
 
-        // cleanup frames for decoding and encoding
-        av_frame_free(&rawFrame);
-        av_frame_free(&convertedFrame);
-        av_frame_free(&filterFrame);
+        sliceEncoder.reset();
 
-        // cleanup decoder and encoder codec contexts
-        avcodec_free_context(&decoderContext.codecContext);
-        avcodec_free_context(&encoderContext.codecContext);
+        releaseQueuedFrames();
+
+        AVFrame *convertedFrame = nullptr;
+
+        while (freeFrameQueue.tryPop(convertedFrame)) {
+            av_frame_free(&convertedFrame);
+        }
 
-        // close input format for the video device
-        avformat_close_input(&decoderContext.formatContext);
+        // close the video source (e.g. stop streaming, unmap buffers)
+        input.reset();
+        packetInput.reset();
 
-        // cleanup decoder and encoder format contexts
-        avformat_free_context(decoderContext.formatContext);
+        // cleanup encoder codec context
+        avcodec_free_context(&encoderContext.codecContext);
+
+        // cleanup encoder format context
         avformat_free_context(encoderContext.formatContext);
 
         // reset all class members
-        decoderContext = {};
         encoderContext = {};
 
         LOG(DEBUG) << "Cleanup transcoder!";
     }
 
-    void Transcoder::setOnEncodedDataCallback(std::function<void(std::vector<uint8_t> &&)> callback) {
-        onEncodedDataCallback = std::move(callback);
+    void Transcoder::addOnEncodedDataCallback(std::function<void(NalUnit &&, int64_t)> callback) {
+        onEncodedDataCallbacks.push_back(std::move(callback));
+    }
+
+    lirs::config::params::VideoCodec Transcoder::getCodec() const {
+        return config.isPassthroughEnabled() ? config.getPassthroughCodec() : config.getEncoderParams().getCodec();
+    }
+
+    bool Transcoder::requestKeyFrame() {
+
+        auto windowUs = config.getEncoderParams().getKeyFrameRequestWindowMs() * 1000LL;
+
+        if (config.isPassthroughEnabled() || windowUs == 0) {
+            return false;
+        }
+
+        int64_t nowUs = av_gettime_relative();
+
+        int64_t lastRequestUs = lastKeyFrameRequestUs.load();
+
+        // coalesce the requests of the clients joining at once
+        if (lastRequestUs != AV_NOPTS_VALUE && nowUs - lastRequestUs < windowUs) {
+            return false;
+        }
+
+        if (!lastKeyFrameRequestUs.compare_exchange_strong(lastRequestUs, nowUs)) {
+            return false; // requested concurrently
+        }
+
+        keyFrameRequestedFlag.store(true);
+
+        LOG(DEBUG) << "Key frame is requested: " << config.getName();
+
+        return true;
+    }
+
+    size_t Transcoder::addRateController() {
+
+        targetBitrates.emplace_back(0);
+
+        return targetBitrates.size() - 1;
+    }
+
+    void Transcoder::setTargetBitrate(size_t controllerId, uint16_t bitrate) {
+        targetBitrates[controllerId].store(bitrate);
+    }
+
+    uint16_t Transcoder::getBitrate() const {
+        return bitrate.load();
+    }
+
+    bool Transcoder::isBitrateAdjustable() const {
+        return !config.isPassthroughEnabled() && getCodec() == lirs::config::params::VideoCodec::H264;
+    }
+
+    ParameterSets const &Transcoder::getParameterSets() const {
+        return parameterSets;
     }
 
     const bool Transcoder::isRunning() const {
@@ -1,5 +1,14 @@
 #include "utils/Utils.hpp"
+#include <cstdlib>
 #include <sstream>
+#include <fstream>
+#include <ctime>
+#include <pthread.h>
+#include <sched.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace lirs {
 
@@ -18,5 +27,170 @@ namespace lirs {
         std::string to_string_with_prefix(size_t val, std::string prefix) {
             return std::to_string(val).append(prefix);
         }
+
+        int64_t toWallClockUs(int64_t timestampUs) {
+
+            timespec realTime{};
+            timespec monotonicTime{};
+
+            clock_gettime(CLOCK_REALTIME, &realTime);
+            clock_gettime(CLOCK_MONOTONIC, &monotonicTime);
+
+            int64_t realTimeUs = realTime.tv_sec * 1000000LL + realTime.tv_nsec / 1000;
+            int64_t monotonicTimeUs = monotonicTime.tv_sec * 1000000LL + monotonicTime.tv_nsec / 1000;
+
+            if (std::llabs(timestampUs - realTimeUs) <= std::llabs(timestampUs - monotonicTimeUs)) {
+                return timestampUs; // already the wall clock time
+            }
+
+            return timestampUs + (realTimeUs - monotonicTimeUs);
+        }
+
+        uint8_t const *findStartCode(uint8_t const *begin, uint8_t const *end) {
+
+            auto ptr = begin;
+
+#ifdef __SSE2__
+            // check 16 candidate positions at once: bytes [i], [i + 1], [i + 2] are 0x00, 0x00, 0x01
+            const __m128i zeros = _mm_setzero_si128();
+            const __m128i ones = _mm_set1_epi8(1);
+
+            for (; ptr + 18 <= end; ptr += 16) {
+
+                auto first = _mm_loadu_si128(reinterpret_cast<__m128i const *>(ptr));
+                auto second = _mm_loadu_si128(reinterpret_cast<__m128i const *>(ptr + 1));
+
+                // most of the blocks have no zero bytes at all
+                auto zeroMask = _mm_movemask_epi8(_mm_cmpeq_epi8(first, zeros));
+
+                if (zeroMask == 0) {
+                    continue;
+                }
+
+                auto third = _mm_loadu_si128(reinterpret_cast<__m128i const *>(ptr + 2));
+
+                auto startCodeMask = _mm_movemask_epi8(_mm_and_si128(
+                        _mm_and_si128(_mm_cmpeq_epi8(first, zeros), _mm_cmpeq_epi8(second, zeros)),
+                        _mm_cmpeq_epi8(third, ones)));
+
+                if (startCodeMask != 0) {
+                    return ptr + __builtin_ctz(static_cast<unsigned int>(startCodeMask));
+                }
+            }
+#endif
+
+            // scalar search (the tail or no SIMD)
+            for (; ptr + 2 < end; ++ptr) {
+
+                if (ptr[2] > 1) { // the start code cannot end at ptr[0], ptr[1] or ptr[2]
+                    ptr += 2;
+                } else if (ptr[0] == 0 && ptr[1] == 0 && ptr[2] == 1) {
+                    return ptr;
+                }
+            }
+
+            return end;
+        }
+
+        bool isKeyFrameStart(lirs::config::params::VideoCodec codec, uint8_t const *data, size_t size) {
+
+            using lirs::config::params::VideoCodec;
+
+            if (size == 0) {
+                return false;
+            }
+
+            switch (codec) {
+
+                case VideoCodec::H264: {
+
+                    auto nalType = data[0] & 0x1F;
+
+                    return nalType == 7 || nalType == 5; // SPS, IDR
+                }
+
+                case VideoCodec::H265: {
+
+                    auto nalType = (data[0] >> 1) & 0x3F;
+
+                    return nalType == 32 || nalType == 33 || (nalType >= 16 && nalType <= 21); // VPS, SPS, IRAP
+                }
+
+                case VideoCodec::VP8:
+                    return (data[0] & 0x01) == 0; // frame tag's frame type (0 - key frame)
+
+                case VideoCodec::VP9: {
+
+                    // uncompressed header: frame marker (2 bits), profile (2 bits, reserved zero bit for profile 3),
+                    // show existing frame (1 bit), frame type (1 bit, 0 - key frame)
+
+                    auto profile = ((data[0] >> 5) & 0x01) | ((data[0] >> 3) & 0x02);
+
+                    int bit = profile == 3 ? 2 : 3;
+
+                    if ((data[0] >> bit) & 0x01) { // shows the frame decoded before
+                        return false;
+                    }
+
+                    return ((data[0] >> (bit - 1)) & 0x01) == 0;
+                }
+
+                default:
+                    return false;
+            }
+        }
+
+        std::vector<uint16_t> parseCpuList(std::string const &cpuList) {
+
+            std::vector<uint16_t> cpus;
+
+            std::stringstream cpuListStream(cpuList);
+
+            std::string range;
+
+            while (std::getline(cpuListStream, range, ',')) {
+
+                if (range.empty()) {
+                    continue;
+                }
+
+                auto dashPos = range.find('-');
+
+                auto first = static_cast<uint16_t>(std::stoul(range.substr(0, dashPos)));
+                auto last = dashPos == std::string::npos ? first :
+                            static_cast<uint16_t>(std::stoul(range.substr(dashPos + 1)));
+
+                for (auto cpu = first; cpu <= last; ++cpu) {
+                    cpus.push_back(cpu);
+                }
+            }
+
+            return cpus;
+        }
+
+        std::vector<uint16_t> getNumaNodeCpus(int numaNode) {
+
+            std::ifstream cpuListFile("/sys/devices/system/node/node" + std::to_string(numaNode) + "/cpulist");
+
+            std::string cpuList;
+
+            if (!std::getline(cpuListFile, cpuList)) {
+                return {};
+            }
+
+            return parseCpuList(cpuList);
+        }
+
+        bool setThreadAffinity(std::vector<uint16_t> const &cpus) {
+
+            cpu_set_t cpuSet;
+            CPU_ZERO(&cpuSet);
+
+            for (auto cpu : cpus) {
+                CPU_SET(cpu, &cpuSet);
+            }
+
+            return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet) == 0;
+        }
     }
 }
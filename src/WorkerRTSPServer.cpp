@@ -0,0 +1,35 @@
+#include "WorkerRTSPServer.hpp"
+
+#include <GroupsockHelper.hh>
+
+namespace LIRS {
+
+    namespace {
+
+        /**
+         * Seconds of inactivity after which the client's session is reclaimed (Live555's default).
+         */
+        constexpr unsigned RECLAMATION_SECONDS = 65;
+    }
+
+    WorkerRTSPServer *WorkerRTSPServer::createNew(UsageEnvironment &env, Port ourPort) {
+        return new WorkerRTSPServer(env, ourPort);
+    }
+
+    WorkerRTSPServer::WorkerRTSPServer(UsageEnvironment &env, Port ourPort)
+            : RTSPServer(env, -1, ourPort, nullptr, RECLAMATION_SECONDS) {}
+
+    int WorkerRTSPServer::setUpListeningSocket(UsageEnvironment &env, Port ourPort) {
+        return setUpOurSocket(env, ourPort);
+    }
+
+    void WorkerRTSPServer::addClientConnection(int clientSocket, struct sockaddr_in clientAddr) {
+
+        // see GenericMediaServer::incomingConnectionHandlerOnSocket
+        ignoreSigPipeOnSocket(clientSocket);
+        makeSocketNonBlocking(clientSocket);
+        increaseSendBufferTo(envir(), clientSocket, 50 * 1024);
+
+        createNewClientConnection(clientSocket, clientAddr);
+    }
+}
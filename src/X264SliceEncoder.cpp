@@ -0,0 +1,302 @@
+#include "X264SliceEncoder.hpp"
+#include "utils/Logger.hpp"
+
+#ifdef LIRS_WITH_X264
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+extern "C" {
+#include <x264.h>
+#include <libavutil/buffer.h>
+#include <libavutil/pixdesc.h>
+}
+
+namespace LIRS {
+
+    namespace {
+
+        /**
+         * Returns x264's colorspace and the number of planes of the pixel format (colorspace 0 - not supported).
+         */
+        std::pair<int, int> toColorspace(AVPixelFormat pixelFormat) {
+
+            switch (pixelFormat) {
+                case AV_PIX_FMT_YUV420P:
+                    return {X264_CSP_I420, 3};
+                case AV_PIX_FMT_NV12:
+                    return {X264_CSP_NV12, 2};
+                case AV_PIX_FMT_YUV422P:
+                    return {X264_CSP_I422, 3};
+                case AV_PIX_FMT_YUV444P:
+                    return {X264_CSP_I444, 3};
+                default:
+                    return {0, 0};
+            }
+        }
+
+        /**
+         * Returns the size of the buffer x264_nal_encode needs to encapsulate the payload.
+         */
+        int getEncapsulatedSize(int payloadSize) {
+            return payloadSize * 3 / 2 + 5 + 64;
+        }
+    }
+
+    std::unique_ptr<X264SliceEncoder> X264SliceEncoder::create(lirs::config::params::CameraParameters const &config,
+                                                               AVPixelFormat pixelFormat, Callback onNalUnit) {
+
+        auto const &encoderParams = config.getEncoderParams();
+        auto const &outputParams = config.getOutputParams();
+
+        auto colorspace = toColorspace(pixelFormat);
+
+        if (colorspace.first == 0) {
+            LOG(ERROR) << "libx264 does not support " << av_get_pix_fmt_name(pixelFormat) << " pixel format";
+            return nullptr;
+        }
+
+        x264_param_t params;
+
+        if (x264_param_default_preset(&params, encoderParams.getPreset().c_str(),
+                                      encoderParams.getTune().c_str()) < 0) {
+            LOG(ERROR) << "Unknown libx264 preset or tune: " << encoderParams.getPreset() << ", "
+                       << encoderParams.getTune();
+            return nullptr;
+        }
+
+        params.i_log_level = X264_LOG_WARNING;
+
+        params.i_width = static_cast<int>(outputParams.getWidth());
+        params.i_height = static_cast<int>(outputParams.getHeight());
+        params.i_csp = colorspace.first;
+
+        // the same time base as the one of the libavcodec's encoder (frame numbers)
+        params.i_fps_num = outputParams.getFrameRate().first;
+        params.i_fps_den = 1;
+        params.i_timebase_num = 1;
+        params.i_timebase_den = outputParams.getFrameRate().first;
+        params.b_vfr_input = 0;
+
+        // the callback does not work with the frame threads, a single thread keeps the units in order
+        params.i_threads = 1;
+        params.b_sliced_threads = 0;
+
+        // rate control and VBV (kbps)
+        params.rc.i_rc_method = X264_RC_ABR;
+        params.rc.i_bitrate = encoderParams.getBitrate();
+        params.rc.i_vbv_max_bitrate = encoderParams.getBitrate();
+        params.rc.i_vbv_buffer_size = encoderParams.getVbvBufSize();
+
+        if (encoderParams.getRcLookahead() != lirs::config::params::EncoderParameters::UNSET) {
+            params.rc.i_lookahead = encoderParams.getRcLookahead();
+        }
+
+        if (encoderParams.getKeyint() != lirs::config::params::EncoderParameters::UNSET) {
+            params.i_keyint_max = encoderParams.getKeyint();
+        }
+
+        if (encoderParams.getBframes() != lirs::config::params::EncoderParameters::UNSET) {
+            params.i_bframe = encoderParams.getBframes();
+        }
+
+        if (encoderParams.getSlices() > 0) {
+            params.i_slice_count = encoderParams.getSlices();
+        }
+
+        if (encoderParams.getSliceMaxSize() > 0) {
+            params.i_slice_max_size = encoderParams.getSliceMaxSize();
+        }
+
+        if (encoderParams.isIntraRefreshEnabled()) {
+            params.b_intra_refresh = 1;
+        }
+
+        // the parameter sets are repeated before each key frame
+        params.b_repeat_headers = 1;
+        params.b_annexb = 1;
+
+        // the parameter sets are taken from an encoder without the callback
+        // (x264_encoder_headers passes them to the callback, but there is no frame to take the opaque from)
+        x264_t *headersEncoder = x264_encoder_open(&params);
+
+        if (!headersEncoder) {
+            LOG(ERROR) << "Cannot open libx264 encoder";
+            return nullptr;
+        }
+
+        x264_nal_t *nals = nullptr;
+        int numNals = 0;
+
+        int headersSize = x264_encoder_headers(headersEncoder, &nals, &numNals);
+
+        std::vector<uint8_t> headers;
+
+        if (headersSize > 0 && numNals > 0) { // the payloads are contiguous
+            headers.assign(nals[0].p_payload, nals[0].p_payload + headersSize);
+        }
+
+        x264_encoder_close(headersEncoder);
+
+        params.nalu_process = X264SliceEncoder::handleNalUnit0;
+
+        int maxSliceSize = encoderParams.getSliceMaxSize();
+
+        if (maxSliceSize == 0) { // the average slice at the configured bitrate
+
+            auto const &frameRate = outputParams.getFrameRate();
+
+            int64_t frameSize = encoderParams.getBitrate() * 1000LL / 8 * frameRate.second / frameRate.first;
+
+            maxSliceSize = static_cast<int>(frameSize / std::max<int>(encoderParams.getSlices(), 1));
+        }
+
+        int numMacroblocks = ((params.i_width + 15) / 16) * ((params.i_height + 15) / 16);
+
+        std::unique_ptr<X264SliceEncoder> sliceEncoder(new X264SliceEncoder(std::move(onNalUnit), colorspace.first,
+                                                                            colorspace.second, numMacroblocks,
+                                                                            getEncapsulatedSize(maxSliceSize)));
+
+        if (!sliceEncoder->bufferPool) {
+            LOG(ERROR) << "Cannot allocate a buffer pool for the encoded units";
+            return nullptr;
+        }
+
+        sliceEncoder->headers = std::move(headers);
+
+        sliceEncoder->encoder = x264_encoder_open(&params);
+
+        if (!sliceEncoder->encoder) {
+            LOG(ERROR) << "Cannot open libx264 encoder";
+            return nullptr;
+        }
+
+        return sliceEncoder;
+    }
+
+    X264SliceEncoder::X264SliceEncoder(Callback onNalUnit, int colorspace, int numPlanes, int numMacroblocks,
+                                       int bufferSize)
+            : encoder(nullptr), onNalUnit(std::move(onNalUnit)), colorspace(colorspace), numPlanes(numPlanes),
+              numMacroblocks(numMacroblocks), frames(FRAMES_HISTORY_SIZE, FrameInfo{this, 0}),
+              bufferPool(av_buffer_pool_init(bufferSize, nullptr)), bufferSize(bufferSize) {}
+
+    X264SliceEncoder::~X264SliceEncoder() {
+
+        if (encoder) {
+            x264_encoder_close(encoder);
+        }
+
+        // the pool is freed once the units still in use return their buffers
+        av_buffer_pool_uninit(&bufferPool);
+    }
+
+    bool X264SliceEncoder::encode(AVFrame const *frame) {
+
+        x264_picture_t picture;
+        x264_picture_init(&picture);
+
+        picture.img.i_csp = colorspace;
+        picture.img.i_plane = numPlanes;
+
+        for (int plane = 0; plane < numPlanes; ++plane) {
+            picture.img.plane[plane] = frame->data[plane];
+            picture.img.i_stride[plane] = frame->linesize[plane];
+        }
+
+        picture.i_pts = frame->pts;
+
+        // forced key frame (as libavcodec's libx264 with forced-idr)
+        picture.i_type = frame->pict_type == AV_PICTURE_TYPE_I ? X264_TYPE_IDR : X264_TYPE_AUTO;
+
+        // the units of the frame are passed along with its pts (the frame may be delayed by the encoder)
+        auto &frameInfo = frames[frame->pts % FRAMES_HISTORY_SIZE];
+        frameInfo.pts = frame->pts;
+        picture.opaque = &frameInfo;
+
+        x264_nal_t *nals = nullptr;
+        int numNals = 0;
+
+        x264_picture_t encodedPicture;
+
+        // the units are passed to the callback while encoding, not returned
+        return x264_encoder_encode(encoder, &nals, &numNals, &picture, &encodedPicture) >= 0;
+    }
+
+    bool X264SliceEncoder::reconfigureBitrate(uint16_t bitrate, int vbvBufSize) {
+
+        x264_param_t params;
+
+        x264_encoder_parameters(encoder, &params);
+
+        params.rc.i_bitrate = bitrate;
+        params.rc.i_vbv_max_bitrate = bitrate;
+        params.rc.i_vbv_buffer_size = vbvBufSize;
+
+        return x264_encoder_reconfig(encoder, &params) >= 0;
+    }
+
+    void X264SliceEncoder::handleNalUnit0(x264_t *h, x264_nal_t *nal, void *opaque) {
+
+        auto frameInfo = static_cast<FrameInfo *>(opaque);
+
+        frameInfo->encoder->handleNalUnit(h, nal, frameInfo->pts);
+    }
+
+    void X264SliceEncoder::handleNalUnit(x264_t *h, x264_nal_t *nal, int64_t pts) {
+
+        int encapsulatedSize = getEncapsulatedSize(nal->i_payload);
+
+        // the units larger than a slice (e.g. key frame's slices if the slice size is not limited) are allocated
+        AVBufferRef *buffer = encapsulatedSize <= bufferSize ? av_buffer_pool_get(bufferPool)
+                                                             : av_buffer_alloc(encapsulatedSize);
+
+        if (!buffer) {
+            LOG(ERROR) << "Cannot allocate a buffer for the encoded unit";
+            return;
+        }
+
+        x264_nal_encode(h, buffer->data, nal); // the payload is encapsulated into the buffer (with start code)
+
+        auto startCodeSize = nal->b_long_startcode ? 4 : 3;
+
+        // the slice containing the last macroblock ends the frame
+        bool isSlice = nal->i_type >= 1 && nal->i_type <= 5;
+
+        bool isFrameEnd = isSlice && nal->i_last_mb + 1 >= numMacroblocks;
+
+        auto size = static_cast<size_t>(nal->i_payload - startCodeSize);
+
+        onNalUnit(NalUnit(NalUnit::shareBuffer(buffer), buffer->data + startCodeSize, size, isFrameEnd), pts);
+    }
+}
+
+#else // built without libx264
+
+namespace LIRS {
+
+    std::unique_ptr<X264SliceEncoder> X264SliceEncoder::create(lirs::config::params::CameraParameters const &,
+                                                               AVPixelFormat, Callback) {
+        LOG(WARN) << "The server is built without libx264, the slices are passed on along with their frame";
+        return nullptr;
+    }
+
+    X264SliceEncoder::~X264SliceEncoder() = default;
+
+    bool X264SliceEncoder::encode(AVFrame const *) {
+        return false;
+    }
+
+    bool X264SliceEncoder::reconfigureBitrate(uint16_t, int) {
+        return false;
+    }
+}
+
+#endif
+
+namespace LIRS {
+
+    std::vector<uint8_t> const &X264SliceEncoder::getHeaders() const {
+        return headers;
+    }
+}
@@ -0,0 +1,390 @@
+#include <cassert>
+
+#include "capture/LibavInput.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Utils.hpp"
+
+#ifdef __cplusplus
+extern "C" {
+#include <libavutil/time.h>
+}
+#endif
+
+namespace LIRS {
+
+    LibavInput::LibavInput(std::string resource, std::string inputFormat, int width, int height,
+                           AVPixelFormat pixelFormat, AVRational frameRate, bool isLooped, AVCodecID passthroughCodecId)
+            : resource(std::move(resource)), inputFormat(std::move(inputFormat)), width(width), height(height),
+              pixelFormat(pixelFormat), frameRate(frameRate), isLooped(isLooped),
+              passthroughCodecId(passthroughCodecId), formatContext(nullptr), codecContext(nullptr),
+              videoStream(nullptr), bsfContext(nullptr), packet(nullptr), decodedFrame(nullptr),
+              passStartTimeUs(AV_NOPTS_VALUE), passFirstPtsUs(AV_NOPTS_VALUE), lastFrameTimeUs(AV_NOPTS_VALUE) {}
+
+    LibavInput::~LibavInput() {
+        close();
+    }
+
+    bool LibavInput::open() {
+
+        // holds the general information about the format (container)
+        formatContext = avformat_alloc_context();
+
+        AVInputFormat *format = nullptr;
+
+        AVDictionary *options = nullptr;
+
+        if (!inputFormat.empty()) { // e.g. Video4Linux API for capturing
+
+            LOG(DEBUG) << "Using '" << inputFormat << "' input format for decoding raw data";
+
+            format = av_find_input_format(inputFormat.c_str());
+
+            auto frameResolutionStr = lirs::utils::concatParams({(size_t) width, (size_t) height}, "x");
+
+            auto framerateStr = lirs::utils::concatParams({(size_t) frameRate.num, (size_t) frameRate.den}, "/");
+
+            av_dict_set(&options, "video_size", frameResolutionStr.data(), 0);
+            // either raw pixel format or codec name, e.g. 'h264'
+            av_dict_set(&options, "pixel_format", passthroughCodecId != AV_CODEC_ID_NONE ?
+                                                  avcodec_get_name(passthroughCodecId) :
+                                                  av_get_pix_fmt_name(pixelFormat), 0);
+            av_dict_set(&options, "framerate", framerateStr.data(), 0);
+        }
+
+        int statCode = avformat_open_input(&formatContext, resource.c_str(), format, &options);
+        av_dict_free(&options);
+
+        if (statCode != 0) {
+            LOG(ERROR) << "Cannot open input: " << resource;
+            return false;
+        }
+
+        // get the info on all available streams
+        statCode = avformat_find_stream_info(formatContext, nullptr);
+        assert(statCode >= 0);
+
+        av_dump_format(formatContext, 0, resource.c_str(), 0);
+
+        // allocate demuxing packet
+        packet = av_packet_alloc();
+        av_init_packet(packet);
+
+        if (passthroughCodecId != AV_CODEC_ID_NONE) { // nothing to decode
+
+            int videoStreamIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+
+            if (videoStreamIndex < 0) {
+                LOG(ERROR) << "No video stream is found in " << resource;
+                return false;
+            }
+
+            videoStream = formatContext->streams[videoStreamIndex];
+
+            if (videoStream->codecpar->codec_id != passthroughCodecId) {
+                LOG(ERROR) << "Cannot pass through " << resource << ": "
+                           << avcodec_get_name(videoStream->codecpar->codec_id) << " video instead of "
+                           << avcodec_get_name(passthroughCodecId);
+                return false;
+            }
+
+            frameRate = videoStream->avg_frame_rate.num ? videoStream->avg_frame_rate : videoStream->r_frame_rate;
+            width = videoStream->codecpar->width;
+            height = videoStream->codecpar->height;
+
+            LOG(DEBUG) << "Passthrough params: codec: " << avcodec_get_name(passthroughCodecId) << ", width: "
+                       << width << ", height: " << height << ", framerate: " << frameRate.num << "/" << frameRate.den;
+
+            return initializeBitstreamFilter();
+        }
+
+        AVCodec *codec = nullptr;
+
+        // find video stream (if multiple video streams are available then you should choose one manually)
+        int videoStreamIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+
+        if (videoStreamIndex < 0 || !codec) {
+            LOG(ERROR) << "No decodable video stream is found in " << resource;
+            return false;
+        }
+
+        videoStream = formatContext->streams[videoStreamIndex];
+
+        // create codec context (for each codec its own codec context)
+        codecContext = avcodec_alloc_context3(codec);
+        assert(codecContext);
+
+        // copy video stream parameters to the codec context
+        statCode = avcodec_parameters_to_context(codecContext, videoStream->codecpar);
+        assert(statCode >= 0);
+
+        // initialize the codec context to use the created codec context
+        statCode = avcodec_open2(codecContext, codec, nullptr);
+        assert(statCode == 0);
+
+        // update parameters
+        frameRate = videoStream->avg_frame_rate.num ? videoStream->avg_frame_rate : videoStream->r_frame_rate;
+        width = codecContext->width;
+        height = codecContext->height;
+        pixelFormat = codecContext->pix_fmt;
+
+        LOG(DEBUG) << "Decoder params: width: " << width << ", height: " << height << ", pixel_fmt: "
+                   << av_get_pix_fmt_name(pixelFormat) << ", framerate: " << frameRate.num << "/" << frameRate.den;
+
+        // allocate frame
+        decodedFrame = av_frame_alloc();
+
+        return true;
+    }
+
+    AVFrame *LibavInput::grab(int timeoutMs) {
+
+        int statCode = decodeNextFrame();
+
+        if (statCode < 0) {
+
+            if (statCode == AVERROR_EOF) { // nothing more to read, do not spin
+                av_usleep(static_cast<unsigned int>(timeoutMs) * 1000U);
+            }
+
+            return nullptr;
+        }
+
+        int64_t frameTimeUs = toFrameTimeUs(decodedFrame->best_effort_timestamp);
+
+        // hand out the decoded frame's data (no copying)
+        AVFrame *frame = av_frame_alloc();
+        av_frame_move_ref(frame, decodedFrame);
+
+        frame->pts = frameTimeUs;
+
+        return frame;
+    }
+
+    void LibavInput::release(AVFrame *frame) {
+        av_frame_free(&frame);
+    }
+
+    AVPacket *LibavInput::grabPacket(int timeoutMs) {
+
+        int statCode = readNextPacket();
+
+        if (statCode >= 0 && bsfContext) { // convert into Annex B byte stream
+
+            statCode = av_bsf_send_packet(bsfContext, packet);
+
+            if (statCode >= 0) {
+                statCode = av_bsf_receive_packet(bsfContext, packet);
+            }
+        }
+
+        if (statCode < 0) {
+
+            av_packet_unref(packet);
+
+            if (statCode == AVERROR_EOF) { // nothing more to read, do not spin
+                av_usleep(static_cast<unsigned int>(timeoutMs) * 1000U);
+            }
+
+            return nullptr;
+        }
+
+        int64_t frameTimeUs = toFrameTimeUs(packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts);
+
+        // hand out the packet's data (no copying)
+        AVPacket *grabbedPacket = av_packet_alloc();
+        av_packet_move_ref(grabbedPacket, packet);
+
+        grabbedPacket->pts = grabbedPacket->dts = frameTimeUs;
+
+        return grabbedPacket;
+    }
+
+    void LibavInput::releasePacket(AVPacket *packet) {
+        av_packet_free(&packet);
+    }
+
+    int LibavInput::readNextPacket() {
+
+        bool isRewound = false;
+
+        while (true) {
+
+            int statCode = av_read_frame(formatContext, packet);
+
+            if (statCode == AVERROR_EOF && isLooped && !isRewound) {
+                rewind();
+                isRewound = true; // an empty resource must not be rewound forever
+                continue;
+            }
+
+            if (statCode < 0) {
+                av_packet_unref(packet);
+                return statCode;
+            }
+
+            // check whether it is a video stream's data
+            if (packet->stream_index != videoStream->index) {
+                av_packet_unref(packet);
+                continue;
+            }
+
+            return statCode;
+        }
+    }
+
+    int64_t LibavInput::toFrameTimeUs(int64_t timestamp) {
+
+        int64_t frameIntervalUs = av_rescale_q(1, av_inv_q(frameRate), AV_TIME_BASE_Q);
+
+        int64_t frameTimeUs = timestamp == AV_NOPTS_VALUE ? AV_NOPTS_VALUE :
+                              av_rescale_q(timestamp, videoStream->time_base, AV_TIME_BASE_Q);
+
+        if (isLooped) { // pace frames to real time
+
+            if (frameTimeUs == AV_NOPTS_VALUE) { // no timestamps, pace by the framerate
+
+                frameTimeUs = lastFrameTimeUs == AV_NOPTS_VALUE ? av_gettime_relative() :
+                              lastFrameTimeUs + frameIntervalUs;
+
+            } else {
+
+                if (passStartTimeUs == AV_NOPTS_VALUE) {
+                    passStartTimeUs = av_gettime_relative();
+                }
+
+                if (passFirstPtsUs == AV_NOPTS_VALUE) {
+                    passFirstPtsUs = frameTimeUs;
+                }
+
+                frameTimeUs = passStartTimeUs + (frameTimeUs - passFirstPtsUs);
+            }
+
+            int64_t delayUs = frameTimeUs - av_gettime_relative();
+
+            if (delayUs > 0) {
+                av_usleep(static_cast<unsigned int>(delayUs));
+            }
+
+        } else if (frameTimeUs == AV_NOPTS_VALUE) {
+            frameTimeUs = av_gettime();
+        }
+
+        lastFrameTimeUs = frameTimeUs;
+
+        return frameTimeUs;
+    }
+
+    bool LibavInput::initializeBitstreamFilter() {
+
+        auto const *extradata = videoStream->codecpar->extradata;
+
+        // Annex B streams (e.g. from cameras) either have no extradata or have it prefixed with a start code
+        if (videoStream->codecpar->extradata_size < 3 || extradata[0] == 0) {
+            return true;
+        }
+
+        auto const *filter = av_bsf_get_by_name(passthroughCodecId == AV_CODEC_ID_H264 ? "h264_mp4toannexb" :
+                                                "hevc_mp4toannexb");
+
+        if (!filter || av_bsf_alloc(filter, &bsfContext) < 0) {
+            LOG(ERROR) << "Cannot create bitstream filter for " << resource;
+            return false;
+        }
+
+        avcodec_parameters_copy(bsfContext->par_in, videoStream->codecpar);
+        bsfContext->time_base_in = videoStream->time_base;
+
+        if (av_bsf_init(bsfContext) < 0) {
+            LOG(ERROR) << "Cannot initialize bitstream filter for " << resource;
+            return false;
+        }
+
+        return true;
+    }
+
+    int LibavInput::decodeNextFrame() {
+
+        while (true) {
+
+            int statCode = readNextPacket();
+
+            if (statCode < 0) {
+                return statCode;
+            }
+
+            // send a packet to be filled with raw data
+            statCode = avcodec_send_packet(codecContext, packet);
+
+            av_packet_unref(packet);
+
+            if (statCode < 0) {
+                return statCode;
+            }
+
+            // receive decoded raw frame
+            statCode = avcodec_receive_frame(codecContext, decodedFrame);
+
+            if (statCode != AVERROR(EAGAIN)) {
+                return statCode;
+            }
+        }
+    }
+
+    void LibavInput::rewind() {
+
+        int64_t startTime = videoStream->start_time == AV_NOPTS_VALUE ? 0 : videoStream->start_time;
+
+        av_seek_frame(formatContext, videoStream->index, startTime, AVSEEK_FLAG_BACKWARD);
+
+        if (codecContext) {
+            avcodec_flush_buffers(codecContext);
+        }
+
+        if (bsfContext) {
+            av_bsf_flush(bsfContext);
+        }
+
+        // the next pass starts right after the last frame of this one
+        int64_t frameIntervalUs = av_rescale_q(1, av_inv_q(frameRate), AV_TIME_BASE_Q);
+
+        passStartTimeUs = lastFrameTimeUs == AV_NOPTS_VALUE ? AV_NOPTS_VALUE : lastFrameTimeUs + frameIntervalUs;
+        passFirstPtsUs = AV_NOPTS_VALUE;
+
+        LOG(DEBUG) << "Looping " << resource;
+    }
+
+    void LibavInput::close() {
+
+        av_packet_free(&packet);
+        av_frame_free(&decodedFrame);
+
+        av_bsf_free(&bsfContext);
+
+        avcodec_free_context(&codecContext);
+
+        // close and free the input format context
+        avformat_close_input(&formatContext);
+
+        videoStream = nullptr;
+    }
+
+    int LibavInput::getWidth() const {
+        return width;
+    }
+
+    int LibavInput::getHeight() const {
+        return height;
+    }
+
+    AVPixelFormat LibavInput::getPixelFormat() const {
+        return pixelFormat;
+    }
+
+    AVRational LibavInput::getFrameRate() const {
+        return frameRate;
+    }
+
+    AVCodecParameters const *LibavInput::getPacketParameters() const {
+        return bsfContext ? bsfContext->par_out : videoStream->codecpar;
+    }
+}
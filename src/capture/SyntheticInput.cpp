@@ -0,0 +1,176 @@
+#include "capture/SyntheticInput.hpp"
+#include "utils/Logger.hpp"
+
+#ifdef __cplusplus
+extern "C" {
+#include <libavutil/time.h>
+#include <libavutil/mathematics.h>
+}
+#endif
+
+namespace LIRS {
+
+    SyntheticInput::SyntheticInput(int width, int height, AVPixelFormat pixelFormat, AVRational frameRate,
+                                   int motion)
+            : width(width), height(height), pixelFormat(pixelFormat), frameRate(frameRate), motion(motion),
+              converterContext(nullptr), freeFrames(NUM_FRAMES), frameIndex(0), nextFrameTimeUs(AV_NOPTS_VALUE) {}
+
+    SyntheticInput::~SyntheticInput() {
+
+        AVFrame *frame = nullptr;
+
+        while (freeFrames.tryPop(frame)) {
+            av_frame_free(&frame);
+        }
+
+        sws_freeContext(converterContext);
+    }
+
+    bool SyntheticInput::open() {
+
+        if (width <= 0 || height <= 0 || frameRate.num <= 0 || frameRate.den <= 0) {
+            LOG(ERROR) << "Invalid synthetic input parameters: " << width << "x" << height << ", framerate: "
+                       << frameRate.num << "/" << frameRate.den;
+            return false;
+        }
+
+        // the frame is a window over the pattern, so the pattern's line is twice the frame's width
+        converterContext = sws_getCachedContext(nullptr, width, height, AV_PIX_FMT_RGB24, width, height, pixelFormat,
+                                                SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+
+        if (!converterContext) {
+            LOG(ERROR) << "Synthetic input does not support pixel format " << av_get_pix_fmt_name(pixelFormat);
+            return false;
+        }
+
+        drawPattern();
+
+        for (unsigned int idx = 0; idx < NUM_FRAMES; ++idx) {
+
+            AVFrame *frame = av_frame_alloc();
+            frame->width = width;
+            frame->height = height;
+            frame->format = pixelFormat;
+
+            if (av_frame_get_buffer(frame, 0) != 0) {
+                av_frame_free(&frame);
+                return false;
+            }
+
+            freeFrames.tryPush(frame);
+        }
+
+        LOG(DEBUG) << "Synthetic input: width: " << width << ", height: " << height << ", pixel_fmt: "
+                   << av_get_pix_fmt_name(pixelFormat) << ", framerate: " << frameRate.num << "/" << frameRate.den
+                   << ", motion: " << motion << " px/frame";
+
+        return true;
+    }
+
+    void SyntheticInput::drawPattern() {
+
+        // 75% color bars: white, yellow, cyan, green, magenta, red, blue, black
+        static const uint8_t BAR_COLORS[NUM_BARS][3] = {
+                {191, 191, 191}, {191, 191, 0}, {0, 191, 191}, {0, 191, 0},
+                {191, 0, 191}, {191, 0, 0}, {0, 0, 191}, {0, 0, 0}
+        };
+
+        int patternWidth = 2 * width;
+
+        pattern.resize(static_cast<size_t>(patternWidth) * height * 3);
+
+        for (int y = 0; y < height; ++y) {
+
+            uint8_t *line = pattern.data() + static_cast<size_t>(y) * patternWidth * 3;
+
+            for (int x = 0; x < patternWidth; ++x) {
+
+                int column = x % width;
+
+                if (y < height * 3 / 4) {
+
+                    auto color = BAR_COLORS[column * NUM_BARS / width];
+
+                    line[3 * x] = color[0];
+                    line[3 * x + 1] = color[1];
+                    line[3 * x + 2] = color[2];
+
+                } else { // luma ramp
+
+                    auto gray = static_cast<uint8_t>(column * 255 / width);
+
+                    line[3 * x] = line[3 * x + 1] = line[3 * x + 2] = gray;
+                }
+            }
+        }
+    }
+
+    AVFrame *SyntheticInput::grab(int timeoutMs) {
+
+        int64_t frameIntervalUs = av_rescale_q(1, av_inv_q(frameRate), AV_TIME_BASE_Q);
+
+        int64_t nowUs = av_gettime_relative();
+
+        if (nextFrameTimeUs == AV_NOPTS_VALUE) {
+            nextFrameTimeUs = nowUs;
+        }
+
+        // wait for the frame to be due
+        int64_t delayUs = nextFrameTimeUs - nowUs;
+
+        if (delayUs > timeoutMs * 1000LL) {
+            av_usleep(static_cast<unsigned int>(timeoutMs) * 1000U);
+            return nullptr;
+        }
+
+        if (delayUs > 0) {
+            av_usleep(static_cast<unsigned int>(delayUs));
+        }
+
+        int64_t frameTimeUs = nextFrameTimeUs;
+
+        nextFrameTimeUs += frameIntervalUs;
+
+        // do not burst frames after falling behind
+        if (av_gettime_relative() - nextFrameTimeUs > frameIntervalUs) {
+            nextFrameTimeUs = av_gettime_relative();
+        }
+
+        int offset = static_cast<int>(((frameIndex++ * motion) % width + width) % width);
+
+        AVFrame *frame = nullptr;
+
+        if (!freeFrames.tryPop(frame)) {
+            return nullptr; // all frames are in use, the frame is dropped (as a camera driver does)
+        }
+
+        const uint8_t *srcData[4] = {pattern.data() + 3 * offset, nullptr, nullptr, nullptr};
+        const int srcLinesize[4] = {2 * width * 3, 0, 0, 0};
+
+        sws_scale(converterContext, srcData, srcLinesize, 0, height, frame->data, frame->linesize);
+
+        frame->pts = frameTimeUs;
+
+        return frame;
+    }
+
+    void SyntheticInput::release(AVFrame *frame) {
+        freeFrames.tryPush(frame);
+    }
+
+    int SyntheticInput::getWidth() const {
+        return width;
+    }
+
+    int SyntheticInput::getHeight() const {
+        return height;
+    }
+
+    AVPixelFormat SyntheticInput::getPixelFormat() const {
+        return pixelFormat;
+    }
+
+    AVRational SyntheticInput::getFrameRate() const {
+        return frameRate;
+    }
+}
@@ -0,0 +1,279 @@
+#include "capture/V4L2Capture.hpp"
+#include "utils/Logger.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/videodev2.h>
+
+#ifdef __cplusplus
+extern "C" {
+#include <libavutil/imgutils.h>
+}
+#endif
+
+namespace LIRS {
+
+    V4L2Capture::V4L2Capture(std::string device, int width, int height, AVPixelFormat pixelFormat,
+                             AVRational frameRate)
+            : device(std::move(device)), width(width), height(height), bytesPerLine(0), pixelFormat(pixelFormat),
+              frameRate(frameRate), fd(-1), isStreaming(false) {}
+
+    V4L2Capture::~V4L2Capture() {
+        close();
+    }
+
+    bool V4L2Capture::isSupported(AVPixelFormat pixelFormat) {
+        return toFourcc(pixelFormat) != 0;
+    }
+
+    uint32_t V4L2Capture::toFourcc(AVPixelFormat pixelFormat) {
+
+        switch (pixelFormat) {
+            case AV_PIX_FMT_YUYV422:
+                return V4L2_PIX_FMT_YUYV;
+            case AV_PIX_FMT_UYVY422:
+                return V4L2_PIX_FMT_UYVY;
+            case AV_PIX_FMT_YUV420P:
+                return V4L2_PIX_FMT_YUV420;
+            case AV_PIX_FMT_YUV422P:
+                return V4L2_PIX_FMT_YUV422P;
+            case AV_PIX_FMT_NV12:
+                return V4L2_PIX_FMT_NV12;
+            case AV_PIX_FMT_GRAY8:
+                return V4L2_PIX_FMT_GREY;
+            case AV_PIX_FMT_RGB24:
+                return V4L2_PIX_FMT_RGB24;
+            case AV_PIX_FMT_BGR24:
+                return V4L2_PIX_FMT_BGR24;
+            case AV_PIX_FMT_BAYER_GRBG8:
+                return V4L2_PIX_FMT_SGRBG8;
+            default:
+                return 0;
+        }
+    }
+
+    int V4L2Capture::xioctl(unsigned long request, void *arg) {
+
+        int statCode;
+
+        do {
+            statCode = ioctl(fd, request, arg);
+        } while (statCode == -1 && errno == EINTR);
+
+        return statCode;
+    }
+
+    bool V4L2Capture::open() {
+
+        fd = ::open(device.c_str(), O_RDWR | O_NONBLOCK);
+
+        if (fd < 0) {
+            LOG(ERROR) << "Cannot open video device " << device << ": " << strerror(errno);
+            return false;
+        }
+
+        v4l2_capability capability{};
+
+        if (xioctl(VIDIOC_QUERYCAP, &capability) < 0 || !(capability.capabilities & V4L2_CAP_VIDEO_CAPTURE)
+            || !(capability.capabilities & V4L2_CAP_STREAMING)) {
+
+            LOG(ERROR) << device << " does not support video capture streaming I/O";
+            close();
+            return false;
+        }
+
+        // negotiate resolution and pixel format
+        v4l2_format format{};
+        format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        format.fmt.pix.width = static_cast<uint32_t>(width);
+        format.fmt.pix.height = static_cast<uint32_t>(height);
+        format.fmt.pix.pixelformat = toFourcc(pixelFormat);
+        format.fmt.pix.field = V4L2_FIELD_ANY;
+
+        if (xioctl(VIDIOC_S_FMT, &format) < 0 || format.fmt.pix.pixelformat != toFourcc(pixelFormat)) {
+            LOG(ERROR) << device << " does not support pixel format " << av_get_pix_fmt_name(pixelFormat);
+            close();
+            return false;
+        }
+
+        // the driver may adjust the resolution
+        width = static_cast<int>(format.fmt.pix.width);
+        height = static_cast<int>(format.fmt.pix.height);
+        bytesPerLine = static_cast<int>(format.fmt.pix.bytesperline);
+
+        // set framerate (it is not an error if the driver ignores it)
+        v4l2_streamparm streamParams{};
+        streamParams.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        streamParams.parm.capture.timeperframe.numerator = static_cast<uint32_t>(frameRate.den);
+        streamParams.parm.capture.timeperframe.denominator = static_cast<uint32_t>(frameRate.num);
+
+        if (xioctl(VIDIOC_S_PARM, &streamParams) == 0 && streamParams.parm.capture.timeperframe.numerator != 0) {
+            frameRate = (AVRational) {static_cast<int>(streamParams.parm.capture.timeperframe.denominator),
+                                      static_cast<int>(streamParams.parm.capture.timeperframe.numerator)};
+        }
+
+        // request and map the driver buffers
+        v4l2_requestbuffers request{};
+        request.count = NUM_BUFFERS;
+        request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        request.memory = V4L2_MEMORY_MMAP;
+
+        if (xioctl(VIDIOC_REQBUFS, &request) < 0 || request.count < 2) {
+            LOG(ERROR) << device << " does not support memory mapped buffers";
+            close();
+            return false;
+        }
+
+        for (unsigned int idx = 0; idx < request.count; ++idx) {
+
+            v4l2_buffer buffer{};
+            buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            buffer.memory = V4L2_MEMORY_MMAP;
+            buffer.index = idx;
+
+            if (xioctl(VIDIOC_QUERYBUF, &buffer) < 0) {
+                LOG(ERROR) << "Cannot query buffer " << idx << " of " << device << ": " << strerror(errno);
+                close();
+                return false;
+            }
+
+            void *start = mmap(nullptr, buffer.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buffer.m.offset);
+
+            if (start == MAP_FAILED) {
+                LOG(ERROR) << "Cannot map buffer " << idx << " of " << device << ": " << strerror(errno);
+                close();
+                return false;
+            }
+
+            // the frame is never reference counted, it only points at the mapped buffer
+            AVFrame *frame = av_frame_alloc();
+            frame->opaque = reinterpret_cast<void *>(static_cast<uintptr_t>(idx));
+
+            buffers.push_back({start, buffer.length, frame});
+
+            if (xioctl(VIDIOC_QBUF, &buffer) < 0) {
+                LOG(ERROR) << "Cannot queue buffer " << idx << " of " << device << ": " << strerror(errno);
+                close();
+                return false;
+            }
+        }
+
+        v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+        if (xioctl(VIDIOC_STREAMON, &type) < 0) {
+            LOG(ERROR) << "Cannot start streaming from " << device << ": " << strerror(errno);
+            close();
+            return false;
+        }
+
+        isStreaming = true;
+
+        LOG(DEBUG) << "V4L2 mmap capture: " << device << ", width: " << width << ", height: " << height
+                   << ", pixel_fmt: " << av_get_pix_fmt_name(pixelFormat) << ", framerate: " << frameRate.num
+                   << "/" << frameRate.den << ", buffers: " << buffers.size();
+
+        return true;
+    }
+
+    AVFrame *V4L2Capture::grab(int timeoutMs) {
+
+        pollfd pollFd{fd, POLLIN, 0};
+
+        int statCode = poll(&pollFd, 1, timeoutMs);
+
+        if (statCode <= 0) {
+            return nullptr; // timeout or interrupted
+        }
+
+        v4l2_buffer buffer{};
+        buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buffer.memory = V4L2_MEMORY_MMAP;
+
+        if (xioctl(VIDIOC_DQBUF, &buffer) < 0) {
+            return nullptr;
+        }
+
+        auto data = static_cast<const uint8_t *>(buffers[buffer.index].start);
+        auto frame = buffers[buffer.index].frame;
+
+        // point the frame's planes at the mapped buffer (no copying)
+        statCode = av_image_fill_arrays(frame->data, frame->linesize, data, pixelFormat, width, height, 1);
+
+        if (statCode < 0 || buffer.bytesused < static_cast<uint32_t>(statCode)) { // corrupted frame
+            requeue(buffer.index);
+            return nullptr;
+        }
+
+        // packed formats may have padded lines
+        if (bytesPerLine > frame->linesize[0] && frame->data[1] == nullptr) {
+            frame->linesize[0] = bytesPerLine;
+        }
+
+        frame->width = width;
+        frame->height = height;
+        frame->format = pixelFormat;
+        frame->pts = buffer.timestamp.tv_sec * 1000000LL + buffer.timestamp.tv_usec;
+
+        return frame;
+    }
+
+    void V4L2Capture::release(AVFrame *frame) {
+        requeue(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(frame->opaque)));
+    }
+
+    void V4L2Capture::requeue(uint32_t bufferIndex) {
+
+        v4l2_buffer buffer{};
+        buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buffer.memory = V4L2_MEMORY_MMAP;
+        buffer.index = bufferIndex;
+
+        if (xioctl(VIDIOC_QBUF, &buffer) < 0) {
+            LOG(WARN) << "Cannot re-queue buffer " << bufferIndex << " of " << device << ": " << strerror(errno);
+        }
+    }
+
+    void V4L2Capture::close() {
+
+        if (fd < 0) {
+            return;
+        }
+
+        if (isStreaming) {
+            v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            xioctl(VIDIOC_STREAMOFF, &type);
+            isStreaming = false;
+        }
+
+        for (auto &buffer : buffers) {
+            munmap(buffer.start, buffer.length);
+            av_frame_free(&buffer.frame);
+        }
+
+        buffers.clear();
+
+        ::close(fd);
+        fd = -1;
+    }
+
+    int V4L2Capture::getWidth() const {
+        return width;
+    }
+
+    int V4L2Capture::getHeight() const {
+        return height;
+    }
+
+    AVPixelFormat V4L2Capture::getPixelFormat() const {
+        return pixelFormat;
+    }
+
+    AVRational V4L2Capture::getFrameRate() const {
+        return frameRate;
+    }
+}
@@ -0,0 +1,152 @@
+#include "capture/VideoInput.hpp"
+#include "capture/V4L2Capture.hpp"
+#include "capture/LibavInput.hpp"
+#include "capture/SyntheticInput.hpp"
+#include "utils/Logger.hpp"
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <string>
+
+namespace LIRS {
+
+    namespace {
+
+        constexpr char const *SYNTHETIC_SCHEME = "synthetic://";
+
+        constexpr char const *FILE_SCHEME = "file://";
+
+        constexpr char const *MOTION_PARAM = "motion=";
+
+        bool startsWith(std::string const &str, std::string const &prefix) {
+            return str.compare(0, prefix.size(), prefix) == 0;
+        }
+
+        /**
+         * Parses the integer value of the URL query parameter (up to the next parameter or the end).
+         */
+        bool parseIntParam(std::string const &value, int &result) {
+
+            auto end = value.find('&');
+
+            auto str = value.substr(0, end);
+
+            if (str.empty()) {
+                return false;
+            }
+
+            char *strEnd = nullptr;
+
+            errno = 0;
+
+            long parsed = std::strtol(str.c_str(), &strEnd, 10);
+
+            if (errno != 0 || *strEnd != '\0' || parsed < INT_MIN || parsed > INT_MAX) {
+                return false;
+            }
+
+            result = static_cast<int>(parsed);
+
+            return true;
+        }
+    }
+
+    std::unique_ptr<VideoInput> VideoInput::create(lirs::config::params::CameraParameters const &config) {
+
+        auto const &resource = config.getResource();
+        auto const &inputParams = config.getInputParams();
+
+        AVPixelFormat pixelFormat = av_get_pix_fmt(inputParams.getPixelFormat().c_str());
+
+        AVRational frameRate = (AVRational) {inputParams.getFrameRate().first, inputParams.getFrameRate().second};
+
+        std::unique_ptr<VideoInput> input;
+
+        if (startsWith(resource, SYNTHETIC_SCHEME)) { // e.g. synthetic://bars?motion=4
+
+            int motion = 0;
+
+            auto motionPos = resource.find(MOTION_PARAM);
+
+            if (motionPos != std::string::npos) {
+                if (!parseIntParam(resource.substr(motionPos + std::string(MOTION_PARAM).size()), motion)) {
+                    LOG(ERROR) << "Invalid motion of the synthetic input: " << resource;
+                    return nullptr;
+                }
+            }
+
+            LOG(DEBUG) << "Using synthetic input: " << resource;
+
+            input.reset(new SyntheticInput(inputParams.getWidth(), inputParams.getHeight(), pixelFormat, frameRate,
+                                           motion));
+
+        } else if (startsWith(resource, FILE_SCHEME)) { // e.g. file:///home/user/video.mp4
+
+            LOG(DEBUG) << "Using looped video file input: " << resource;
+
+            input.reset(new LibavInput(resource.substr(std::string(FILE_SCHEME).size()), {}, inputParams.getWidth(),
+                                       inputParams.getHeight(), pixelFormat, frameRate, true));
+
+        } else { // video device
+
+            if (config.isZeroCopyCaptureEnabled() && V4L2Capture::isSupported(pixelFormat)) {
+
+                input.reset(new V4L2Capture(resource, inputParams.getWidth(), inputParams.getHeight(), pixelFormat,
+                                            frameRate));
+
+                if (input->open()) {
+                    LOG(DEBUG) << "Using Video4Linux2 memory mapped buffers for capturing raw data (zero-copy)";
+                    return input;
+                }
+
+                LOG(WARN) << "Cannot capture " << resource << " natively, falling back to libavdevice";
+            }
+
+            input.reset(new LibavInput(resource, "v4l2", inputParams.getWidth(), inputParams.getHeight(),
+                                       pixelFormat, frameRate, false));
+        }
+
+        if (!input->open()) {
+            return nullptr;
+        }
+
+        return input;
+    }
+
+    std::unique_ptr<LibavInput> VideoInput::createPassthrough(lirs::config::params::CameraParameters const &config) {
+
+        auto const &resource = config.getResource();
+        auto const &inputParams = config.getInputParams();
+
+        AVRational frameRate = (AVRational) {inputParams.getFrameRate().first, inputParams.getFrameRate().second};
+
+        AVCodecID codecId = config.getPassthroughCodec() == lirs::config::params::VideoCodec::H264 ?
+                            AV_CODEC_ID_H264 : AV_CODEC_ID_HEVC;
+
+        std::unique_ptr<LibavInput> input;
+
+        if (startsWith(resource, SYNTHETIC_SCHEME)) {
+
+            LOG(ERROR) << "Synthetic input has no compressed video to pass through: " << resource;
+
+            return nullptr;
+
+        } else if (startsWith(resource, FILE_SCHEME)) {
+
+            input.reset(new LibavInput(resource.substr(std::string(FILE_SCHEME).size()), {}, inputParams.getWidth(),
+                                       inputParams.getHeight(), AV_PIX_FMT_NONE, frameRate, true, codecId));
+
+        } else { // ask the device for the compressed video
+
+            input.reset(new LibavInput(resource, "v4l2", inputParams.getWidth(), inputParams.getHeight(),
+                                       AV_PIX_FMT_NONE, frameRate, false, codecId));
+        }
+
+        if (!input->open()) {
+            return nullptr;
+        }
+
+        return input;
+    }
+}
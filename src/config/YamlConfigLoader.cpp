@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <thread>
 #include <yaml-cpp/yaml.h>
 
 #include "config/YamlConfigLoader.hpp"
@@ -7,6 +10,72 @@ namespace lirs {
 
     namespace config {
 
+        namespace {
+
+            /**
+             * RTP header size in bytes (w/o CSRCs and extensions).
+             */
+            constexpr uint16_t RTP_HEADER_SIZE = 12;
+
+            /**
+             * Max number of the streaming event loops.
+             */
+            constexpr int MAX_NUM_WORKERS = 64;
+
+            /**
+             * Range of the TCP clients' send queue size in bytes (at least a few max size RTP packets).
+             */
+            constexpr int MIN_TCP_QUEUE_SIZE = 64 * 1024;
+
+            constexpr int MAX_TCP_QUEUE_SIZE = 64 * 1024 * 1024;
+
+            /**
+             * Max number of packets sent back-to-back by the pacer.
+             */
+            constexpr int MAX_PACING_BURST = 1024;
+
+            /**
+             * Range of the number of the packets kept for retransmission per client.
+             */
+            constexpr int MIN_RETRANSMISSION_HISTORY_SIZE = 16;
+
+            constexpr int MAX_RETRANSMISSION_HISTORY_SIZE = 32768;
+
+            /**
+             * Reads the optional integer parameter and checks its range.
+             *
+             * @param node - parent node.
+             * @param key - parameter's key.
+             * @param minValue - min allowed value.
+             * @param maxValue - max allowed value.
+             * @param value - parsed value (unchanged if the parameter is not specified).
+             * @return false - if the parameter is out of range, otherwise - true.
+             */
+            bool parseOptionalInt(YAML::Node const &node, std::string const &key, int minValue, int maxValue,
+                                  int &value) {
+
+                auto paramNode = node[key];
+
+                if (!paramNode || paramNode.IsNull()) {
+                    return true;
+                }
+
+                auto paramValue = paramNode.as<int>();
+
+                if (paramValue < minValue || paramValue > maxValue) {
+
+                    LOG(ERROR) << "Cannot parse YAML configuration file: '" << key << "' must be in range ["
+                               << minValue << ", " << maxValue << "], got " << paramValue;
+
+                    return false;
+                }
+
+                value = paramValue;
+
+                return true;
+            }
+        }
+
         YamlConfigLoader::YamlConfigLoader(std::string const &configResource)
                 : ConfigLoader(configResource) {}
 
@@ -170,6 +239,9 @@ namespace lirs {
 
                 inputParams.setPixelFormat(inputParamsNode["pixel_format"].as<std::string>());
 
+                // optional, capture directly from the memory mapped driver buffers
+                cameraParameters.setZeroCopyCaptureEnabled(inputParamsNode["zero_copy"].as<bool>(true));
+
                 // output
 
                 outputParams.setFrameRate(outputParamsNode["frame_rate"]["num"].as<std::uint16_t>(),
@@ -182,6 +254,27 @@ namespace lirs {
 
                 // encoder
 
+                if (encoderParamsNode["codec"]) { // optional, H.265 by default
+
+                    auto codec = encoderParamsNode["codec"].as<std::string>();
+
+                    if (codec == "h264") {
+                        encoderParams.setCodec(params::VideoCodec::H264);
+                    } else if (codec == "h265" || codec == "hevc") {
+                        encoderParams.setCodec(params::VideoCodec::H265);
+                    } else if (codec == "vp8") {
+                        encoderParams.setCodec(params::VideoCodec::VP8);
+                    } else if (codec == "vp9") {
+                        encoderParams.setCodec(params::VideoCodec::VP9);
+                    } else {
+
+                        LOG(ERROR) << "Cannot parse YAML configuration file: unknown encoder 'codec' in '"
+                                   << activeCamera << "' configuration: " << codec;
+
+                        return false;
+                    }
+                }
+
                 encoderParams.setBitrate(encoderParamsNode["bitrate"].as<std::uint16_t>());
 
                 encoderParams.setVbvBufSize(encoderParamsNode["vbv_buf_size"].as<std::uint16_t>());
@@ -194,10 +287,265 @@ namespace lirs {
 
                 encoderParams.setIntraRefreshEnabled(encoderParamsNode["intra_refresh_enabled"].as<bool>());
 
+                // threading, GOP and lookahead (optional, the encoder's defaults are used if not specified)
+
+                int frameThreads = params::EncoderParameters::UNSET;
+                int lookaheadSlices = params::EncoderParameters::UNSET;
+                int keyint = params::EncoderParameters::UNSET;
+                int bframes = params::EncoderParameters::UNSET;
+                int rcLookahead = params::EncoderParameters::UNSET;
+
+                if (!parseOptionalInt(encoderParamsNode, "frame_threads", 1, 16, frameThreads)
+                    || !parseOptionalInt(encoderParamsNode, "lookahead_slices", 0, 16, lookaheadSlices)
+                    || !parseOptionalInt(encoderParamsNode, "keyint", 1, 1000, keyint)
+                    || !parseOptionalInt(encoderParamsNode, "bframes", 0, 16, bframes)
+                    || !parseOptionalInt(encoderParamsNode, "rc_lookahead", 0, 250, rcLookahead)) {
+
+                    LOG(ERROR) << "Invalid 'encoder' parameters in '" << activeCamera << "' configuration.";
+
+                    return false;
+                }
+
+                if (rcLookahead != params::EncoderParameters::UNSET && bframes != params::EncoderParameters::UNSET
+                    && rcLookahead < bframes) {
+
+                    LOG(ERROR) << "Cannot parse YAML configuration file: 'rc_lookahead' must not be less than "
+                               << "'bframes' in '" << activeCamera << "' configuration.";
+
+                    return false;
+                }
+
+                encoderParams.setFrameThreads(frameThreads)
+                        .setLookaheadSlices(lookaheadSlices)
+                        .setKeyint(keyint)
+                        .setBframes(bframes)
+                        .setRcLookahead(rcLookahead);
+
+                // slices fitting the RTP packets (optional)
+
+                auto sliceMaxSizeNode = encoderParamsNode["slice_max_size"];
+
+                if (sliceMaxSizeNode && !sliceMaxSizeNode.IsNull()) {
+
+                    int sliceMaxSize = 0;
+
+                    if (sliceMaxSizeNode.as<std::string>() == "auto") { // one NAL unit per RTP packet
+                        sliceMaxSize = serverConfigNode["max_packet_size"].as<int>() - RTP_HEADER_SIZE;
+                    } else {
+                        sliceMaxSize = sliceMaxSizeNode.as<int>();
+                    }
+
+                    if (sliceMaxSize <= 0) {
+
+                        LOG(ERROR) << "Cannot parse YAML configuration file: invalid 'slice_max_size' in '"
+                                   << activeCamera << "' configuration: " << sliceMaxSize;
+
+                        return false;
+                    }
+
+                    encoderParams.setSliceMaxSize(static_cast<uint16_t>(sliceMaxSize));
+                }
+
+                // key frames requested by the joining clients (optional)
+
+                int keyFrameRequestWindowMs = encoderParams.getKeyFrameRequestWindowMs();
+
+                if (!parseOptionalInt(encoderParamsNode, "key_frame_request_window", 0, 60000, keyFrameRequestWindowMs)) {
+
+                    LOG(ERROR) << "Invalid 'encoder' parameters in '" << activeCamera << "' configuration.";
+
+                    return false;
+                }
+
+                encoderParams.setKeyFrameRequestWindowMs(static_cast<uint16_t>(keyFrameRequestWindowMs));
+
+                if (encoderParamsNode["pools"] && !encoderParamsNode["pools"].IsNull()) {
+                    encoderParams.setPools(encoderParamsNode["pools"].as<std::string>());
+                }
+
+                encoderParams.setWppEnabled(encoderParamsNode["wpp"].as<bool>(true));
+
+                // CPU affinity of the encoder's threads (optional)
+
+                auto affinityNode = encoderParamsNode["affinity"];
+
+                if (affinityNode && !affinityNode.IsNull()) {
+
+                    auto numCpus = std::thread::hardware_concurrency();
+
+                    std::vector<uint16_t> cpus;
+
+                    if (affinityNode["cpus"] && !affinityNode["cpus"].IsNull()) {
+
+                        for (auto const &cpuNode : affinityNode["cpus"]) {
+
+                            auto cpu = cpuNode.as<std::uint16_t>();
+
+                            if (numCpus > 0 && cpu >= numCpus) {
+
+                                LOG(ERROR) << "Cannot parse YAML configuration file: no CPU " << cpu << " in '"
+                                           << activeCamera << "' configuration (" << numCpus << " CPUs online).";
+
+                                return false;
+                            }
+
+                            cpus.push_back(cpu);
+                        }
+                    }
+
+                    int numaNode = params::EncoderParameters::UNSET;
+
+                    if (!parseOptionalInt(affinityNode, "numa_node", 0, 63, numaNode)) {
+
+                        LOG(ERROR) << "Invalid 'affinity' in '" << activeCamera << "' configuration.";
+
+                        return false;
+                    }
+
+                    encoderParams.setCpuAffinity(cpus).setNumaNode(numaNode);
+                }
+
+                // pipeline (optional)
+
+                params::PipelineParameters pipelineParams;
+
+                auto pipelineParamsNode = activeCameraNode["pipeline"];
+
+                if (pipelineParamsNode) {
+
+                    if (pipelineParamsNode["queue_size"]) {
+                        pipelineParams.setQueueSize(pipelineParamsNode["queue_size"].as<std::uint16_t>());
+                    }
+
+                    if (pipelineParamsNode["drop_policy"]) {
+
+                        auto dropPolicy = pipelineParamsNode["drop_policy"].as<std::string>();
+
+                        if (dropPolicy == "drop_oldest") {
+                            pipelineParams.setDropPolicy(params::DropPolicy::DROP_OLDEST);
+                        } else if (dropPolicy == "drop_newest") {
+                            pipelineParams.setDropPolicy(params::DropPolicy::DROP_NEWEST);
+                        } else {
+
+                            LOG(ERROR) << "Cannot parse YAML configuration file: unknown 'drop_policy' in '"
+                                       << activeCamera << "' configuration: " << dropPolicy;
+
+                            return false;
+                        }
+                    }
+
+                    int nalQueueSize = pipelineParams.getNalQueueSize();
+                    int gopCacheSize = pipelineParams.getGopCacheSize();
+                    int idleTimeoutMs = pipelineParams.getIdleTimeoutMs();
+
+                    if (!parseOptionalInt(pipelineParamsNode, "nal_queue_size", 1, 4096, nalQueueSize)
+                        || !parseOptionalInt(pipelineParamsNode, "gop_cache_size", 0, UINT16_MAX, gopCacheSize)
+                        || !parseOptionalInt(pipelineParamsNode, "idle_timeout", params::PipelineParameters::NEVER,
+                                             3600000, idleTimeoutMs)) {
+
+                        LOG(ERROR) << "Invalid 'pipeline' parameters in '" << activeCamera << "' configuration.";
+
+                        return false;
+                    }
+
+                    pipelineParams.setNalQueueSize(static_cast<uint16_t>(nalQueueSize))
+                            .setGopCacheSize(static_cast<uint16_t>(gopCacheSize))
+                            .setIdleTimeoutMs(idleTimeoutMs);
+
+                    if (pipelineParamsNode["overflow_policy"]) {
+
+                        auto overflowPolicy = pipelineParamsNode["overflow_policy"].as<std::string>();
+
+                        if (overflowPolicy == "drop_until_key_frame") {
+                            pipelineParams.setOverflowPolicy(params::OverflowPolicy::DROP_UNTIL_KEY_FRAME);
+                        } else if (overflowPolicy == "block") {
+                            pipelineParams.setOverflowPolicy(params::OverflowPolicy::BLOCK);
+                        } else {
+
+                            LOG(ERROR) << "Cannot parse YAML configuration file: unknown 'overflow_policy' in '"
+                                       << activeCamera << "' configuration: " << overflowPolicy;
+
+                            return false;
+                        }
+                    }
+                }
+
+                // passthrough (optional)
+
+                auto passthroughNode = activeCameraNode["passthrough"];
+
+                if (passthroughNode && !passthroughNode.IsNull()) {
+
+                    auto passthroughCodec = passthroughNode.as<std::string>();
+
+                    if (passthroughCodec == "h264") {
+                        cameraParameters.setPassthroughCodec(params::VideoCodec::H264);
+                    } else if (passthroughCodec == "h265" || passthroughCodec == "hevc") {
+                        cameraParameters.setPassthroughCodec(params::VideoCodec::H265);
+                    } else {
+
+                        LOG(ERROR) << "Cannot parse YAML configuration file: unsupported 'passthrough' codec in '"
+                                   << activeCamera << "' configuration: " << passthroughCodec;
+
+                        return false;
+                    }
+                }
+
+                // bitrate driven by the clients' receiver reports (optional)
+
+                params::AdaptiveBitrateParameters adaptiveBitrateParams;
+
+                auto adaptiveBitrateNode = activeCameraNode["adaptive_bitrate"];
+
+                if (adaptiveBitrateNode && adaptiveBitrateNode["enabled"].as<bool>(false)) {
+
+                    // by default down to a quarter of the configured bitrate and not above it
+                    int minBitrate = std::max(encoderParams.getBitrate() / 4, 1);
+                    int maxBitrate = encoderParams.getBitrate();
+                    int maxJitterMs = adaptiveBitrateParams.getMaxJitterMs();
+                    int intervalMs = adaptiveBitrateParams.getIntervalMs();
+                    int increaseHoldMs = adaptiveBitrateParams.getIncreaseHoldMs();
+
+                    if (!parseOptionalInt(adaptiveBitrateNode, "min_bitrate", 1, UINT16_MAX, minBitrate)
+                        || !parseOptionalInt(adaptiveBitrateNode, "max_bitrate", 1, UINT16_MAX, maxBitrate)
+                        || !parseOptionalInt(adaptiveBitrateNode, "max_jitter", 0, 60000, maxJitterMs)
+                        || !parseOptionalInt(adaptiveBitrateNode, "interval", 100, 60000, intervalMs)
+                        || !parseOptionalInt(adaptiveBitrateNode, "increase_hold", 0, 600000, increaseHoldMs)) {
+
+                        LOG(ERROR) << "Invalid 'adaptive_bitrate' parameters in '" << activeCamera
+                                   << "' configuration.";
+
+                        return false;
+                    }
+
+                    auto lossHigh = adaptiveBitrateNode["loss_high"].as<double>(adaptiveBitrateParams.getLossHigh());
+                    auto lossLow = adaptiveBitrateNode["loss_low"].as<double>(adaptiveBitrateParams.getLossLow());
+
+                    if (minBitrate > maxBitrate || lossLow < 0 || lossLow > lossHigh || lossHigh > 1) {
+
+                        LOG(ERROR) << "Cannot parse YAML configuration file: 'adaptive_bitrate' in '" << activeCamera
+                                   << "' configuration must satisfy min_bitrate <= max_bitrate and "
+                                   << "0 <= loss_low <= loss_high <= 1";
+
+                        return false;
+                    }
+
+                    adaptiveBitrateParams.setEnabled(true)
+                            .setMinBitrate(static_cast<uint16_t>(minBitrate))
+                            .setMaxBitrate(static_cast<uint16_t>(maxBitrate))
+                            .setLossHigh(lossHigh)
+                            .setLossLow(lossLow)
+                            .setMaxJitterMs(maxJitterMs)
+                            .setIntervalMs(intervalMs)
+                            .setIncreaseHoldMs(increaseHoldMs);
+                }
+
                 // set refs
                 cameraParameters.setInputParams(inputParams);
                 cameraParameters.setOutputParams(outputParams);
                 cameraParameters.setEncoderParams(encoderParams);
+                cameraParameters.setPipelineParams(pipelineParams);
+                cameraParameters.setAdaptiveBitrateParams(adaptiveBitrateParams);
 
                 configuration.addCameraParams(cameraParameters);
             }
@@ -219,6 +567,118 @@ namespace lirs {
             if (serverParams.isHttpEnabled())
                 serverParams.setHttpPortNum(serverConfigNode["http_port_num"].as<std::uint16_t>());
 
+            serverParams.setSharedFanoutEnabled(serverConfigNode["shared_fanout"].as<bool>(true));
+
+            int numWorkers = serverParams.getNumWorkers();
+
+            if (!parseOptionalInt(serverConfigNode, "workers", 0, MAX_NUM_WORKERS, numWorkers)) {
+                LOG(ERROR) << "Invalid 'server' parameters.";
+                return false;
+            }
+
+            serverParams.setNumWorkers(static_cast<uint16_t>(numWorkers));
+
+            if (serverConfigNode["scheduler"]) {
+
+                auto scheduler = serverConfigNode["scheduler"].as<std::string>();
+
+                if (scheduler == "select") {
+                    serverParams.setTaskSchedulerType(params::TaskSchedulerType::SELECT);
+                } else if (scheduler == "epoll") {
+                    serverParams.setTaskSchedulerType(params::TaskSchedulerType::EPOLL);
+                } else {
+                    LOG(ERROR) << "Cannot parse YAML configuration file: unknown 'scheduler' in 'server' configuration: "
+                               << scheduler;
+                    return false;
+                }
+            }
+
+            int tcpQueueSize = static_cast<int>(serverParams.getTcpQueueSize());
+
+            if (!parseOptionalInt(serverConfigNode, "tcp_queue_size", MIN_TCP_QUEUE_SIZE, MAX_TCP_QUEUE_SIZE,
+                                  tcpQueueSize)) {
+                LOG(ERROR) << "Invalid 'server' parameters.";
+                return false;
+            }
+
+            serverParams.setTcpQueueSize(static_cast<uint32_t>(tcpQueueSize));
+
+            auto pacingNode = serverConfigNode["pacing"];
+
+            if (pacingNode && pacingNode["enabled"].as<bool>(false)) {
+
+                auto window = pacingNode["window"].as<double>(serverParams.getPacingWindow());
+
+                if (window <= 0 || window > 1) {
+                    LOG(ERROR) << "Cannot parse YAML configuration file: pacing 'window' must be in range (0, 1], got "
+                               << window;
+                    return false;
+                }
+
+                int burst = serverParams.getPacingBurst();
+
+                if (!parseOptionalInt(pacingNode, "burst", 1, MAX_PACING_BURST, burst)) {
+                    LOG(ERROR) << "Invalid 'pacing' parameters.";
+                    return false;
+                }
+
+                serverParams.setPacingEnabled(true)
+                        .setPacingWindow(window)
+                        .setPacingBurst(static_cast<uint16_t>(burst));
+            }
+
+            auto retransmissionNode = serverConfigNode["retransmission"];
+
+            if (retransmissionNode && retransmissionNode["enabled"].as<bool>(false)) {
+
+                int historySize = serverParams.getRetransmissionHistorySize();
+
+                if (!parseOptionalInt(retransmissionNode, "history_size", MIN_RETRANSMISSION_HISTORY_SIZE,
+                                      MAX_RETRANSMISSION_HISTORY_SIZE, historySize)) {
+                    LOG(ERROR) << "Invalid 'retransmission' parameters.";
+                    return false;
+                }
+
+                serverParams.setRetransmissionEnabled(true)
+                        .setRetransmissionHistorySize(static_cast<uint16_t>(historySize))
+                        .setRtxEnabled(retransmissionNode["rtx"].as<bool>(false));
+            }
+
+            auto multicastNode = serverConfigNode["multicast"];
+
+            if (multicastNode && multicastNode["enabled"].as<bool>(false)) {
+
+                auto group = multicastNode["group"].as<std::string>("");
+
+                struct in_addr groupAddr{};
+
+                if (inet_pton(AF_INET, group.c_str(), &groupAddr) != 1 || !IN_MULTICAST(ntohl(groupAddr.s_addr))) {
+                    LOG(ERROR) << "Cannot parse YAML configuration file: 'group' must be an IPv4 multicast address, got '"
+                               << group << "'";
+                    return false;
+                }
+
+                int portNum = 0;
+                int ttl = serverParams.getMulticastTtl();
+
+                // the RTP port is even, the RTCP one is the next
+                if (!parseOptionalInt(multicastNode, "port", 2, 65534, portNum)
+                    || !parseOptionalInt(multicastNode, "ttl", 1, 255, ttl)) {
+                    LOG(ERROR) << "Invalid 'multicast' parameters.";
+                    return false;
+                }
+
+                if (portNum == 0 || portNum % 2 != 0) {
+                    LOG(ERROR) << "Cannot parse YAML configuration file: multicast 'port' must be an even number.";
+                    return false;
+                }
+
+                serverParams.setMulticastEnabled(true)
+                        .setMulticastGroup(group)
+                        .setMulticastPortNum(static_cast<uint16_t>(portNum))
+                        .setMulticastTtl(static_cast<uint8_t>(ttl));
+            }
+
             auto mappingsNode = serverConfigNode["mappings"];
 
             if (!mappingsNode || mappingsNode.size() == 0 || !mappingsNode.IsMap()) {